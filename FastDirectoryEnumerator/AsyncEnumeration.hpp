@@ -0,0 +1,402 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_ASYNCENUMERATION_H
+#define FASTDIRECTORYENUMERATOR_ASYNCENUMERATION_H
+
+#include "FastDirectoryEnumerator.hpp"
+
+/*! \file AsyncEnumeration.hpp
+\brief C++20 coroutine enumeration and metadata fetching. Only defines FASTDIRECTORYENUMERATOR_HAVE_COROUTINES,
+and anything else, if the compiler supports coroutines. Entirely in this header, so the library itself can be
+built for any standard.
+*/
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine>=201902L && defined(__has_include)
+#if __has_include(<coroutine>) && __has_include(<stop_token>)
+#define FASTDIRECTORYENUMERATOR_HAVE_COROUTINES
+#include <coroutine>
+#include <stop_token>
+#include <optional>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace FastDirectoryEnumerator
+{
+	namespace detail
+	{
+		typedef void (*async_post_t)(void *, std::coroutine_handle<>);
+		typedef void (*async_job_t)(void *);
+	}
+
+	/*! \brief Where coroutines awaiting enumeration or metadata are resumed.
+
+	Wraps anything with a `post(std::coroutine_handle<>)` member which arranges for the handle to be resumed
+	later on one of its threads, such as an event loop. `post()` is called from whichever thread finished the
+	blocking work, so must be thread safe.
+	*/
+	class async_executor
+	{
+		detail::async_post_t _post;
+		void *_ctx;
+	public:
+		//! Calls post(ctx, h) to resume h
+		async_executor(detail::async_post_t post, void *ctx) : _post(post), _ctx(ctx) { }
+		//! Posts to e, which must outlive any coroutine resumed on it
+		template<class E> static async_executor of(E &e)
+		{
+			return async_executor([](void *ctx, std::coroutine_handle<> h) { ((E *) ctx)->post(h); }, std::addressof(e));
+		}
+		//! Arranges for h to be resumed
+		void post(std::coroutine_handle<> h) const { _post(_ctx, h); }
+	};
+
+	/*! \brief A fixed number of threads running jobs in the order submitted.
+
+	The default pool, `default_pool()`, is what the blocking `getdents()` and `NtQueryDirectoryFile()` calls of
+	the coroutine enumerations run on, so they never stall an executor's threads, and is also the executor
+	coroutines are resumed on if no other is given. However many enumerations are awaited at once, only as
+	many syscalls as it has threads are made at a time.
+	*/
+	class async_thread_pool
+	{
+		struct job
+		{
+			detail::async_job_t fn;
+			void *ctx;
+		};
+		std::mutex _lock;
+		std::condition_variable _cv;
+		std::deque<job> _jobs;
+		bool _done;
+		std::vector<std::thread> _threads;
+		async_thread_pool(const async_thread_pool &) = delete;
+		async_thread_pool &operator=(const async_thread_pool &) = delete;
+		void _run()
+		{
+			for(;;)
+			{
+				job j;
+				{
+					std::unique_lock<std::mutex> g(_lock);
+					_cv.wait(g, [this] { return _done || !_jobs.empty(); });
+					if(_jobs.empty())
+						return;
+					j=_jobs.front();
+					_jobs.pop_front();
+				}
+				j.fn(j.ctx);
+			}
+		}
+	public:
+		//! Starts threads threads, zero meaning one per hardware thread
+		explicit async_thread_pool(size_t threads=0) : _done(false)
+		{
+			if(!threads)
+				threads=std::max(1u, std::thread::hardware_concurrency());
+			for(size_t n=0; n<threads; n++)
+				_threads.push_back(std::thread(&async_thread_pool::_run, this));
+		}
+		//! Runs the jobs already submitted, then stops the threads
+		~async_thread_pool()
+		{
+			{
+				std::lock_guard<std::mutex> g(_lock);
+				_done=true;
+			}
+			_cv.notify_all();
+			for(auto &t : _threads)
+				t.join();
+		}
+		//! The number of threads
+		size_t threads() const BOOST_NOEXCEPT_OR_NOTHROW { return _threads.size(); }
+		//! Calls fn(ctx) on one of the threads
+		void submit(detail::async_job_t fn, void *ctx)
+		{
+			{
+				std::lock_guard<std::mutex> g(_lock);
+				job j={ fn, ctx };
+				_jobs.push_back(j);
+			}
+			_cv.notify_one();
+		}
+		//! Resumes h on one of the threads
+		void post(std::coroutine_handle<> h)
+		{
+			submit([](void *ctx) { std::coroutine_handle<>::from_address(ctx).resume(); }, h.address());
+		}
+		//! An executor resuming coroutines on this pool
+		async_executor executor() { return async_executor::of(*this); }
+		//! The pool blocking syscalls run on, with at least four threads so a few slow directories don't hold up the rest. It is never destroyed.
+		static async_thread_pool &default_pool()
+		{
+			static async_thread_pool *pool=new async_thread_pool(std::max(4u, std::thread::hardware_concurrency()));
+			return *pool;
+		}
+	};
+
+	/*! \brief A coroutine producing a sequence of T on demand.
+
+	Nothing runs until `next()` is awaited, which resumes the generator until it next does `co_yield`, and
+	the generator doesn't run again until `next()` is next awaited. So a slow consumer applies backpressure all
+	the way down, with at most one chunk of entries per enumeration held at a time.
+
+	\code
+	auto chunks=async_enumerate_directory(_L("spool"), wanted, executor);
+	while(std::vector<directory_entry> *chunk=co_await chunks.next())
+		process(*chunk);
+	\endcode
+
+	The generator must not be destroyed while a `next()` is being awaited.
+	*/
+	template<class T> class async_generator
+	{
+	public:
+		struct promise_type
+		{
+			T *value;
+			std::coroutine_handle<> continuation;
+			std::exception_ptr error;
+			// Yielding or finishing hands straight back to whoever awaited next()
+			struct transfer
+			{
+				bool await_ready() const noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept { return h.promise().continuation; }
+				void await_resume() const noexcept { }
+			};
+			promise_type() : value(nullptr) { }
+			async_generator get_return_object() { return async_generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			transfer final_suspend() const noexcept { return {}; }
+			transfer yield_value(T &v) noexcept { value=std::addressof(v); return {}; }
+			transfer yield_value(T &&v) noexcept { value=std::addressof(v); return {}; }
+			void return_void() noexcept { value=nullptr; }
+			void unhandled_exception() noexcept { error=std::current_exception(); value=nullptr; }
+		};
+		class next_awaiter
+		{
+			std::coroutine_handle<promise_type> _h;
+		public:
+			explicit next_awaiter(std::coroutine_handle<promise_type> h) : _h(h) { }
+			bool await_ready() const noexcept { return !_h || _h.done(); }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+			{
+				_h.promise().continuation=continuation;
+				return _h;
+			}
+			T *await_resume()
+			{
+				if(!_h)
+					return nullptr;
+				if(_h.promise().error)
+				{
+					std::exception_ptr error(std::move(_h.promise().error));
+					_h.promise().error=nullptr;
+					std::rethrow_exception(error);
+				}
+				return _h.done() ? nullptr : _h.promise().value;
+			}
+		};
+	private:
+		std::coroutine_handle<promise_type> _h;
+		explicit async_generator(std::coroutine_handle<promise_type> h) : _h(h) { }
+	public:
+		async_generator() : _h(nullptr) { }
+		async_generator(async_generator &&o) BOOST_NOEXCEPT_OR_NOTHROW : _h(o._h) { o._h=nullptr; }
+		async_generator &operator=(async_generator &&o) BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			if(this!=&o)
+			{
+				if(_h) _h.destroy();
+				_h=o._h;
+				o._h=nullptr;
+			}
+			return *this;
+		}
+		async_generator(const async_generator &) = delete;
+		async_generator &operator=(const async_generator &) = delete;
+		~async_generator() { if(_h) _h.destroy(); }
+		/*! \brief Awaits the next item, returning a pointer to it, or null once there are no more.
+
+		The item is only valid until `next()` is next awaited. Rethrows anything the generator threw.
+		*/
+		next_awaiter next() { return next_awaiter(_h); }
+	};
+
+	namespace detail
+	{
+		// Runs f on the default pool, then resumes the awaiting coroutine on ex, rethrowing anything f threw
+		template<class F> class async_blocking_awaiter
+		{
+			F _f;
+			async_executor _ex;
+			std::coroutine_handle<> _h;
+			std::exception_ptr _error;
+			static void _run(void *ctx)
+			{
+				async_blocking_awaiter *self=(async_blocking_awaiter *) ctx;
+				try
+				{
+					self->_f();
+				}
+				catch(...)
+				{
+					self->_error=std::current_exception();
+				}
+				// The awaiting coroutine may be resumed and destroy this before post returns
+				self->_ex.post(self->_h);
+			}
+		public:
+			async_blocking_awaiter(F f, async_executor ex) : _f(std::move(f)), _ex(ex) { }
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> h)
+			{
+				_h=h;
+				async_thread_pool::default_pool().submit(&_run, this);
+			}
+			void await_resume() { if(_error) std::rethrow_exception(_error); }
+		};
+		template<class F> inline async_blocking_awaiter<F> async_blocking(F f, async_executor ex) { return async_blocking_awaiter<F>(std::move(f), ex); }
+
+		class async_fetch_metadata_awaiter
+		{
+			struct canceller
+			{
+				std::atomic<bool> *cancelled;
+				void operator()() const noexcept { cancelled->store(true, std::memory_order_relaxed); }
+			};
+			const enumeration_handle &_dir;
+			directory_entry *_begin, *_end;
+			have_metadata_flags _wanted;
+			async_executor _ex;
+			std::stop_token _stop;
+			bool _nosync;
+			std::atomic<bool> _cancelled;
+			std::optional<std::stop_callback<canceller>> _onstop;
+			std::coroutine_handle<> _h;
+			std::exception_ptr _error;
+			static void _done(void *ctx)
+			{
+				async_fetch_metadata_awaiter *self=(async_fetch_metadata_awaiter *) ctx;
+				self->_ex.post(self->_h);
+			}
+			static void _run(void *ctx)
+			{
+				// Without io_uring, a slice at a time so a stop is noticed
+				async_fetch_metadata_awaiter *self=(async_fetch_metadata_awaiter *) ctx;
+				try
+				{
+					for(directory_entry *e=self->_begin; e!=self->_end && !self->_cancelled.load(std::memory_order_relaxed);)
+					{
+						directory_entry *slice_end=e+std::min<ptrdiff_t>(self->_end-e, 1024);
+						fetch_metadata(self->_dir, e, slice_end, self->_wanted, self->_nosync);
+						e=slice_end;
+					}
+				}
+				catch(...)
+				{
+					self->_error=std::current_exception();
+				}
+				self->_ex.post(self->_h);
+			}
+		public:
+			async_fetch_metadata_awaiter(const enumeration_handle &dir, directory_entry *begin, directory_entry *end, have_metadata_flags wanted, async_executor ex, std::stop_token stop, bool nosync)
+				: _dir(dir), _begin(begin), _end(end), _wanted(wanted), _ex(ex), _stop(std::move(stop)), _nosync(nosync), _cancelled(false) { }
+			bool await_ready() const noexcept { return _begin==_end || !_wanted.value || _stop.stop_requested(); }
+			void await_suspend(std::coroutine_handle<> h)
+			{
+				_h=h;
+				_onstop.emplace(_stop, canceller{ &_cancelled });
+				if(!fetch_metadata_reactor(_dir, _begin, _end, _wanted, _nosync, &_cancelled, &_done, this))
+					async_thread_pool::default_pool().submit(&_run, this);
+			}
+			void await_resume()
+			{
+				_onstop.reset();
+				if(_error) std::rethrow_exception(_error);
+			}
+		};
+	}
+
+	/*! \brief Awaitably fetches the specified metadata for every entry in [begin, end) relative to the open directory dir.
+
+	On Linux 5.6 or later the lookups are queued as `IORING_OP_STATX` requests on a process wide io_uring,
+	which one reactor thread keeps up to a thousand deep whatever the number of batches awaited at once, so
+	thousands of concurrent fetches cost no threads. Elsewhere they run on
+	`async_thread_pool::default_pool()`. Either way the awaiting coroutine is resumed on ex.
+
+	If stop is requested, entries not yet looked up are left as they were. The entries must not be touched
+	until the fetch completes.
+	*/
+	inline detail::async_fetch_metadata_awaiter async_fetch_metadata(const enumeration_handle &dir, directory_entry *begin, directory_entry *end, have_metadata_flags wanted, async_executor ex, std::stop_token stop=std::stop_token(), bool nosync=false)
+	{
+		return detail::async_fetch_metadata_awaiter(dir, begin, end, wanted, ex, std::move(stop), nosync);
+	}
+	//! \overload
+	inline detail::async_fetch_metadata_awaiter async_fetch_metadata(const enumeration_handle &dir, std::vector<directory_entry> &entries, have_metadata_flags wanted, async_executor ex, std::stop_token stop=std::stop_token(), bool nosync=false)
+	{
+		return detail::async_fetch_metadata_awaiter(dir, entries.data(), entries.data()+entries.size(), wanted, ex, std::move(stop), nosync);
+	}
+	//! \overload Resumes on `async_thread_pool::default_pool()`
+	inline detail::async_fetch_metadata_awaiter async_fetch_metadata(const enumeration_handle &dir, std::vector<directory_entry> &entries, have_metadata_flags wanted)
+	{
+		return async_fetch_metadata(dir, entries, wanted, async_thread_pool::default_pool().executor());
+	}
+
+	/*! \brief Enumerates the directory at path a chunk at a time, with the metadata wanted fetched for each, as an async generator.
+
+	Opening the directory and each `getdents()` run on `async_thread_pool::default_pool()`, metadata is fetched
+	with `async_fetch_metadata()`, and the generator is resumed on ex in between, so a single threaded event
+	loop can interleave thousands of these. The kernel buffer is adaptive and by default each chunk is what
+	one kernel call returned, so small directories stay cheap. The generator ends early once stop is requested,
+	and yields nothing if the directory could not be opened.
+	*/
+	inline async_generator<std::vector<directory_entry>> async_enumerate_directory(std::filesystem::path path, have_metadata_flags wanted, async_executor ex, std::stop_token stop=std::stop_token(), size_t maxitems=enumeration_handle::adaptive_chunk)
+	{
+		std::unique_ptr<enumeration_handle> h;
+		co_await detail::async_blocking([&] { h=begin_enumerate_directory(path, enumeration_handle::adaptive_buffer_size); }, ex);
+		if(!h)
+			co_return;
+		std::vector<directory_entry> chunk;
+		while(!stop.stop_requested())
+		{
+			bool more;
+			co_await detail::async_blocking([&] { more=enumerate_directory(*h, chunk, maxitems); }, ex);
+			if(!more)
+				break;
+			if(wanted.value)
+				co_await async_fetch_metadata(*h, chunk, wanted, ex, stop);
+			if(!chunk.empty())
+				co_yield chunk;
+		}
+	}
+	//! \overload Fetches no metadata beyond what enumeration returns, and resumes on `async_thread_pool::default_pool()`
+	inline async_generator<std::vector<directory_entry>> async_enumerate_directory(std::filesystem::path path)
+	{
+		have_metadata_flags wanted; wanted.value=0;
+		return async_enumerate_directory(std::move(path), wanted, async_thread_pool::default_pool().executor());
+	}
+	//! As `async_enumerate_directory()`, but yielding one entry at a time, and ending as soon as stop is requested
+	inline async_generator<directory_entry> async_enumerate_directory_entries(std::filesystem::path path, have_metadata_flags wanted, async_executor ex, std::stop_token stop=std::stop_token())
+	{
+		auto chunks=async_enumerate_directory(std::move(path), wanted, ex, stop);
+		while(std::vector<directory_entry> *chunk=co_await chunks.next())
+			for(auto &entry : *chunk)
+			{
+				if(stop.stop_requested())
+					co_return;
+				co_yield entry;
+			}
+	}
+} // namespace
+
+#endif
+#endif
+
+#endif
@@ -0,0 +1,262 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#include "DirectoryDiff.hpp"
+
+namespace FastDirectoryEnumerator
+{
+
+namespace
+{
+	// What gets compared of an entry from either side
+	struct diff_item
+	{
+		name_view name;
+		uint64_t st_ino;
+		uint16_t st_type;
+		have_metadata_flags have;
+		off_t st_size;
+		timespec st_mtim, st_ctim;
+	};
+	template<class T> inline diff_item item_of(const T &side, size_t idx)
+	{
+		const packed_enumeration::record &r=side.record_at(idx);
+		diff_item ret;
+		ret.name=side[idx].name();
+		ret.st_ino=r.st_ino;
+		ret.st_type=r.st_type;
+		ret.have=r.have_metadata;
+		if(const directory_entry::stat_t *s=side.stat_at(idx))
+		{
+			ret.st_size=s->st_size;
+			ret.st_mtim=s->st_mtim;
+			ret.st_ctim=s->st_ctim;
+		}
+		else
+			ret.have.have_size=ret.have.have_mtim=ret.have.have_ctim=0;
+		return ret;
+	}
+	inline diff_item item_of(directory_entry &entry, name_view name)
+	{
+		// Only what is ready gets read, so none of these accessors go to the kernel
+		diff_item ret;
+		ret.name=name;
+		ret.have=entry.metadata_ready();
+		ret.st_ino=ret.have.have_ino ? entry.st_ino() : 0;
+		ret.st_type=ret.have.have_type ? entry.st_type() : 0;
+		ret.st_size=ret.have.have_size ? entry.st_size() : 0;
+		if(ret.have.have_mtim) ret.st_mtim=entry.st_mtim();
+		if(ret.have.have_ctim) ret.st_ctim=entry.st_ctim();
+		return ret;
+	}
+	inline bool operator!=(const timespec &a, const timespec &b) { return a.tv_sec!=b.tv_sec || a.tv_nsec!=b.tv_nsec; }
+	inline bool modified(const diff_item &b, const diff_item &a)
+	{
+		return (b.have.have_type && a.have.have_type && b.st_type!=a.st_type)
+			|| (b.have.have_size && a.have.have_size && b.st_size!=a.st_size)
+			|| (b.have.have_mtim && a.have.have_mtim && b.st_mtim!=a.st_mtim)
+			|| (b.have.have_ctim && a.have.have_ctim && b.st_ctim!=a.st_ctim);
+	}
+
+	// Matches the entries of after against those of before. Two enumerations of the same directory mostly
+	// come back in the same order, so each entry of after is first looked for a few entries on from the last
+	// one matched, which needs no memory beyond a bit per entry of before and stays in cache. Only entries of
+	// after which that misses are looked up, at the end, in an open addressed hash table of the entries of
+	// before still unmatched keyed by st_ino, or by leafname if before lacks it.
+	template<class T> class before_matcher
+	{
+		static BOOST_CONSTEXPR_OR_CONST uint32_t none=(uint32_t)-1;
+		static BOOST_CONSTEXPR_OR_CONST size_t window=8;
+		struct slot
+		{
+			uint64_t key;
+			uint32_t head;  // first unmatched entry with this key, or none if the slot is free
+		};
+		const T &before;
+		bool byino;
+		std::vector<bool> matched;
+		size_t cursor;  // where in before the next entry of after probably is
+		std::vector<slot> slots;
+		unsigned shift;
+		size_t mask;
+		std::vector<uint32_t> unmatched, next;  // next chains together unmatched entries sharing a key, as hard links do
+
+		static uint64_t hash_name(name_view name)
+		{
+			// FNV-1a
+			uint64_t ret=14695981039346656037ULL;
+			for(auto c : name)
+				ret=(ret^(uint64_t) c)*1099511628211ULL;
+			return ret;
+		}
+		uint64_t key_of(const diff_item &i) const { return byino ? i.st_ino : hash_name(i.name); }
+		const slot &find(uint64_t key) const
+		{
+			size_t i=(size_t)((key*0x9E3779B97F4A7C15ULL)>>shift);
+			while(none!=slots[i].head && slots[i].key!=key)
+				i=(i+1)&mask;
+			return slots[i];
+		}
+		template<class Sink> void matched_with(size_t b, const diff_item &a, bool renamed, Sink &&sink)
+		{
+			matched[b]=true;
+			if(renamed)
+				sink(change_kind::renamed, b);
+			if(modified(item_of(before, b), a))
+				sink(change_kind::modified, b);
+		}
+	public:
+		explicit before_matcher(const T &_before) : before(_before), byino(true), cursor(0), shift(0), mask(0)
+		{
+			size_t n=before.size();
+			for(size_t i=0; i<n && byino; i++)
+				byino=!!before.record_at(i).have_metadata.have_ino;
+			matched.assign(n, false);
+		}
+		// Returns true if a is one of the next few entries of before, calling sink(change_kind, size_t before) if modified
+		template<class Sink> bool match_in_order(const diff_item &a, Sink &&sink)
+		{
+			if(byino && !a.have.have_ino)
+				return false;
+			for(size_t b=cursor; b<matched.size() && b<cursor+window; b++)
+			{
+				if(matched[b] || (byino && before.record_at(b).st_ino!=a.st_ino) || before[b].name()!=a.name)
+					continue;
+				matched_with(b, a, false, sink);
+				cursor=b+1;
+				return true;
+			}
+			return false;
+		}
+		// Indexes the entries of before not matched in order, ready for match_indexed()
+		void build_index()
+		{
+			unmatched.clear();
+			for(size_t i=0; i<matched.size(); i++)
+				if(!matched[i])
+					unmatched.push_back((uint32_t) i);
+			size_t n=unmatched.size();
+			unsigned bits=4;
+			while(((size_t) 1<<bits)<n+n/2)
+				++bits;
+			shift=64-bits;
+			mask=((size_t) 1<<bits)-1;
+			slot empty={ 0, none };
+			slots.assign(mask+1, empty);
+			next.assign(n, (uint32_t) none);
+			// Inserting backwards leaves each chain in enumeration order
+			for(size_t i=n; i-->0;)
+			{
+				uint32_t b=unmatched[i];
+				uint64_t key=byino ? before.record_at(b).st_ino : hash_name(before[b].name());
+				slot &s=const_cast<slot &>(find(key));
+				s.key=key;
+				next[i]=s.head;
+				s.head=(uint32_t) i;
+			}
+		}
+		// Finds which entry of before a is, calling sink(change_kind, size_t before) for each difference
+		template<class Sink> void match_indexed(const diff_item &a, Sink &&sink)
+		{
+			if(byino && !a.have.have_ino)
+			{
+				sink(change_kind::added, directory_change::no_index);
+				return;
+			}
+			// Prefer the entry of the same name, else the first unmatched one for a rename
+			uint32_t exact=none, renamed=none;
+			for(uint32_t i=find(key_of(a)).head; none!=i; i=next[i])
+			{
+				uint32_t b=unmatched[i];
+				if(matched[b])
+					continue;
+				if(before[b].name()==a.name)
+				{
+					exact=b;
+					break;
+				}
+				if(byino && none==renamed)
+					renamed=b;
+			}
+			if(none!=exact)
+				matched_with(exact, a, false, sink);
+			else if(none!=renamed)
+				matched_with(renamed, a, true, sink);
+			else
+				sink(change_kind::added, directory_change::no_index);
+		}
+		// Calls sink(change_kind, size_t before) for each entry of before never matched
+		template<class Sink> void removed(Sink &&sink)
+		{
+			for(size_t i=0; i<matched.size(); i++)
+				if(!matched[i])
+					sink(change_kind::removed, i);
+		}
+	};
+
+	template<class T> std::vector<directory_change> diff_stored(const T &before, const packed_enumeration &after)
+	{
+		before_matcher<T> matcher(before);
+		std::vector<directory_change> ret;
+		std::vector<size_t> pending;
+		for(size_t n=0; n<after.size(); n++)
+			if(!matcher.match_in_order(item_of(after, n), [&ret, n](change_kind kind, size_t b) { directory_change c={ kind, b, n }; ret.push_back(c); }))
+				pending.push_back(n);
+		matcher.build_index();
+		for(size_t n : pending)
+			matcher.match_indexed(item_of(after, n), [&ret, n](change_kind kind, size_t b) { directory_change c={ kind, b, n }; ret.push_back(c); });
+		matcher.removed([&ret](change_kind kind, size_t b) { directory_change c={ kind, b, directory_change::no_index }; ret.push_back(c); });
+		return ret;
+	}
+
+	template<class T> size_t diff_live(const T &before, enumeration_handle &after, have_metadata_flags wanted, detail::diff_sink_t sink, void *ctx)
+	{
+		before_matcher<T> matcher(before);
+		std::vector<directory_entry> chunk, pending;
+		size_t count=0;
+		auto item=[](directory_entry &entry, std::filesystem::path &name) {
+			name=entry.name();
+			return item_of(entry, name_view(name.native().data(), name.native().size()));
+		};
+		std::filesystem::path name;
+		while(enumerate_directory(after, chunk, 4096))
+		{
+			if(wanted.value)
+				fetch_metadata(after, chunk, wanted);
+			for(auto &entry : chunk)
+				if(!matcher.match_in_order(item(entry, name), [sink, ctx, &entry](change_kind kind, size_t b) { sink(ctx, kind, b, &entry); }))
+					pending.push_back(std::move(entry));
+			count+=chunk.size();
+		}
+		matcher.build_index();
+		for(auto &entry : pending)
+			matcher.match_indexed(item(entry, name), [sink, ctx, &entry](change_kind kind, size_t b) { sink(ctx, kind, b, &entry); });
+		matcher.removed([sink, ctx](change_kind kind, size_t b) { sink(ctx, kind, b, nullptr); });
+		return count;
+	}
+}
+
+std::vector<directory_change> diff_directories(const packed_enumeration &before, const packed_enumeration &after)
+{
+	return diff_stored(before, after);
+}
+
+std::vector<directory_change> diff_directories(const directory_snapshot &before, const packed_enumeration &after)
+{
+	return diff_stored(before, after);
+}
+
+size_t diff_directories(const packed_enumeration &before, enumeration_handle &after, have_metadata_flags wanted, detail::diff_sink_t sink, void *ctx)
+{
+	return diff_live(before, after, wanted, sink, ctx);
+}
+
+size_t diff_directories(const directory_snapshot &before, enumeration_handle &after, have_metadata_flags wanted, detail::diff_sink_t sink, void *ctx)
+{
+	return diff_live(before, after, wanted, sink, ctx);
+}
+
+} // namespace
@@ -0,0 +1,86 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_DIRECTORYDIFF_H
+#define FASTDIRECTORYENUMERATOR_DIRECTORYDIFF_H
+
+#include "DirectorySnapshot.hpp"
+
+namespace FastDirectoryEnumerator
+{
+	//! How an entry differs between two enumerations of the same directory
+	enum class change_kind
+	{
+		added,     //!< Only in after
+		removed,   //!< Only in before
+		renamed,   //!< Same `st_ino`, different leafname
+		modified   //!< Same leafname and `st_ino`, but a different `st_type`, `st_size`, `st_mtim` or `st_ctim`
+	};
+	//! A difference between two enumerations
+	struct directory_change
+	{
+		//! The index of an entry absent from one side
+		static BOOST_CONSTEXPR_OR_CONST size_t no_index=(size_t)-1;
+		change_kind kind;
+		size_t before;  //!< Index of the entry in before, or no_index if added
+		size_t after;   //!< Index of the entry in after, or no_index if removed
+	};
+
+	/*! \brief Returns how after differs from before, two enumerations of the same directory.
+
+	Two enumerations of the same directory mostly come back in the same order, so each entry of after is
+	first looked for among the next few entries of before, which is a merge costing nothing beyond a bit per
+	entry of before. The entries of after which that misses are then joined on `st_ino` with those of before
+	still unmatched through an open addressed hash table, so this is linear in the number of entries and the
+	memory used grows with the number of changes rather than the size of the directory.
+
+	An entry of after whose `st_ino` is in before under another leafname has been renamed, and one in before
+	under the same leafname has been modified if any of `st_type`, `st_size`, `st_mtim` or `st_ctim` which
+	both sides have differs. An entry both renamed and modified is reported as both. Entries of before left
+	unmatched have been removed, and come last.
+
+	If before lacks `st_ino`, entries are matched by leafname instead and renames show up as a removal and
+	an addition.
+	*/
+	extern FASTDIRECTORYENUMERATOR_API std::vector<directory_change> diff_directories(const packed_enumeration &before, const packed_enumeration &after);
+	//! \overload
+	extern FASTDIRECTORYENUMERATOR_API std::vector<directory_change> diff_directories(const directory_snapshot &before, const packed_enumeration &after);
+
+	namespace detail { typedef void (*diff_sink_t)(void *, change_kind, size_t, directory_entry *); }
+	extern FASTDIRECTORYENUMERATOR_API size_t diff_directories(const packed_enumeration &before, enumeration_handle &after, have_metadata_flags wanted, detail::diff_sink_t sink, void *ctx);
+	extern FASTDIRECTORYENUMERATOR_API size_t diff_directories(const directory_snapshot &before, enumeration_handle &after, have_metadata_flags wanted, detail::diff_sink_t sink, void *ctx);
+	/*! \brief Compares before against the rest of the live enumeration after, without keeping after in memory.
+
+	after is enumerated a chunk at a time with the metadata wanted fetched for each, and
+	`sink(change_kind kind, size_t before, directory_entry *after)` called for each difference found. Entries
+	of after found in order are compared as they are enumerated, with after pointing into the current chunk.
+	Only the entries found out of order are kept, and once the enumeration ends are reported as added,
+	renamed or modified, followed by removals with a null after. Returns the number of entries of after
+	enumerated.
+
+	\code
+	auto snapshot=directory_snapshot::open(_L("spool"), _L("spool.snapshot"));
+	auto h=begin_enumerate_directory(_L("spool"));
+	have_metadata_flags wanted; wanted.value=0; wanted.have_size=wanted.have_mtim=1;
+	diff_directories(*snapshot, *h, wanted, [](change_kind kind, size_t before, directory_entry *after) { ... });
+	\endcode
+	*/
+	template<class F> inline size_t diff_directories(const packed_enumeration &before, enumeration_handle &after, have_metadata_flags wanted, F &&sink)
+	{
+		typedef typename std::remove_reference<F>::type sink_type;
+		return diff_directories(before, after, wanted, [](void *ctx, change_kind kind, size_t b, directory_entry *a) { (*(sink_type *) ctx)(kind, b, a); },
+			const_cast<void *>(static_cast<const void *>(std::addressof(sink))));
+	}
+	//! \overload
+	template<class F> inline size_t diff_directories(const directory_snapshot &before, enumeration_handle &after, have_metadata_flags wanted, F &&sink)
+	{
+		typedef typename std::remove_reference<F>::type sink_type;
+		return diff_directories(before, after, wanted, [](void *ctx, change_kind kind, size_t b, directory_entry *a) { (*(sink_type *) ctx)(kind, b, a); },
+			const_cast<void *>(static_cast<const void *>(std::addressof(sink))));
+	}
+} // namespace
+
+#endif
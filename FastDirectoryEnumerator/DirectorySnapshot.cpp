@@ -0,0 +1,293 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#include "DirectorySnapshot.hpp"
+#include "Undoer.hpp"
+#include <sys/stat.h>
+#include <stdio.h>
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+namespace FastDirectoryEnumerator
+{
+
+namespace
+{
+	// Laid out at the front of a snapshot file, followed by the records, the stat side table and the
+	// leafname arena at the offsets given, each eight byte aligned
+	struct snapshot_header
+	{
+		char magic[8];
+		uint32_t version;
+		uint16_t char_size, record_size;
+		uint32_t stat_size, header_size;
+		directory_snapshot::validators dir;
+		uint64_t entries;
+		uint64_t records_offset;
+		uint64_t stats, stats_offset;
+		uint64_t names, names_offset;  // in characters
+		uint64_t file_size;
+	};
+	static const char snapshot_magic[8]={ 'F', 'D', 'E', 'S', 'N', 'A', 'P', 0 };
+	static BOOST_CONSTEXPR_OR_CONST uint32_t snapshot_version=1;
+
+	inline uint64_t align8(uint64_t v) { return (v+7)&~(uint64_t)7; }
+	inline bool operator==(const timespec &a, const timespec &b) { return a.tv_sec==b.tv_sec && a.tv_nsec==b.tv_nsec; }
+	inline bool same_directory(const directory_snapshot::validators &a, const directory_snapshot::validators &b)
+	{
+		return a.st_dev==b.st_dev && a.st_ino==b.st_ino && a.st_mtim==b.st_mtim && a.st_ctim==b.st_ctim;
+	}
+	// Whether count items of size bytes starting at offset lie within a file of filesize bytes
+	inline bool fits(uint64_t offset, uint64_t count, size_t size, uint64_t filesize)
+	{
+		return offset<=filesize && count<=(filesize-offset)/size;
+	}
+	/* Timestamps are only as fine as the filing system keeps them, two seconds on FAT and a kernel timer tick
+	elsewhere, so an entry created in the same tick as the directory was last changed leaves its validators
+	as they were. A snapshot written within that of the change could then be missing the entry yet look
+	valid for ever, so one isn't kept unless the directory's validators are older than the snapshot file by
+	more than the coarsest tick. */
+	static BOOST_CONSTEXPR_OR_CONST time_t timestamp_tick=2;
+	inline bool changed_too_recently(const directory_snapshot::validators &dir, const directory_snapshot::validators &written)
+	{
+		return dir.st_mtim.tv_sec+timestamp_tick>=written.st_mtim.tv_sec || dir.st_ctim.tv_sec+timestamp_tick>=written.st_mtim.tv_sec;
+	}
+}
+
+directory_snapshot::~directory_snapshot()
+{
+	if(_map)
+	{
+#ifdef WIN32
+		UnmapViewOfFile(_map);
+#else
+		munmap(_map, _mapsize);
+#endif
+	}
+}
+
+bool directory_snapshot::read_validators(const std::filesystem::path &dir, validators &v)
+{
+	memset(&v, 0, sizeof(v));
+#ifdef WIN32
+	HANDLE h=CreateFileW(dir.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if(INVALID_HANDLE_VALUE==h)
+		return false;
+	auto unh=::detail::Undoer([h] { CloseHandle(h); });
+	BY_HANDLE_FILE_INFORMATION bhfi;
+	FILE_BASIC_INFO fbi;
+	if(!GetFileInformationByHandle(h, &bhfi) || !GetFileInformationByHandleEx(h, FileBasicInfo, &fbi, sizeof(fbi)))
+		return false;
+	v.st_dev=bhfi.dwVolumeSerialNumber;
+	v.st_ino=((uint64_t) bhfi.nFileIndexHigh<<32)|bhfi.nFileIndexLow;
+	// Leave these as raw FILETIME ticks, they only ever get compared
+	v.st_mtim.tv_sec=(time_t)(fbi.LastWriteTime.QuadPart/10000000);
+	v.st_mtim.tv_nsec=(long)(fbi.LastWriteTime.QuadPart%10000000);
+	v.st_ctim.tv_sec=(time_t)(fbi.ChangeTime.QuadPart/10000000);
+	v.st_ctim.tv_nsec=(long)(fbi.ChangeTime.QuadPart%10000000);
+#else
+	struct stat s;
+	if(-1==::stat(dir.c_str(), &s))
+		return false;
+	v.st_dev=s.st_dev;
+	v.st_ino=s.st_ino;
+#ifdef __APPLE__
+	v.st_mtim.tv_sec=s.st_mtimespec.tv_sec; v.st_mtim.tv_nsec=s.st_mtimespec.tv_nsec;
+	v.st_ctim.tv_sec=s.st_ctimespec.tv_sec; v.st_ctim.tv_nsec=s.st_ctimespec.tv_nsec;
+#else
+	v.st_mtim.tv_sec=s.st_mtim.tv_sec; v.st_mtim.tv_nsec=s.st_mtim.tv_nsec;
+	v.st_ctim.tv_sec=s.st_ctim.tv_sec; v.st_ctim.tv_nsec=s.st_ctim.tv_nsec;
+#endif
+#endif
+	return true;
+}
+
+bool directory_snapshot::save(const std::filesystem::path &snapshotpath, const validators &v, const packed_enumeration &entries)
+{
+	typedef std::filesystem::path::value_type value_type;
+	snapshot_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+	header.version=snapshot_version;
+	header.char_size=sizeof(value_type);
+	header.record_size=sizeof(record);
+	header.stat_size=sizeof(directory_entry::stat_t);
+	header.header_size=sizeof(header);
+	header.dir=v;
+	header.entries=entries.records.size();
+	header.records_offset=align8(sizeof(header));
+	header.stats=entries.stats.size();
+	header.stats_offset=align8(header.records_offset+header.entries*sizeof(record));
+	header.names=entries.names.size();
+	header.names_offset=align8(header.stats_offset+header.stats*sizeof(directory_entry::stat_t));
+	header.file_size=header.names_offset+header.names*sizeof(value_type);
+
+	std::filesystem::path temppath(snapshotpath);
+	temppath+=".tmp";
+#ifdef WIN32
+	FILE *f=_wfopen(temppath.c_str(), L"wb");
+#else
+	FILE *f=fopen(temppath.c_str(), "wb");
+#endif
+	if(!f)
+		return false;
+	bool ok=true;
+	auto write_at=[&](uint64_t offset, const void *data, size_t bytes) {
+		static const char zeros[8]={ 0 };
+		long pos=ftell(f);
+		if(pos<0 || (uint64_t) pos>offset) { ok=false; return; }
+		if((uint64_t) pos<offset && 1!=fwrite(zeros, (size_t)(offset-pos), 1, f)) ok=false;
+		if(bytes && 1!=fwrite(data, bytes, 1, f)) ok=false;
+	};
+	write_at(0, &header, sizeof(header));
+	write_at(header.records_offset, entries.records.data(), entries.records.size()*sizeof(record));
+	write_at(header.stats_offset, entries.stats.data(), entries.stats.size()*sizeof(directory_entry::stat_t));
+	write_at(header.names_offset, entries.names.data(), entries.names.size()*sizeof(value_type));
+	if(fclose(f))
+		ok=false;
+	validators written;
+	if(ok && (!read_validators(temppath, written) || changed_too_recently(v, written)))
+		ok=false;
+	if(ok)
+	{
+#ifdef WIN32
+		ok=!!MoveFileExW(temppath.c_str(), snapshotpath.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+		ok=!rename(temppath.c_str(), snapshotpath.c_str());
+#endif
+	}
+	if(!ok)
+	{
+#ifdef WIN32
+		_wremove(temppath.c_str());
+#else
+		::remove(temppath.c_str());
+#endif
+	}
+	return ok;
+}
+
+bool directory_snapshot::_int_map(const std::filesystem::path &snapshotpath, const validators &v)
+{
+	size_t size;
+	void *map;
+#ifdef WIN32
+	HANDLE h=CreateFileW(snapshotpath.c_str(), GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(INVALID_HANDLE_VALUE==h)
+		return false;
+	auto unh=::detail::Undoer([h] { CloseHandle(h); });
+	LARGE_INTEGER filesize;
+	if(!GetFileSizeEx(h, &filesize) || (uint64_t) filesize.QuadPart<sizeof(snapshot_header))
+		return false;
+	size=(size_t) filesize.QuadPart;
+	HANDLE mh=CreateFileMappingW(h, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!mh)
+		return false;
+	map=MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mh);
+	if(!map)
+		return false;
+	auto unmap=::detail::Undoer([map] { UnmapViewOfFile(map); });
+#else
+	int fd=::open(snapshotpath.c_str(), O_RDONLY|O_CLOEXEC);
+	if(-1==fd)
+		return false;
+	auto unfd=::detail::Undoer([fd] { ::close(fd); });
+	struct stat s;
+	if(-1==fstat(fd, &s) || (uint64_t) s.st_size<sizeof(snapshot_header))
+		return false;
+	size=(size_t) s.st_size;
+	if(MAP_FAILED==(map=mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)))
+		return false;
+	auto unmap=::detail::Undoer([map, size] { munmap(map, size); });
+#endif
+	const snapshot_header &header=*(const snapshot_header *) map;
+	if(memcmp(header.magic, snapshot_magic, sizeof(header.magic)) || snapshot_version!=header.version
+		|| sizeof(std::filesystem::path::value_type)!=header.char_size || sizeof(record)!=header.record_size
+		|| sizeof(directory_entry::stat_t)!=header.stat_size || sizeof(snapshot_header)!=header.header_size
+		|| header.file_size!=size || !same_directory(header.dir, v))
+		return false;
+	if(!fits(header.records_offset, header.entries, sizeof(record), size) || !fits(header.stats_offset, header.stats, sizeof(directory_entry::stat_t), size)
+		|| !fits(header.names_offset, header.names, sizeof(std::filesystem::path::value_type), size))
+		return false;
+	// Every record is checked once here, so a corrupt file can't have entries read from outside the mapping
+	const record *records=(const record *)((const char *) map+header.records_offset);
+	const std::filesystem::path::value_type *names=(const std::filesystem::path::value_type *)((const char *) map+header.names_offset);
+	for(uint64_t n=0; n<header.entries; n++)
+	{
+		const record &r=records[n];
+		if(r.name_offset>=header.names || r.name_length>=header.names-r.name_offset || names[r.name_offset+r.name_length]
+			|| (packed_enumeration::no_stat!=r.stat_index && r.stat_index>=header.stats))
+			return false;
+	}
+	unmap.dismiss();
+	_map=map;
+	_mapsize=size;
+	_records=records;
+	_stats=(const directory_entry::stat_t *)((const char *) map+header.stats_offset);
+	_names=names;
+	_size=(size_t) header.entries;
+	return true;
+}
+
+std::unique_ptr<directory_snapshot> directory_snapshot::open(const std::filesystem::path &dir, const std::filesystem::path &snapshotpath, have_metadata_flags wanted)
+{
+	std::unique_ptr<directory_snapshot> ret(new directory_snapshot);
+	// Read the validators before enumerating, so a change made during the enumeration invalidates it
+	validators v;
+	if(!read_validators(dir, v))
+		return nullptr;
+	if(ret->_int_map(snapshotpath, v))
+	{
+		ret->_from_cache=true;
+		return ret;
+	}
+	auto h=begin_enumerate_directory(dir);
+	if(!h)
+		return nullptr;
+	std::unique_ptr<packed_enumeration> live(new packed_enumeration);
+	if(!wanted.value)
+		while(enumerate_directory(*h, *live));
+	else
+	{
+		std::vector<directory_entry> chunk;
+		while(enumerate_directory(*h, chunk, 4096))
+		{
+			fetch_metadata(*h, chunk, wanted);
+			for(auto &entry : chunk)
+				live->push_back(entry);
+		}
+	}
+	h.reset();
+	if(save(snapshotpath, v, *live) && ret->_int_map(snapshotpath, v))
+		return ret;
+	ret->_records=live->records.data();
+	ret->_stats=live->stats.data();
+	ret->_names=live->names.data();
+	ret->_size=live->records.size();
+	ret->_live=std::move(live);
+	return ret;
+}
+
+directory_entry directory_snapshot::to_directory_entry(size_t idx) const
+{
+	const record &r=_records[idx];
+	directory_entry ret;
+	if(packed_enumeration::no_stat!=r.stat_index)
+		ret._stat.reset(new directory_entry::stat_t(_stats[r.stat_index]));
+	ret.leafname=std::filesystem::path::string_type(_names+r.name_offset, r.name_length);
+	ret.have_metadata=r.have_metadata;
+	ret._ino=r.st_ino;
+	ret._type=r.st_type;
+	return ret;
+}
+
+} // namespace
@@ -0,0 +1,145 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_DIRECTORYSNAPSHOT_H
+#define FASTDIRECTORYENUMERATOR_DIRECTORYSNAPSHOT_H
+
+#include "FastDirectoryEnumerator.hpp"
+
+namespace FastDirectoryEnumerator
+{
+	/*! \brief The entries of a directory as saved in an on-disk snapshot file, memory mapped.
+
+	A snapshot file holds the `packed_enumeration` of a directory exactly as it lies in memory, so the fixed
+	size records, the stat side table and the leafname arena, along with the device, inode, mtime and ctime
+	the directory had when it was enumerated. Opening a snapshot is one stat of the directory to check those
+	still match and an `mmap()` of the file, with nothing parsed per entry. If they don't match, the directory
+	is enumerated live and the snapshot rewritten.
+
+	Creating, removing or renaming an entry changes the directory's mtime and so invalidates the snapshot, but
+	changing an entry's own metadata does not, so any metadata kept in a snapshot is as of when it was taken.
+	Snapshot files are only readable by the same platform and build which wrote them.
+	*/
+	class FASTDIRECTORYENUMERATOR_API directory_snapshot
+	{
+	public:
+		typedef packed_enumeration::record record;
+		//! What a snapshot is checked against
+		struct validators
+		{
+			uint64_t st_dev;
+			uint64_t st_ino;
+			timespec st_mtim;
+			timespec st_ctim;
+		};
+		//! A lightweight reference to an entry
+		class entry
+		{
+			const directory_snapshot *p;
+			size_t idx;
+		public:
+			entry(const directory_snapshot *_p, size_t _idx) : p(_p), idx(_idx) { }
+			//! The name of the directory entry
+			name_view name() const BOOST_NOEXCEPT_OR_NOTHROW { const record &r=p->_records[idx]; return name_view(p->_names+r.name_offset, r.name_length); }
+			//! The name of the directory entry, null terminated
+			const std::filesystem::path::value_type *c_str() const BOOST_NOEXCEPT_OR_NOTHROW { return p->_names+p->_records[idx].name_offset; }
+			//! A bitfield of what metadata is ready
+			have_metadata_flags metadata_ready() const BOOST_NOEXCEPT_OR_NOTHROW { return p->_records[idx].have_metadata; }
+			//! Returns st_ino
+			uint64_t st_ino() const BOOST_NOEXCEPT_OR_NOTHROW { return p->_records[idx].st_ino; }
+			//! Returns st_type
+			uint16_t st_type() const BOOST_NOEXCEPT_OR_NOTHROW { return p->_records[idx].st_type; }
+			//! Makes a full directory_entry of this entry
+			directory_entry to_directory_entry() const { return p->to_directory_entry(idx); }
+		};
+		//! A random access iterator over the entries
+		class const_iterator
+		{
+			const directory_snapshot *p;
+			size_t idx;
+		public:
+			typedef std::random_access_iterator_tag iterator_category;
+			typedef entry value_type;
+			typedef ptrdiff_t difference_type;
+			typedef void pointer;
+			typedef entry reference;
+			const_iterator() : p(nullptr), idx(0) { }
+			const_iterator(const directory_snapshot *_p, size_t _idx) : p(_p), idx(_idx) { }
+			entry operator*() const { return entry(p, idx); }
+			entry operator[](ptrdiff_t n) const { return entry(p, idx+n); }
+			const_iterator &operator++() { ++idx; return *this; }
+			const_iterator operator++(int) { const_iterator ret(*this); ++idx; return ret; }
+			const_iterator &operator--() { --idx; return *this; }
+			const_iterator operator--(int) { const_iterator ret(*this); --idx; return ret; }
+			const_iterator &operator+=(ptrdiff_t n) { idx+=n; return *this; }
+			const_iterator &operator-=(ptrdiff_t n) { idx-=n; return *this; }
+			const_iterator operator+(ptrdiff_t n) const { return const_iterator(p, idx+n); }
+			const_iterator operator-(ptrdiff_t n) const { return const_iterator(p, idx-n); }
+			ptrdiff_t operator-(const const_iterator &o) const { return (ptrdiff_t) idx-(ptrdiff_t) o.idx; }
+			bool operator==(const const_iterator &o) const { return idx==o.idx; }
+			bool operator!=(const const_iterator &o) const { return idx!=o.idx; }
+			bool operator< (const const_iterator &o) const { return idx<o.idx; }
+			bool operator<=(const const_iterator &o) const { return idx<=o.idx; }
+			bool operator> (const const_iterator &o) const { return idx>o.idx; }
+			bool operator>=(const const_iterator &o) const { return idx>=o.idx; }
+		};
+	private:
+		void *_map;                               // the mapped snapshot file
+		size_t _mapsize;
+		std::unique_ptr<packed_enumeration> _live;  // the entries of a live enumeration which couldn't be saved
+		const record *_records;
+		const directory_entry::stat_t *_stats;
+		const std::filesystem::path::value_type *_names;
+		size_t _size;
+		bool _from_cache;
+		directory_snapshot() : _map(nullptr), _mapsize(0), _records(nullptr), _stats(nullptr), _names(nullptr), _size(0), _from_cache(false) { }
+		directory_snapshot(const directory_snapshot &) = delete;
+		directory_snapshot &operator=(const directory_snapshot &) = delete;
+		bool _int_map(const std::filesystem::path &snapshotpath, const validators &v);
+	public:
+		~directory_snapshot();
+		/*! \brief Opens the snapshot at snapshotpath of the directory dir, returning a null pointer if dir could not be read.
+
+		If the snapshot is missing, out of date or corrupt, dir is enumerated afresh with the metadata wanted
+		fetched for every entry, and the result saved to snapshotpath. If saving fails, or the directory changed
+		too recently for `save()` to keep it, the fresh entries are still returned.
+		*/
+		static std::unique_ptr<directory_snapshot> open(const std::filesystem::path &dir, const std::filesystem::path &snapshotpath, have_metadata_flags wanted);
+		//! \overload
+		static std::unique_ptr<directory_snapshot> open(const std::filesystem::path &dir, const std::filesystem::path &snapshotpath)
+		{
+			have_metadata_flags wanted; wanted.value=0;
+			return open(dir, snapshotpath, wanted);
+		}
+		//! Reads the validators of the directory dir now, returning false if it couldn't be
+		static bool read_validators(const std::filesystem::path &dir, validators &v);
+		/*! \brief Saves entries to snapshotpath as the snapshot of a directory which had validators v when enumerated. Returns false on failure.
+
+		The file is written alongside and renamed into place, so readers never see a partial snapshot. It is not
+		kept if the directory's mtime or ctime in v is within two seconds of the file being written, as an entry
+		created in the same timestamp tick would leave the validators unchanged and so the snapshot wrongly valid.
+		*/
+		static bool save(const std::filesystem::path &snapshotpath, const validators &v, const packed_enumeration &entries);
+		//! True if the entries came from the snapshot file rather than a live enumeration
+		bool from_cache() const BOOST_NOEXCEPT_OR_NOTHROW { return _from_cache; }
+		//! The number of entries
+		size_t size() const BOOST_NOEXCEPT_OR_NOTHROW { return _size; }
+		//! True if there are no entries
+		bool empty() const BOOST_NOEXCEPT_OR_NOTHROW { return !_size; }
+		//! The entry at idx
+		entry operator[](size_t idx) const BOOST_NOEXCEPT_OR_NOTHROW { return entry(this, idx); }
+		const_iterator begin() const BOOST_NOEXCEPT_OR_NOTHROW { return const_iterator(this, 0); }
+		const_iterator end() const BOOST_NOEXCEPT_OR_NOTHROW { return const_iterator(this, _size); }
+		//! The fixed size record of the entry at idx
+		const record &record_at(size_t idx) const BOOST_NOEXCEPT_OR_NOTHROW { return _records[idx]; }
+		//! The row of the stat side table of the entry at idx, or null if it has none
+		const directory_entry::stat_t *stat_at(size_t idx) const BOOST_NOEXCEPT_OR_NOTHROW { uint32_t i=_records[idx].stat_index; return packed_enumeration::no_stat==i ? nullptr : &_stats[i]; }
+		//! Makes a full directory_entry of the entry at idx
+		directory_entry to_directory_entry(size_t idx) const;
+	};
+} // namespace
+
+#endif
@@ -0,0 +1,157 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#include "DiskUsage.hpp"
+#include "InodeSet.hpp"
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace FastDirectoryEnumerator
+{
+
+std::filesystem::path disk_usage_node::path() const
+{
+	std::vector<const disk_usage_node *> chain;
+	for(const disk_usage_node *d=this; d; d=d->parent())
+		chain.push_back(d);
+	std::filesystem::path ret;
+	for(auto it=chain.rbegin(); it!=chain.rend(); ++it)
+		ret/=(*it)->leafname();
+	return ret;
+}
+
+namespace detail
+{
+	class disk_usage_builder
+	{
+		disk_usage &du;
+		inode_set seen;
+		std::atomic<size_t> hardlinks;
+
+		static void add(disk_usage_totals &totals, directory_entry &entry)
+		{
+			have_metadata_flags ready=entry.metadata_ready();
+#ifdef WIN32
+			if(ready.have_allocated) totals.allocated+=entry.st_allocated();
+#else
+			if(ready.have_blocks) totals.allocated+=(uint64_t) entry.st_blocks()*512;
+#endif
+			if(ready.have_size) totals.size+=entry.st_size();
+		}
+	public:
+		disk_usage_builder(disk_usage &_du, size_t threads) : du(_du), seen(0, threads), hardlinks(0) { }
+		size_t links_skipped() const BOOST_NOEXCEPT_OR_NOTHROW { return hardlinks; }
+		bool operator()(const walked_directory &dir, directory_entry &entry)
+		{
+			disk_usage_node *node=(disk_usage_node *) dir.context();
+			if(!node)
+			{
+				// Our parent's node was set when its entries were delivered, which included our own node
+				node=dir.parent() ? ((disk_usage_node *) dir.parent()->context())->_children.at(dir.leafname()).get() : &du._root;
+				dir.set_context(node);
+			}
+			have_metadata_flags ready=entry.metadata_ready();
+			// Else it was deleted since being enumerated
+			if(!ready.have_type)
+				return true;
+			if(S_IFDIR==entry.st_type())
+			{
+				std::unique_ptr<disk_usage_node> child(new disk_usage_node(node, entry.name().native()));
+				child->_own.directories=1;
+				add(child->_own, entry);
+				node->_children[child->_leafname]=std::move(child);
+				return true;
+			}
+			if(ready.have_nlink && entry.st_nlink()>1 && !seen.insert(ready.have_dev ? entry.st_dev() : 0, entry.st_ino()))
+			{
+				++hardlinks;
+				return true;
+			}
+			++node->_own.files;
+			add(node->_own, entry);
+			return true;
+		}
+	};
+}
+
+std::unique_ptr<disk_usage> disk_usage::measure(const std::filesystem::path &root, walk_options options)
+{
+	if(!begin_enumerate_directory(root))
+		return nullptr;
+	std::unique_ptr<disk_usage> ret(new disk_usage(root.native()));
+	ret->_root._own.directories=1;
+#ifndef WIN32
+	struct stat s;
+	if(-1!=::stat(root.c_str(), &s))
+	{
+		ret->_root._own.allocated=(uint64_t) s.st_blocks*512;
+		ret->_root._own.size=s.st_size;
+	}
+#endif
+	options.metadata.value=0;
+	options.metadata.have_type=options.metadata.have_size=options.metadata.have_nlink=options.metadata.have_ino=options.metadata.have_dev=1;
+#ifdef WIN32
+	options.metadata.have_allocated=1;
+#else
+	options.metadata.have_blocks=1;
+#endif
+	options.batch_metadata=false;
+	// Enough threads per CPU to overlap the waits for storage, and no more, as on a warm cache each is just
+	// another to switch between
+	if(!options.threads)
+		options.threads=4*std::max((size_t) std::thread::hardware_concurrency(), (size_t) 1);
+	detail::disk_usage_builder builder(*ret, options.threads);
+	detail::walk_error_counter unreadable(options);
+	// A visited set drops repeats of inodes before they get to us
+	size_t repeats=options.visited ? options.visited->repeats() : 0;
+	ret->_entries=walk_tree(root, options, builder);
+	ret->_hardlinks=builder.links_skipped();
+	ret->_unreadable=unreadable.count();
+	if(options.visited)
+		ret->_hardlinks+=options.visited->repeats()-repeats;
+	// Sum the subtrees bottom up, every node coming after its parent in order
+	std::vector<disk_usage_node *> order(1, &ret->_root);
+	for(size_t n=0; n<order.size(); n++)
+	{
+		order[n]->_total=order[n]->_own;
+		for(auto &child : order[n]->_children)
+			order.push_back(child.second.get());
+	}
+	for(size_t n=order.size(); n-->1;)
+		order[n]->_parent->_total+=order[n]->_total;
+	return ret;
+}
+
+const disk_usage_node *disk_usage::find(const std::filesystem::path &path) const
+{
+	const disk_usage_node *node=&_root;
+	for(auto &part : path)
+	{
+		if(part.empty() || part==std::filesystem::path("."))
+			continue;
+		if(!(node=node->find(part)))
+			break;
+	}
+	return node;
+}
+
+std::vector<const disk_usage_node *> disk_usage::largest(size_t n) const
+{
+	std::vector<const disk_usage_node *> ret;
+	for(auto &child : _root._children)
+		ret.push_back(child.second.get());
+	for(size_t i=0; i<ret.size(); i++)
+		for(auto &child : ret[i]->_children)
+			ret.push_back(child.second.get());
+	n=std::min(n, ret.size());
+	std::partial_sort(ret.begin(), ret.begin()+n, ret.end(), [](const disk_usage_node *a, const disk_usage_node *b) { return a->total().allocated>b->total().allocated; });
+	ret.resize(n);
+	return ret;
+}
+
+} // namespace
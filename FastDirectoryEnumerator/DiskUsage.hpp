@@ -0,0 +1,114 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_DISKUSAGE_H
+#define FASTDIRECTORYENUMERATOR_DISKUSAGE_H
+
+#include "TreeWalker.hpp"
+#include <unordered_map>
+
+namespace FastDirectoryEnumerator
+{
+	namespace detail { class disk_usage_builder; }
+
+	//! What a directory, or a whole subtree, uses
+	struct disk_usage_totals
+	{
+		uint64_t allocated;   //!< Bytes allocated on storage, which is what `du` reports
+		uint64_t size;        //!< Bytes of content, which is what `du --apparent-size` reports
+		size_t files;         //!< Entries which aren't directories, each hard linked inode counted once
+		size_t directories;   //!< Directories, including the directory itself
+		disk_usage_totals() : allocated(0), size(0), files(0), directories(0) { }
+		disk_usage_totals &operator+=(const disk_usage_totals &o) BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			allocated+=o.allocated;
+			size+=o.size;
+			files+=o.files;
+			directories+=o.directories;
+			return *this;
+		}
+	};
+
+	//! A directory in the tree `disk_usage::measure()` returns
+	class FASTDIRECTORYENUMERATOR_API disk_usage_node
+	{
+		friend class disk_usage;
+		friend class detail::disk_usage_builder;
+	public:
+		typedef std::unordered_map<std::filesystem::path::string_type, std::unique_ptr<disk_usage_node>> children_type;
+	private:
+		disk_usage_node *_parent;
+		std::filesystem::path::string_type _leafname;
+		disk_usage_totals _own, _total;
+		children_type _children;
+		disk_usage_node(disk_usage_node *parent, std::filesystem::path::string_type leafname) : _parent(parent), _leafname(std::move(leafname)) { }
+		disk_usage_node(const disk_usage_node &) = delete;
+		disk_usage_node &operator=(const disk_usage_node &) = delete;
+	public:
+		//! The directory containing this one, null for the root
+		const disk_usage_node *parent() const BOOST_NOEXCEPT_OR_NOTHROW { return _parent; }
+		//! The leafname of this directory. For the root, the path it was measured as.
+		const std::filesystem::path::string_type &leafname() const BOOST_NOEXCEPT_OR_NOTHROW { return _leafname; }
+		//! Reconstructs the full path of this directory from the parent chain
+		std::filesystem::path path() const;
+		//! What this directory and the entries directly within it use
+		const disk_usage_totals &own() const BOOST_NOEXCEPT_OR_NOTHROW { return _own; }
+		//! What this directory and everything below it use
+		const disk_usage_totals &total() const BOOST_NOEXCEPT_OR_NOTHROW { return _total; }
+		//! The subdirectories, keyed by leafname
+		const children_type &children() const BOOST_NOEXCEPT_OR_NOTHROW { return _children; }
+		//! The subdirectory called leafname, or null if there is none
+		const disk_usage_node *find(const std::filesystem::path &leafname) const
+		{
+			auto it=_children.find(leafname.native());
+			return _children.end()==it ? nullptr : it->second.get();
+		}
+	};
+
+	/*! \brief The disk usage of every directory in a tree, like `du` prints.
+
+	`measure()` walks the tree with `walk_tree()`, fetching only the type, size, blocks, link count and inode
+	of each entry, relative to its directory, an entry at a time. The waits for storage are overlapped by
+	running a few worker threads per CPU, as each lookup served from cache costs less that way than in a
+	batch. Each worker thread adds the entries it delivers to the node of their directory, so no locks are
+	taken per entry, and once the walk ends the totals of every subtree are summed bottom up. Inodes with
+	more than one hard link are only counted the first time they are met, using an `inode_set` of just those.
+	Set `walk_options::visited` to also stop at cycles made by bind mounts, at the cost of every inode going
+	into the set.
+
+	On POSIX bytes allocated are `st_blocks()` times 512, as `du` counts them, rather than `st_allocated()`.
+	*/
+	class FASTDIRECTORYENUMERATOR_API disk_usage
+	{
+		friend class detail::disk_usage_builder;
+		disk_usage_node _root;
+		size_t _entries, _hardlinks, _unreadable;
+		explicit disk_usage(std::filesystem::path::string_type root) : _root(nullptr, std::move(root)), _entries(0), _hardlinks(0), _unreadable(0) { }
+		disk_usage(const disk_usage &) = delete;
+		disk_usage &operator=(const disk_usage &) = delete;
+	public:
+		/*! \brief Measures the tree under root, returning a null pointer if it could not be opened.
+
+		Metadata other than what is needed is not fetched whatever `options.metadata` says. If `options.threads`
+		is zero, four worker threads per hardware thread are used.
+		*/
+		static std::unique_ptr<disk_usage> measure(const std::filesystem::path &root, walk_options options=walk_options());
+		//! The directory measured
+		const disk_usage_node &root() const BOOST_NOEXCEPT_OR_NOTHROW { return _root; }
+		//! The directory at path relative to the root, or null if there is none
+		const disk_usage_node *find(const std::filesystem::path &path) const;
+		//! The n subdirectories with the most bytes allocated in their subtrees, largest first. The root is not included.
+		std::vector<const disk_usage_node *> largest(size_t n) const;
+		//! The number of entries walked
+		size_t entries() const BOOST_NOEXCEPT_OR_NOTHROW { return _entries; }
+		//! The number of entries not counted because their inode had already been
+		size_t hardlinks() const BOOST_NOEXCEPT_OR_NOTHROW { return _hardlinks; }
+		//! The number of directories which could not be opened, and so whose contents are missing from the totals
+		size_t unreadable() const BOOST_NOEXCEPT_OR_NOTHROW { return _unreadable; }
+	};
+} // namespace
+
+#endif
@@ -0,0 +1,349 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#include "DuplicateFinder.hpp"
+#include "InodeSet.hpp"
+#include <sys/stat.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+namespace FastDirectoryEnumerator
+{
+
+namespace detail
+{
+	static BOOST_CONSTEXPR_OR_CONST uint64_t xxh_prime1=11400714785074694791ULL, xxh_prime2=14029467366897019727ULL, xxh_prime3=1609587929392839161ULL,
+		xxh_prime4=9650029242287828579ULL, xxh_prime5=2870177450012600261ULL;
+	static inline uint64_t xxh_rotl(uint64_t x, int r) BOOST_NOEXCEPT_OR_NOTHROW { return (x<<r)|(x>>(64-r)); }
+	static inline uint64_t xxh_read64(const unsigned char *p) BOOST_NOEXCEPT_OR_NOTHROW { uint64_t v; memcpy(&v, p, 8); return v; }
+	static inline uint32_t xxh_read32(const unsigned char *p) BOOST_NOEXCEPT_OR_NOTHROW { uint32_t v; memcpy(&v, p, 4); return v; }
+	static inline uint64_t xxh_round(uint64_t acc, uint64_t input) BOOST_NOEXCEPT_OR_NOTHROW { return xxh_rotl(acc+input*xxh_prime2, 31)*xxh_prime1; }
+	static inline uint64_t xxh_merge(uint64_t acc, uint64_t val) BOOST_NOEXCEPT_OR_NOTHROW { return (acc^xxh_round(0, val))*xxh_prime1+xxh_prime4; }
+
+	uint64_t xxhash64(const void *data, size_t len, uint64_t seed) BOOST_NOEXCEPT_OR_NOTHROW
+	{
+		const unsigned char *p=(const unsigned char *) data, *end=p+len;
+		uint64_t h;
+		if(len>=32)
+		{
+			uint64_t v1=seed+xxh_prime1+xxh_prime2, v2=seed+xxh_prime2, v3=seed, v4=seed-xxh_prime1;
+			for(const unsigned char *limit=end-32; p<=limit; p+=32)
+			{
+				v1=xxh_round(v1, xxh_read64(p));
+				v2=xxh_round(v2, xxh_read64(p+8));
+				v3=xxh_round(v3, xxh_read64(p+16));
+				v4=xxh_round(v4, xxh_read64(p+24));
+			}
+			h=xxh_rotl(v1, 1)+xxh_rotl(v2, 7)+xxh_rotl(v3, 12)+xxh_rotl(v4, 18);
+			h=xxh_merge(h, v1);
+			h=xxh_merge(h, v2);
+			h=xxh_merge(h, v3);
+			h=xxh_merge(h, v4);
+		}
+		else
+			h=seed+xxh_prime5;
+		h+=len;
+		for(; p+8<=end; p+=8)
+			h=xxh_rotl(h^xxh_round(0, xxh_read64(p)), 27)*xxh_prime1+xxh_prime4;
+		if(p+4<=end)
+		{
+			h=xxh_rotl(h^(xxh_read32(p)*xxh_prime1), 23)*xxh_prime2+xxh_prime3;
+			p+=4;
+		}
+		for(; p<end; p++)
+			h=xxh_rotl(h^(*p*xxh_prime5), 11)*xxh_prime1;
+		h^=h>>33;
+		h*=xxh_prime2;
+		h^=h>>29;
+		h*=xxh_prime3;
+		h^=h>>32;
+		return h;
+	}
+}
+
+namespace
+{
+	struct candidate
+	{
+		size_t dir;     // index into the directory paths
+		std::filesystem::path::string_type leafname;
+		uint64_t size, hash;
+		bool complete;  // hashed in full
+		bool failed;    // couldn't be read, or changed size
+	};
+
+	// Page aligned memory straight from the kernel to read into
+	class read_buffer
+	{
+		char *_p;
+		size_t _size;
+		read_buffer(const read_buffer &) = delete;
+		read_buffer &operator=(const read_buffer &) = delete;
+	public:
+		explicit read_buffer(size_t size) : _p(nullptr), _size(size)
+		{
+#ifdef WIN32
+			_p=(char *) VirtualAlloc(nullptr, size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+#else
+			void *mem=mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+			_p=(MAP_FAILED==mem) ? nullptr : (char *) mem;
+#endif
+			if(!_p)
+				throw std::bad_alloc();
+		}
+		~read_buffer()
+		{
+#ifdef WIN32
+			VirtualFree(_p, 0, MEM_RELEASE);
+#else
+			munmap(_p, _size);
+#endif
+		}
+		char *data() const BOOST_NOEXCEPT_OR_NOTHROW { return _p; }
+		size_t size() const BOOST_NOEXCEPT_OR_NOTHROW { return _size; }
+	};
+
+	class read_file
+	{
+#ifdef WIN32
+		HANDLE _h;
+#else
+		int _fd;
+#endif
+		read_file(const read_file &) = delete;
+		read_file &operator=(const read_file &) = delete;
+	public:
+		read_file(const std::filesystem::path &path, bool sequential)
+		{
+#ifdef WIN32
+			_h=CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0, nullptr);
+#else
+			_fd=::open(path.c_str(), O_RDONLY|O_CLOEXEC|O_NOCTTY);
+#if defined(POSIX_FADV_SEQUENTIAL)
+			if(-1!=_fd && sequential)
+				posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+		}
+		~read_file()
+		{
+#ifdef WIN32
+			if(INVALID_HANDLE_VALUE!=_h) CloseHandle(_h);
+#else
+			if(-1!=_fd) ::close(_fd);
+#endif
+		}
+#ifdef WIN32
+		bool is_open() const BOOST_NOEXCEPT_OR_NOTHROW { return INVALID_HANDLE_VALUE!=_h; }
+#else
+		bool is_open() const BOOST_NOEXCEPT_OR_NOTHROW { return -1!=_fd; }
+#endif
+		// Reads len bytes at offset, returning how many were read, which is fewer only at the end of the file or on error
+		size_t read(char *buffer, size_t len, uint64_t offset)
+		{
+			size_t done=0;
+			while(done<len)
+			{
+#ifdef WIN32
+				OVERLAPPED ol={ 0 };
+				ol.Offset=(DWORD)(offset+done);
+				ol.OffsetHigh=(DWORD)((offset+done)>>32);
+				DWORD bytes=0;
+				if(!ReadFile(_h, buffer+done, (DWORD) std::min(len-done, (size_t) 1<<30), &bytes, &ol) || !bytes)
+					break;
+#else
+				ssize_t bytes=::pread(_fd, buffer+done, len-done, (off_t)(offset+done));
+				if(-1==bytes && EINTR==errno)
+					continue;
+				if(bytes<=0)
+					break;
+#endif
+				done+=(size_t) bytes;
+			}
+			return done;
+		}
+	};
+
+	// Calls f(candidate &, read_buffer &) for each of items from threads threads, each with its own buffer
+	template<class F> void parallel_read(std::vector<candidate *> &items, size_t threads, size_t buffersize, F f)
+	{
+		std::atomic<size_t> next(0);
+		std::mutex errorlock;
+		std::exception_ptr error;
+		auto run=[&] {
+			try
+			{
+				read_buffer buffer(buffersize);
+				for(size_t n; (n=next++)<items.size();)
+					f(*items[n], buffer);
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> g(errorlock);
+				if(!error)
+					error=std::current_exception();
+				next=items.size();
+			}
+		};
+		threads=std::max(std::min(threads, items.size()), (size_t) 1);
+		std::vector<std::thread> workers;
+		for(size_t n=1; n<threads; n++)
+			workers.push_back(std::thread(run));
+		run();
+		for(auto &worker : workers)
+			worker.join();
+		if(error)
+			std::rethrow_exception(error);
+	}
+
+	// Calls f(begin, end) for each run of at least two items of the same size and hash, once sorted so
+	template<class F> void for_each_run(std::vector<candidate *> &items, F f)
+	{
+		std::sort(items.begin(), items.end(), [](const candidate *a, const candidate *b) { return a->size<b->size || (a->size==b->size && a->hash<b->hash); });
+		for(size_t n=0; n<items.size();)
+		{
+			size_t m=n+1;
+			while(m<items.size() && items[m]->size==items[n]->size && items[m]->hash==items[n]->hash)
+				m++;
+			if(m-n>1)
+				f(items.data()+n, items.data()+m);
+			n=m;
+		}
+	}
+}
+
+duplicate_report find_duplicates(const std::filesystem::path &root, const duplicate_options &options)
+{
+	duplicate_report ret;
+	std::vector<std::filesystem::path> dirs;
+	std::vector<candidate> files;
+	inode_set links(0, options.walk.threads);
+	std::mutex lock;
+	walk_options walk(options.walk);
+	walk.metadata.value=0;
+	walk.metadata.have_type=walk.metadata.have_size=walk.metadata.have_nlink=walk.metadata.have_ino=walk.metadata.have_dev=1;
+	detail::walk_error_counter unreadable(walk);
+	// Stage one: bucket by size
+	walk_tree(root, walk, [&](const walked_directory &dir, directory_entry &entry) {
+		have_metadata_flags ready=entry.metadata_ready();
+		if(!ready.have_type || S_IFREG!=entry.st_type() || !ready.have_size || (uint64_t) entry.st_size()<options.min_size)
+			return true;
+		if(ready.have_nlink && entry.st_nlink()>1 && !links.insert(ready.have_dev ? entry.st_dev() : 0, entry.st_ino()))
+			return true;
+		std::lock_guard<std::mutex> g(lock);
+		// The context holds the index of the directory's path plus one, so the path is built once per directory
+		if(!dir.context())
+		{
+			dirs.push_back(dir.path());
+			dir.set_context((void *) dirs.size());
+		}
+		candidate c={ (size_t) dir.context()-1, entry.name().native(), (uint64_t) entry.st_size(), 0, false, false };
+		files.push_back(std::move(c));
+		return true;
+	});
+	ret.files=files.size();
+	ret.unreadable=unreadable.count();
+	std::vector<candidate *> items;
+	items.reserve(files.size());
+	for(auto &c : files)
+		items.push_back(&c);
+	std::vector<candidate *> sized;
+	for_each_run(items, [&sized](candidate **begin, candidate **end) { sized.insert(sized.end(), begin, end); });
+	ret.same_size=sized.size();
+	// Stage two: hash the ends
+	size_t threads=options.threads ? options.threads : 4*std::max((size_t) std::thread::hardware_concurrency(), (size_t) 1);
+	size_t edge=std::max(options.edge_size, (size_t) 1);
+	// Big enough to notice a file of both ends has grown
+	size_t buffersize=std::max(options.read_size, 2*edge+1);
+	buffersize=(buffersize+65535)&~(size_t) 65535;
+	std::atomic<uint64_t> bytes_read(0);
+	parallel_read(sized, threads, buffersize, [&](candidate &c, read_buffer &buffer) {
+		read_file f(dirs[c.dir]/c.leafname, false);
+		if(!f.is_open())
+		{
+			c.failed=true;
+			return;
+		}
+		if(c.size<=2*edge)
+		{
+			size_t bytes=f.read(buffer.data(), (size_t) c.size+1, 0);
+			c.failed=(bytes!=c.size);
+			c.hash=detail::xxhash64(buffer.data(), bytes);
+			c.complete=true;
+			bytes_read+=bytes;
+			return;
+		}
+		size_t head=f.read(buffer.data(), edge, 0);
+		size_t tail=f.read(buffer.data()+edge, edge, c.size-edge);
+		c.failed=(head!=edge || tail!=edge);
+		c.hash=detail::xxhash64(buffer.data(), 2*edge);
+		bytes_read+=head+tail;
+	});
+	sized.erase(std::remove_if(sized.begin(), sized.end(), [](const candidate *c) { return c->failed; }), sized.end());
+	std::vector<candidate *> edged;
+	for_each_run(sized, [&](candidate **begin, candidate **end) {
+		if((*begin)->complete)
+		{
+			duplicate_group group;
+			group.size=(*begin)->size;
+			for(candidate **c=begin; c!=end; ++c)
+				group.paths.push_back(dirs[(*c)->dir]/(*c)->leafname);
+			ret.groups.push_back(std::move(group));
+		}
+		else
+			edged.insert(edged.end(), begin, end);
+	});
+	ret.same_edges=edged.size();
+	// Stage three: hash in full
+	size_t chunk=buffersize;
+	parallel_read(edged, threads, buffersize, [&](candidate &c, read_buffer &buffer) {
+		read_file f(dirs[c.dir]/c.leafname, true);
+		if(!f.is_open())
+		{
+			c.failed=true;
+			return;
+		}
+		uint64_t hash=0, offset=0;
+		for(;;)
+		{
+			size_t bytes=f.read(buffer.data(), chunk, offset);
+			hash=detail::xxhash64(buffer.data(), bytes, hash);
+			offset+=bytes;
+			bytes_read+=bytes;
+			if(bytes<chunk)
+				break;
+		}
+		c.failed=(offset!=c.size);
+		c.hash=hash;
+	});
+	edged.erase(std::remove_if(edged.begin(), edged.end(), [](const candidate *c) { return c->failed; }), edged.end());
+	for_each_run(edged, [&](candidate **begin, candidate **end) {
+		duplicate_group group;
+		group.size=(*begin)->size;
+		for(candidate **c=begin; c!=end; ++c)
+			group.paths.push_back(dirs[(*c)->dir]/(*c)->leafname);
+		ret.groups.push_back(std::move(group));
+	});
+	ret.bytes_read=bytes_read;
+	std::sort(ret.groups.begin(), ret.groups.end(), [](const duplicate_group &a, const duplicate_group &b) {
+		return a.size*(a.paths.size()-1)>b.size*(b.paths.size()-1);
+	});
+	return ret;
+}
+
+} // namespace
@@ -0,0 +1,69 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_DUPLICATEFINDER_H
+#define FASTDIRECTORYENUMERATOR_DUPLICATEFINDER_H
+
+#include "TreeWalker.hpp"
+
+namespace FastDirectoryEnumerator
+{
+	//! Options for `find_duplicates()`
+	struct duplicate_options
+	{
+		walk_options walk;     //!< How to walk the tree. Only the metadata needed is fetched whatever `walk.metadata` says.
+		uint64_t min_size;     //!< Files smaller than this are ignored, by default empty ones
+		size_t edge_size;      //!< Bytes hashed from each end of a file before hashing all of it
+		size_t read_size;      //!< Bytes read at a time when hashing all of a file
+		size_t threads;        //!< Threads reading files, zero meaning four per hardware thread
+		duplicate_options() : min_size(1), edge_size(4096), read_size(1024*1024), threads(0) { }
+	};
+
+	//! Files with the same contents
+	struct duplicate_group
+	{
+		uint64_t size;                                //!< The size of each file
+		std::vector<std::filesystem::path> paths;     //!< The paths of the files, in no particular order
+	};
+
+	//! What `find_duplicates()` found
+	struct duplicate_report
+	{
+		std::vector<duplicate_group> groups;  //!< The groups of duplicates, largest wasted space first
+		size_t files;                         //!< Regular files found, each hard linked inode counted once
+		size_t same_size;                     //!< Files sharing their size with another, which had their ends hashed
+		size_t same_edges;                    //!< Files sharing their size and ends with another, which were hashed in full
+		uint64_t bytes_read;                  //!< Bytes read from files
+		size_t unreadable;                    //!< Directories which could not be opened, so whose files were never considered
+		duplicate_report() : files(0), same_size(0), same_edges(0), bytes_read(0), unreadable(0) { }
+	};
+
+	/*! \brief Finds the regular files under root with the same contents.
+
+	Runs as a pipeline which reads as little as it can:
+
+	1. `walk_tree()` fetches just the type, size, inode and link count of every entry, and files are bucketed
+	by `st_size`. A file with a size no other has can have no duplicate, so is never read.
+	2. The first and last `options.edge_size` bytes of each remaining file are hashed, and files are bucketed
+	again by size and that hash. Files no bigger than both ends are hashed in full here and are done.
+	3. The files still sharing a bucket are hashed in full, `options.read_size` bytes at a time.
+
+	The hash is 64 bit xxHash, each read seeded with the hash of those before, which is fast but not
+	cryptographic, so compare the files byte by byte before doing anything irreversible to them. The files of
+	each stage are read by `options.threads` threads into page aligned buffers, each file sequentially. Hard
+	links to one inode are not duplicates, as they take no more space, so only the first met is considered.
+	Files which can't be read, or whose size changes while being read, are left out.
+	*/
+	extern FASTDIRECTORYENUMERATOR_API duplicate_report find_duplicates(const std::filesystem::path &root, const duplicate_options &options=duplicate_options());
+
+	namespace detail
+	{
+		//! The 64 bit xxHash of [data, data+len) with seed
+		extern FASTDIRECTORYENUMERATOR_API uint64_t xxhash64(const void *data, size_t len, uint64_t seed=0) BOOST_NOEXCEPT_OR_NOTHROW;
+	}
+} // namespace
+
+#endif
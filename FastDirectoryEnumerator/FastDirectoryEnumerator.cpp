@@ -1,903 +1,2793 @@
-/* FastDirectoryEnumerator
-Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
-(C) 2013 Niall Douglas http://www.nedprod.com/
-File created: Aug 2013
-*/
-
-#define __USE_XOPEN2K8 // Turns on timespecs in Linux
-#include "FastDirectoryEnumerator.hpp"
-#include "Undoer.hpp"
-#include <sys/stat.h>
-#ifdef WIN32
-#include <Windows.h>
-#include "boost/thread/tss.hpp"
-#else
-#ifndef _GNU_SOURCE
-#define _GNU_SOURCE
-#endif
-#include <dirent.h>     /* Defines DT_* constants */
-#include <fcntl.h>
-#include <stdio.h>
-#include <unistd.h>
-#include <stdlib.h>
-#include <sys/syscall.h>
-#include <fnmatch.h>
-#endif
-
-namespace FastDirectoryEnumerator
-{
-
-#ifdef WIN32
-#define TIMESPEC_TO_FILETIME_OFFSET (((long long)27111902 << 32) + (long long)3577643008)
-
-static inline struct timespec to_timespec(LARGE_INTEGER time)
-{
-	struct timespec ts;
-	ts.tv_sec = ((time.QuadPart - TIMESPEC_TO_FILETIME_OFFSET) / 10000000);
-	ts.tv_nsec = (long)((time.QuadPart - TIMESPEC_TO_FILETIME_OFFSET - ((long long)ts.tv_sec * (long long)10000000)) * 100);
-	return ts;
-}
-
-static inline uint16_t to_st_type(ULONG FileAttributes, uint16_t mode=0)
-{
-	if(FileAttributes&FILE_ATTRIBUTE_REPARSE_POINT)
-		mode|=S_IFLNK;
-	else if(FileAttributes&FILE_ATTRIBUTE_DIRECTORY)
-		mode|=S_IFDIR;
-	else
-		mode|=S_IFREG;
-	return mode;
-}
-#endif
-
-have_metadata_flags directory_entry::metadata_supported() BOOST_NOEXCEPT_OR_NOTHROW
-{
-	have_metadata_flags ret; ret.value=0;
-#ifdef WIN32
-	ret.have_dev=0;
-	ret.have_ino=1;        // FILE_INTERNAL_INFORMATION, enumerated
-	ret.have_type=1;       // FILE_BASIC_INFORMATION, enumerated
-	ret.have_mode=0;
-	ret.have_nlink=1;      // FILE_STANDARD_INFORMATION
-	ret.have_uid=0;
-	ret.have_gid=0;
-	ret.have_rdev=0;
-	ret.have_atim=1;       // FILE_BASIC_INFORMATION, enumerated
-	ret.have_mtim=1;       // FILE_BASIC_INFORMATION, enumerated
-	ret.have_ctim=1;       // FILE_BASIC_INFORMATION, enumerated
-	ret.have_size=1;       // FILE_STANDARD_INFORMATION, enumerated
-	ret.have_allocated=1;  // FILE_STANDARD_INFORMATION, enumerated
-	ret.have_blocks=1;
-	ret.have_blksize=1;    // FILE_ALIGNMENT_INFORMATION
-	ret.have_flags=0;
-	ret.have_gen=0;
-	ret.have_birthtim=1;   // FILE_BASIC_INFORMATION, enumerated
-#elif defined(__linux__)
-	ret.have_dev=1;
-	ret.have_ino=1;
-	ret.have_type=1;
-	ret.have_mode=1;
-	ret.have_nlink=1;
-	ret.have_uid=1;
-	ret.have_gid=1;
-	ret.have_rdev=1;
-	ret.have_atim=1;
-	ret.have_mtim=1;
-	ret.have_ctim=1;
-	ret.have_size=1;
-	ret.have_allocated=1;
-	ret.have_blocks=1;
-	ret.have_blksize=1;
-	// Sadly these must wait until someone fixes the Linux stat() call e.g. the xstat() proposal.
-	ret.have_flags=0;
-	ret.have_gen=0;
-	ret.have_birthtim=0;
-	// According to http://computer-forensics.sans.org/blog/2011/03/14/digital-forensics-understanding-ext4-part-2-timestamps
-	// ext4 keeps birth time at offset 144 to 151 in the inode. If we ever got round to it, birthtime could be hacked.
-#else
-	// Kinda assumes FreeBSD or OS X really ...
-	ret.have_dev=1;
-	ret.have_ino=1;
-	ret.have_type=1;
-	ret.have_mode=1;
-	ret.have_nlink=1;
-	ret.have_uid=1;
-	ret.have_gid=1;
-	ret.have_rdev=1;
-	ret.have_atim=1;
-	ret.have_mtim=1;
-	ret.have_ctim=1;
-	ret.have_size=1;
-	ret.have_allocated=1;
-	ret.have_blocks=1;
-	ret.have_blksize=1;
-#define HAVE_STAT_FLAGS
-	ret.have_flags=1;
-#define HAVE_STAT_GEN
-	ret.have_gen=1;
-#define HAVE_BIRTHTIMESPEC
-	ret.have_birthtim=1;
-#endif
-	return ret;
-}
-
-void directory_entry::_int_fetch(have_metadata_flags wanted, std::filesystem::path prefix)
-{
-#ifdef WIN32
-	// From http://undocumented.ntinternals.net/UserMode/Undocumented%20Functions/NT%20Objects/File/FILE_INFORMATION_CLASS.html
-	typedef enum _FILE_INFORMATION_CLASS {
-		FileDirectoryInformation                 = 1,
-		FileFullDirectoryInformation,
-		FileBothDirectoryInformation,
-		FileBasicInformation,
-		FileStandardInformation,
-		FileInternalInformation,
-		FileEaInformation,
-		FileAccessInformation,
-		FileNameInformation,
-		FileRenameInformation,
-		FileLinkInformation,
-		FileNamesInformation,
-		FileDispositionInformation,
-		FilePositionInformation,
-		FileFullEaInformation,
-		FileModeInformation,
-		FileAlignmentInformation,
-		FileAllInformation,
-		FileAllocationInformation,
-		FileEndOfFileInformation,
-		FileAlternateNameInformation,
-		FileStreamInformation,
-		FilePipeInformation,
-		FilePipeLocalInformation,
-		FilePipeRemoteInformation,
-		FileMailslotQueryInformation,
-		FileMailslotSetInformation,
-		FileCompressionInformation,
-		FileObjectIdInformation,
-		FileCompletionInformation,
-		FileMoveClusterInformation,
-		FileQuotaInformation,
-		FileReparsePointInformation,
-		FileNetworkOpenInformation,
-		FileAttributeTagInformation,
-		FileTrackingInformation,
-		FileIdBothDirectoryInformation,
-		FileIdFullDirectoryInformation,
-		FileValidDataLengthInformation,
-		FileShortNameInformation,
-		FileIoCompletionNotificationInformation,
-		FileIoStatusBlockRangeInformation,
-		FileIoPriorityHintInformation,
-		FileSfioReserveInformation,
-		FileSfioVolumeInformation,
-		FileHardLinkInformation,
-		FileProcessIdsUsingFileInformation,
-		FileNormalizedNameInformation,
-		FileNetworkPhysicalNameInformation,
-		FileIdGlobalTxDirectoryInformation,
-		FileIsRemoteDeviceInformation,
-		FileAttributeCacheInformation,
-		FileNumaNodeInformation,
-		FileStandardLinkInformation,
-		FileRemoteProtocolInformation,
-		FileMaximumInformation
-	} FILE_INFORMATION_CLASS, *PFILE_INFORMATION_CLASS;
-
-	typedef enum  { 
-	  FileFsVolumeInformation       = 1,
-	  FileFsLabelInformation        = 2,
-	  FileFsSizeInformation         = 3,
-	  FileFsDeviceInformation       = 4,
-	  FileFsAttributeInformation    = 5,
-	  FileFsControlInformation      = 6,
-	  FileFsFullSizeInformation     = 7,
-	  FileFsObjectIdInformation     = 8,
-	  FileFsDriverPathInformation   = 9,
-	  FileFsVolumeFlagsInformation  = 10,
-	  FileFsSectorSizeInformation   = 11
-	} FS_INFORMATION_CLASS;
-#ifndef NTSTATUS
-#define NTSTATUS LONG
-#endif
-
-	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff550671(v=vs.85).aspx
-	typedef struct _IO_STATUS_BLOCK {
-		union {
-			NTSTATUS Status;
-			PVOID    Pointer;
-		};
-		ULONG_PTR Information;
-	} IO_STATUS_BLOCK, *PIO_STATUS_BLOCK;
-
-	// From http://msdn.microsoft.com/en-us/library/windows/desktop/aa380518(v=vs.85).aspx
-	typedef struct _LSA_UNICODE_STRING {
-	  USHORT Length;
-	  USHORT MaximumLength;
-	  PWSTR  Buffer;
-	} LSA_UNICODE_STRING, *PLSA_UNICODE_STRING, UNICODE_STRING, *PUNICODE_STRING;
-
-	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff557749(v=vs.85).aspx
-	typedef struct _OBJECT_ATTRIBUTES {
-	  ULONG           Length;
-	  HANDLE          RootDirectory;
-	  PUNICODE_STRING ObjectName;
-	  ULONG           Attributes;
-	  PVOID           SecurityDescriptor;
-	  PVOID           SecurityQualityOfService;
-	}  OBJECT_ATTRIBUTES, *POBJECT_ATTRIBUTES;
-
-	typedef struct _RTLP_CURDIR_REF
-	{
-		LONG RefCount;
-		HANDLE Handle;
-	} RTLP_CURDIR_REF, *PRTLP_CURDIR_REF;
-
-	typedef struct RTL_RELATIVE_NAME_U {
-		UNICODE_STRING RelativeName;
-		HANDLE ContainingDirectory;
-		PRTLP_CURDIR_REF CurDirRef;
-	} RTL_RELATIVE_NAME_U, *PRTL_RELATIVE_NAME_U;
-
-	// From http://undocumented.ntinternals.net/UserMode/Undocumented%20Functions/NT%20Objects/File/NtQueryInformationFile.html
-	// and http://msdn.microsoft.com/en-us/library/windows/hardware/ff567052(v=vs.85).aspx
-	typedef NTSTATUS (NTAPI *NtQueryInformationFile_t)(
-		/*_In_*/   HANDLE FileHandle,
-		/*_Out_*/  PIO_STATUS_BLOCK IoStatusBlock,
-		/*_Out_*/  PVOID FileInformation,
-		/*_In_*/   ULONG Length,
-		/*_In_*/   FILE_INFORMATION_CLASS FileInformationClass
-		);
-
-	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff567070(v=vs.85).aspx
-	typedef NTSTATUS (NTAPI *NtQueryVolumeInformationFile_t)(
-		/*_In_*/   HANDLE FileHandle,
-		/*_Out_*/  PIO_STATUS_BLOCK IoStatusBlock,
-		/*_Out_*/  PVOID FsInformation,
-		/*_In_*/   ULONG Length,
-		/*_In_*/   FS_INFORMATION_CLASS FsInformationClass
-		);
-
-	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff566492(v=vs.85).aspx
-	typedef NTSTATUS (NTAPI *NtOpenDirectoryObject_t)(
-	  /*_Out_*/  PHANDLE DirectoryHandle,
-	  /*_In_*/   ACCESS_MASK DesiredAccess,
-	  /*_In_*/   POBJECT_ATTRIBUTES ObjectAttributes
-	);
-
-
-	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff567011(v=vs.85).aspx
-	typedef NTSTATUS (NTAPI *NtOpenFile_t)(
-	  /*_Out_*/  PHANDLE FileHandle,
-	  /*_In_*/   ACCESS_MASK DesiredAccess,
-	  /*_In_*/   POBJECT_ATTRIBUTES ObjectAttributes,
-	  /*_Out_*/  PIO_STATUS_BLOCK IoStatusBlock,
-	  /*_In_*/   ULONG ShareAccess,
-	  /*_In_*/   ULONG OpenOptions
-	);
-
-	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff566424(v=vs.85).aspx
-	typedef NTSTATUS (NTAPI *NtCreateFile_t)(
-	  /*_Out_*/     PHANDLE FileHandle,
-	  /*_In_*/      ACCESS_MASK DesiredAccess,
-	  /*_In_*/      POBJECT_ATTRIBUTES ObjectAttributes,
-	  /*_Out_*/     PIO_STATUS_BLOCK IoStatusBlock,
-	  /*_In_opt_*/  PLARGE_INTEGER AllocationSize,
-	  /*_In_*/      ULONG FileAttributes,
-	  /*_In_*/      ULONG ShareAccess,
-	  /*_In_*/      ULONG CreateDisposition,
-	  /*_In_*/      ULONG CreateOptions,
-	  /*_In_opt_*/  PVOID EaBuffer,
-	  /*_In_*/      ULONG EaLength
-	);
-
-	typedef NTSTATUS (NTAPI *NtClose_t)(
-	  /*_Out_*/  HANDLE FileHandle
-	);
-
-	typedef BOOLEAN (NTAPI *RtlDosPathNameToNtPathName_U_t)(
-                             PCWSTR DosName,
-                             PUNICODE_STRING NtName,
-                             PCWSTR *PartName,
-                             PRTL_RELATIVE_NAME_U RelativeName);
-
-	// From http://undocumented.ntinternals.net/UserMode/Undocumented%20Functions/NT%20Objects/File/NtQueryDirectoryFile.html
-	// and http://msdn.microsoft.com/en-us/library/windows/hardware/ff567047(v=vs.85).aspx
-	typedef NTSTATUS (NTAPI *NtQueryDirectoryFile_t)(
-		/*_In_*/      HANDLE FileHandle,
-		/*_In_opt_*/  HANDLE Event,
-		/*_In_opt_*/  void *ApcRoutine,
-		/*_In_opt_*/  PVOID ApcContext,
-		/*_Out_*/     PIO_STATUS_BLOCK IoStatusBlock,
-		/*_Out_*/     PVOID FileInformation,
-		/*_In_*/      ULONG Length,
-		/*_In_*/      FILE_INFORMATION_CLASS FileInformationClass,
-		/*_In_*/      BOOLEAN ReturnSingleEntry,
-		/*_In_opt_*/  PUNICODE_STRING FileName,
-		/*_In_*/      BOOLEAN RestartScan
-		);
-
-	typedef struct _FILE_BASIC_INFORMATION {
-	  LARGE_INTEGER CreationTime;
-	  LARGE_INTEGER LastAccessTime;
-	  LARGE_INTEGER LastWriteTime;
-	  LARGE_INTEGER ChangeTime;
-	  ULONG         FileAttributes;
-	} FILE_BASIC_INFORMATION, *PFILE_BASIC_INFORMATION;
-
-	typedef struct _FILE_STANDARD_INFORMATION {
-	  LARGE_INTEGER AllocationSize;
-	  LARGE_INTEGER EndOfFile;
-	  ULONG         NumberOfLinks;
-	  BOOLEAN       DeletePending;
-	  BOOLEAN       Directory;
-	} FILE_STANDARD_INFORMATION, *PFILE_STANDARD_INFORMATION;
-
-	typedef struct _FILE_INTERNAL_INFORMATION {
-	  LARGE_INTEGER IndexNumber;
-	} FILE_INTERNAL_INFORMATION, *PFILE_INTERNAL_INFORMATION;
-
-	typedef struct _FILE_EA_INFORMATION {
-	  ULONG EaSize;
-	} FILE_EA_INFORMATION, *PFILE_EA_INFORMATION;
-
-	typedef struct _FILE_ACCESS_INFORMATION {
-	  ACCESS_MASK AccessFlags;
-	} FILE_ACCESS_INFORMATION, *PFILE_ACCESS_INFORMATION;
-
-	typedef struct _FILE_POSITION_INFORMATION {
-	  LARGE_INTEGER CurrentByteOffset;
-	} FILE_POSITION_INFORMATION, *PFILE_POSITION_INFORMATION;
-
-	typedef struct _FILE_MODE_INFORMATION {
-	  ULONG Mode;
-	} FILE_MODE_INFORMATION, *PFILE_MODE_INFORMATION;
-
-	typedef struct _FILE_ALIGNMENT_INFORMATION {
-	  ULONG AlignmentRequirement;
-	} FILE_ALIGNMENT_INFORMATION, *PFILE_ALIGNMENT_INFORMATION;
-
-	typedef struct _FILE_NAME_INFORMATION {
-	  ULONG FileNameLength;
-	  WCHAR FileName[1];
-	} FILE_NAME_INFORMATION, *PFILE_NAME_INFORMATION;
-
-	typedef struct _FILE_ALL_INFORMATION {
-	  FILE_BASIC_INFORMATION     BasicInformation;
-	  FILE_STANDARD_INFORMATION  StandardInformation;
-	  FILE_INTERNAL_INFORMATION  InternalInformation;
-	  FILE_EA_INFORMATION        EaInformation;
-	  FILE_ACCESS_INFORMATION    AccessInformation;
-	  FILE_POSITION_INFORMATION  PositionInformation;
-	  FILE_MODE_INFORMATION      ModeInformation;
-	  FILE_ALIGNMENT_INFORMATION AlignmentInformation;
-	  FILE_NAME_INFORMATION      NameInformation;
-	} FILE_ALL_INFORMATION, *PFILE_ALL_INFORMATION;
-
-	typedef struct _FILE_FS_SECTOR_SIZE_INFORMATION {
-	  ULONG LogicalBytesPerSector;
-	  ULONG PhysicalBytesPerSectorForAtomicity;
-	  ULONG PhysicalBytesPerSectorForPerformance;
-	  ULONG FileSystemEffectivePhysicalBytesPerSectorForAtomicity;
-	  ULONG Flags;
-	  ULONG ByteOffsetForSectorAlignment;
-	  ULONG ByteOffsetForPartitionAlignment;
-	} FILE_FS_SECTOR_SIZE_INFORMATION, *PFILE_FS_SECTOR_SIZE_INFORMATION;
-
-	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff540310(v=vs.85).aspx
-	typedef struct _FILE_ID_FULL_DIR_INFORMATION  {
-	  ULONG         NextEntryOffset;
-	  ULONG         FileIndex;
-	  LARGE_INTEGER CreationTime;
-	  LARGE_INTEGER LastAccessTime;
-	  LARGE_INTEGER LastWriteTime;
-	  LARGE_INTEGER ChangeTime;
-	  LARGE_INTEGER EndOfFile;
-	  LARGE_INTEGER AllocationSize;
-	  ULONG         FileAttributes;
-	  ULONG         FileNameLength;
-	  ULONG         EaSize;
-	  LARGE_INTEGER FileId;
-	  WCHAR         FileName[1];
-	} FILE_ID_FULL_DIR_INFORMATION, *PFILE_ID_FULL_DIR_INFORMATION;
-
-	static NtQueryInformationFile_t NtQueryInformationFile;
-	if(!NtQueryInformationFile)
-		if(!(NtQueryInformationFile=(NtQueryInformationFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtQueryInformationFile")))
-			abort();
-	static NtQueryVolumeInformationFile_t NtQueryVolumeInformationFile;
-	if(!NtQueryVolumeInformationFile)
-		if(!(NtQueryVolumeInformationFile=(NtQueryVolumeInformationFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtQueryVolumeInformationFile")))
-			abort();
-	static NtOpenDirectoryObject_t NtOpenDirectoryObject;
-	if(!NtOpenDirectoryObject)
-		if(!(NtOpenDirectoryObject=(NtOpenDirectoryObject_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtOpenDirectoryObject")))
-			abort();
-	static NtOpenFile_t NtOpenFile;
-	if(!NtOpenFile)
-		if(!(NtOpenFile=(NtOpenFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtOpenFile")))
-			abort();
-	static NtCreateFile_t NtCreateFile;
-	if(!NtCreateFile)
-		if(!(NtCreateFile=(NtCreateFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtCreateFile")))
-			abort();
-	static NtClose_t NtClose;
-	if(!NtClose)
-		if(!(NtClose=(NtClose_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtClose")))
-			abort();
-	static RtlDosPathNameToNtPathName_U_t RtlDosPathNameToNtPathName_U;
-	if(!RtlDosPathNameToNtPathName_U)
-		if(!(RtlDosPathNameToNtPathName_U=(RtlDosPathNameToNtPathName_U_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "RtlDosPathNameToNtPathName_U")))
-			abort();
-
-	static NtQueryDirectoryFile_t NtQueryDirectoryFile;
-	if(!NtQueryDirectoryFile)
-		if(!(NtQueryDirectoryFile=(NtQueryDirectoryFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtQueryDirectoryFile")))
-			abort();
-
-	IO_STATUS_BLOCK isb={ 0 };
-	bool slowPath=(wanted.have_nlink || wanted.have_blocks || wanted.have_blksize);
-
-	// NTFS does *not* perform well when opening handles to files with absolute paths in a directory with lots of entries
-	// I'm assuming this is because NTFS is pure B-tree, so what I'm going to do is open its containing directory as
-	// a separate HANDLE and keep a per-thread cache of that HANDLE so lookups in the same directory are fast.
-	NTSTATUS ntval=0;
-	OBJECT_ATTRIBUTES oa={sizeof(OBJECT_ATTRIBUTES)};
-	struct dirhinfo_t
-	{
-		HANDLE h;
-		UNICODE_STRING path;
-		std::filesystem::path _path;
-		dirhinfo_t() : h(nullptr) { memset(&path, 0, sizeof(path)); }
-		~dirhinfo_t() { if(h) NtClose(h); }
-	};
-	static boost::thread_specific_ptr<dirhinfo_t> _dirhinfo;
-	if(!_dirhinfo.get())
-		_dirhinfo.reset(new dirhinfo_t);
-	dirhinfo_t &dirhinfo=*_dirhinfo;
-	std::filesystem::path::value_type buffer[sizeof(FILE_ALL_INFORMATION)/sizeof(std::filesystem::path::value_type)+32769];
-	prefix=std::filesystem::absolute(prefix);
-	if(dirhinfo._path!=prefix)
-	{
-		if(dirhinfo.h)
-		{
-			NtClose(dirhinfo.h);
-			dirhinfo.h=nullptr;
-		}
-		dirhinfo._path=prefix;
-		dirhinfo.path.Buffer=buffer;
-		dirhinfo.path.Length=dirhinfo.path.MaximumLength=(USHORT) sizeof(buffer);
-		RtlDosPathNameToNtPathName_U(dirhinfo._path.c_str(), &dirhinfo.path, NULL, NULL);
-		oa.ObjectName=&dirhinfo.path;
-		oa.Attributes=0x40/*OBJ_CASE_INSENSITIVE*/;
-		//ntval|=NtOpenDirectoryObject(&dirhinfo.h, 0x1/*DIRECTORY_QUERY*/|0x2/*DIRECTORY_TRAVERSE*/, &oa);
-		ntval=NtOpenFile(&dirhinfo.h, FILE_LIST_DIRECTORY|SYNCHRONIZE, &oa, &isb, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-			0x01/*FILE_DIRECTORY_FILE*/|0x20/*FILE_SYNCHRONOUS_IO_NONALERT*/|0x4000/*FILE_OPEN_FOR_BACKUP_INTENT*/);
-		if(0/*STATUS_SUCCESS*/!=ntval)
-			return;
-	}
-	//slowPath=false;
-
-	if(!slowPath)
-	{
-		// Fast path skips opening a handle per file by enumerating the containing directory using a glob
-		// exactly matching the leafname
-		UNICODE_STRING _glob;
-		_glob.Buffer=const_cast<std::filesystem::path::value_type *>(leafname.c_str());
-		_glob.MaximumLength=(_glob.Length=(USHORT) (leafname.native().size()*sizeof(std::filesystem::path::value_type)))+sizeof(std::filesystem::path::value_type);
-		FILE_ID_FULL_DIR_INFORMATION *ffdi=(FILE_ID_FULL_DIR_INFORMATION *) buffer;
-		if(0/*STATUS_SUCCESS*/!=(ntval=NtQueryDirectoryFile(dirhinfo.h, NULL, NULL, NULL, &isb, ffdi, sizeof(buffer),
-			FileIdFullDirectoryInformation, TRUE, &_glob, FALSE)))
-			return;
-		if(wanted.have_ino) { stat.st_ino=ffdi->FileId.QuadPart; have_metadata.have_ino=1; }
-		if(wanted.have_type) { stat.st_type=to_st_type(ffdi->FileAttributes); have_metadata.have_type=1; }
-		if(wanted.have_atim) { stat.st_atim=to_timespec(ffdi->LastAccessTime); have_metadata.have_atim=1; }
-		if(wanted.have_mtim) { stat.st_mtim=to_timespec(ffdi->LastWriteTime); have_metadata.have_mtim=1; }
-		if(wanted.have_ctim) { stat.st_ctim=to_timespec(ffdi->ChangeTime); have_metadata.have_ctim=1; }
-		if(wanted.have_size) { stat.st_size=ffdi->EndOfFile.QuadPart; have_metadata.have_size=1; }
-		if(wanted.have_allocated) { stat.st_allocated=ffdi->AllocationSize.QuadPart; have_metadata.have_allocated=1; }
-		if(wanted.have_birthtim) { stat.st_birthtim=to_timespec(ffdi->CreationTime); have_metadata.have_birthtim=1; }
-	}
-	else
-	{
-		HANDLE h=nullptr;
-		UNICODE_STRING path;
-		path.Buffer=const_cast<std::filesystem::path::value_type *>(leafname.c_str());
-		path.MaximumLength=(path.Length=(USHORT) (leafname.native().size()*sizeof(std::filesystem::path::value_type)))+sizeof(std::filesystem::path::value_type);
-		oa.ObjectName=&path;
-		oa.RootDirectory=dirhinfo.h;
-		oa.Attributes=0x40/*OBJ_CASE_INSENSITIVE*/; //|0x100/*OBJ_OPENLINK*/;
-		ntval=NtOpenFile(&h, FILE_READ_ATTRIBUTES, &oa, &isb, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-			0x040/*FILE_NON_DIRECTORY_FILE*/|0x4000/*FILE_OPEN_FOR_BACKUP_INTENT*/|0x00200000/*FILE_OPEN_REPARSE_POINT*/);
-		//ntval=NtCreateFile(&h, FILE_READ_ATTRIBUTES, &oa, &isb, NULL, 0, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-		//	0x1/*FILE_OPEN*/, 0x040/*FILE_NON_DIRECTORY_FILE*/|0x4000/*FILE_OPEN_FOR_BACKUP_INTENT*/, NULL, 0);
-		if(0/*STATUS_SUCCESS*/!=ntval)
-			return;
-		auto undirh=detail::Undoer([&h] { NtClose(h); });
-		FILE_ALL_INFORMATION &fai=*(FILE_ALL_INFORMATION *)buffer;
-		FILE_FS_SECTOR_SIZE_INFORMATION ffssi={0};
-		bool needInternal=(wanted.have_ino);
-		bool needBasic=(wanted.have_type || wanted.have_atim || wanted.have_mtim || wanted.have_ctim || wanted.have_birthtim);
-		bool needStandard=(wanted.have_nlink || wanted.have_size || wanted.have_allocated || wanted.have_blocks);
-		// It's not widely known that the NT kernel supplies a stat() equivalent i.e. get me everything in a single syscall
-		// However fetching FileAlignmentInformation which comes with FILE_ALL_INFORMATION is slow as it touches the device driver,
-		// so only use if we need more than one item
-		if((needInternal+needBasic+needStandard)>=2)
-			ntval|=NtQueryInformationFile(h, &isb, &fai, sizeof(buffer), FileAllInformation);
-		else
-		{
-			if(needInternal)
-				ntval|=NtQueryInformationFile(h, &isb, &fai.InternalInformation, sizeof(fai.InternalInformation), FileInternalInformation);
-			if(needBasic)
-				ntval|=NtQueryInformationFile(h, &isb, &fai.BasicInformation, sizeof(fai.BasicInformation), FileBasicInformation);
-			if(needStandard)
-				ntval|=NtQueryInformationFile(h, &isb, &fai.StandardInformation, sizeof(fai.StandardInformation), FileStandardInformation);
-		}
-		if(wanted.have_blocks || wanted.have_blksize)
-			ntval|=NtQueryVolumeInformationFile(h, &isb, &ffssi, sizeof(ffssi), FileFsSectorSizeInformation);
-		if(0/*STATUS_SUCCESS*/!=ntval)
-			return;
-		if(wanted.have_ino) { stat.st_ino=fai.InternalInformation.IndexNumber.QuadPart; have_metadata.have_ino=1; }
-		if(wanted.have_type) { stat.st_type=to_st_type(fai.BasicInformation.FileAttributes); have_metadata.have_type=1; }
-		if(wanted.have_nlink) { stat.st_nlink=(int16_t) fai.StandardInformation.NumberOfLinks; have_metadata.have_nlink=1; }
-		if(wanted.have_atim) { stat.st_atim=to_timespec(fai.BasicInformation.LastAccessTime); have_metadata.have_atim=1; }
-		if(wanted.have_mtim) { stat.st_mtim=to_timespec(fai.BasicInformation.LastWriteTime); have_metadata.have_mtim=1; }
-		if(wanted.have_ctim) { stat.st_ctim=to_timespec(fai.BasicInformation.ChangeTime); have_metadata.have_ctim=1; }
-		if(wanted.have_size) { stat.st_size=fai.StandardInformation.EndOfFile.QuadPart; have_metadata.have_size=1; }
-		if(wanted.have_allocated) { stat.st_allocated=fai.StandardInformation.AllocationSize.QuadPart; have_metadata.have_allocated=1; }
-		if(wanted.have_blocks) { stat.st_blocks=fai.StandardInformation.AllocationSize.QuadPart/ffssi.PhysicalBytesPerSectorForPerformance; have_metadata.have_blocks=1; }
-		if(wanted.have_blksize) { stat.st_blksize=(uint16_t) ffssi.PhysicalBytesPerSectorForPerformance; have_metadata.have_blksize=1; }
-		if(wanted.have_birthtim) { stat.st_birthtim=to_timespec(fai.BasicInformation.CreationTime); have_metadata.have_birthtim=1; }
-	}
-#else
-	struct stat s={0};
-	prefix/=leafname;
-	if(-1!=lstat(prefix.c_str(), &s))
-	{
-		if(wanted.have_dev) { stat.st_dev=s.st_dev; have_metadata.have_dev=1; }
-		if(wanted.have_ino) { stat.st_ino=s.st_ino; have_metadata.have_ino=1; }
-		if(wanted.have_type) { stat.st_type=s.st_mode; have_metadata.have_type=1; }
-		if(wanted.have_mode) { stat.st_mode=s.st_mode; have_metadata.have_mode=1; }
-		if(wanted.have_nlink) { stat.st_nlink=s.st_nlink; have_metadata.have_nlink=1; }
-		if(wanted.have_uid) { stat.st_uid=s.st_uid; have_metadata.have_uid=1; }
-		if(wanted.have_gid) { stat.st_gid=s.st_gid; have_metadata.have_gid=1; }
-		if(wanted.have_rdev) { stat.st_rdev=s.st_rdev; have_metadata.have_rdev=1; }
-		if(wanted.have_atim) { stat.st_atim.tv_sec=s.st_atim.tv_sec; stat.st_atim.tv_nsec=s.st_atim.tv_nsec; have_metadata.have_atim=1; }
-		if(wanted.have_mtim) { stat.st_mtim.tv_sec=s.st_mtim.tv_sec; stat.st_mtim.tv_nsec=s.st_mtim.tv_nsec; have_metadata.have_mtim=1; }
-		if(wanted.have_ctim) { stat.st_ctim.tv_sec=s.st_ctim.tv_sec; stat.st_ctim.tv_nsec=s.st_ctim.tv_nsec; have_metadata.have_ctim=1; }
-		if(wanted.have_size) { stat.st_size=s.st_size; have_metadata.have_size=1; }
-		if(wanted.have_allocated) { stat.st_allocated=s.st_blocks*s.st_blksize; have_metadata.have_allocated=1; }
-		if(wanted.have_blocks) { stat.st_blocks=s.st_blocks; have_metadata.have_blocks=1; }
-		if(wanted.have_blksize) { stat.st_blksize=s.st_blksize; have_metadata.have_blksize=1; }
-#ifdef HAVE_STAT_FLAGS
-		if(wanted.have_flags) { stat.st_flags=s.st_flags; have_metadata.have_flags=1; }
-#endif
-#ifdef HAVE_STAT_GEN
-		if(wanted.have_gen) { stat.st_gen=s.st_gen; have_metadata.have_gen=1; }
-#endif
-#ifdef HAVE_BIRTHTIMESPEC
-		if(wanted.have_birthtim) { stat.st_birthtim.tv_sec=s.st_birthtim.tv_sec; stat.st_birthtim.tv_nsec=s.st_birthtim.tv_nsec; have_metadata.have_birthtim=1; }
-#endif
-	}
-#endif
-}
-
-void *begin_enumerate_directory(std::filesystem::path path)
-{
-#ifdef WIN32
-	HANDLE ret=CreateFile(path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL,
-		OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
-	return (INVALID_HANDLE_VALUE==ret) ? 0 : ret;
-#else
-	int ret=open(path.c_str(), O_RDONLY | O_DIRECTORY);
-	return (-1==ret) ? 0 : (void *)(size_t)ret;
-#endif
-}
-
-void end_enumerate_directory(void *h)
-{
-#ifdef WIN32
-	CloseHandle(h);
-#else
-	close((int)(size_t)h);
-#endif
-}
-
-std::unique_ptr<std::vector<directory_entry>> enumerate_directory(void *h, size_t maxitems, std::filesystem::path glob, bool namesonly)
-{
-	std::unique_ptr<std::vector<directory_entry>> ret;
-#ifdef WIN32
-	// From http://undocumented.ntinternals.net/UserMode/Undocumented%20Functions/NT%20Objects/File/FILE_INFORMATION_CLASS.html
-	typedef enum _FILE_INFORMATION_CLASS {
-		FileDirectoryInformation                 = 1,
-		FileFullDirectoryInformation,
-		FileBothDirectoryInformation,
-		FileBasicInformation,
-		FileStandardInformation,
-		FileInternalInformation,
-		FileEaInformation,
-		FileAccessInformation,
-		FileNameInformation,
-		FileRenameInformation,
-		FileLinkInformation,
-		FileNamesInformation,
-		FileDispositionInformation,
-		FilePositionInformation,
-		FileFullEaInformation,
-		FileModeInformation,
-		FileAlignmentInformation,
-		FileAllInformation,
-		FileAllocationInformation,
-		FileEndOfFileInformation,
-		FileAlternateNameInformation,
-		FileStreamInformation,
-		FilePipeInformation,
-		FilePipeLocalInformation,
-		FilePipeRemoteInformation,
-		FileMailslotQueryInformation,
-		FileMailslotSetInformation,
-		FileCompressionInformation,
-		FileObjectIdInformation,
-		FileCompletionInformation,
-		FileMoveClusterInformation,
-		FileQuotaInformation,
-		FileReparsePointInformation,
-		FileNetworkOpenInformation,
-		FileAttributeTagInformation,
-		FileTrackingInformation,
-		FileIdBothDirectoryInformation,
-		FileIdFullDirectoryInformation,
-		FileValidDataLengthInformation,
-		FileShortNameInformation,
-		FileIoCompletionNotificationInformation,
-		FileIoStatusBlockRangeInformation,
-		FileIoPriorityHintInformation,
-		FileSfioReserveInformation,
-		FileSfioVolumeInformation,
-		FileHardLinkInformation,
-		FileProcessIdsUsingFileInformation,
-		FileNormalizedNameInformation,
-		FileNetworkPhysicalNameInformation,
-		FileIdGlobalTxDirectoryInformation,
-		FileIsRemoteDeviceInformation,
-		FileAttributeCacheInformation,
-		FileNumaNodeInformation,
-		FileStandardLinkInformation,
-		FileRemoteProtocolInformation,
-		FileMaximumInformation
-	} FILE_INFORMATION_CLASS, *PFILE_INFORMATION_CLASS;
-
-	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff540310(v=vs.85).aspx
-	typedef struct _FILE_ID_FULL_DIR_INFORMATION  {
-	  ULONG         NextEntryOffset;
-	  ULONG         FileIndex;
-	  LARGE_INTEGER CreationTime;
-	  LARGE_INTEGER LastAccessTime;
-	  LARGE_INTEGER LastWriteTime;
-	  LARGE_INTEGER ChangeTime;
-	  LARGE_INTEGER EndOfFile;
-	  LARGE_INTEGER AllocationSize;
-	  ULONG         FileAttributes;
-	  ULONG         FileNameLength;
-	  ULONG         EaSize;
-	  LARGE_INTEGER FileId;
-	  WCHAR         FileName[1];
-	} FILE_ID_FULL_DIR_INFORMATION, *PFILE_ID_FULL_DIR_INFORMATION;
-
-	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff540329(v=vs.85).aspx
-	typedef struct _FILE_NAMES_INFORMATION {
-	  ULONG NextEntryOffset;
-	  ULONG FileIndex;
-	  ULONG FileNameLength;
-	  WCHAR FileName[1];
-	} FILE_NAMES_INFORMATION, *PFILE_NAMES_INFORMATION;
-
-#ifndef NTSTATUS
-#define NTSTATUS LONG
-#endif
-
-	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff550671(v=vs.85).aspx
-	typedef struct _IO_STATUS_BLOCK {
-		union {
-			NTSTATUS Status;
-			PVOID    Pointer;
-		};
-		ULONG_PTR Information;
-	} IO_STATUS_BLOCK, *PIO_STATUS_BLOCK;
-
-	// From http://msdn.microsoft.com/en-us/library/windows/desktop/aa380518(v=vs.85).aspx
-	typedef struct _LSA_UNICODE_STRING {
-	  USHORT Length;
-	  USHORT MaximumLength;
-	  PWSTR  Buffer;
-	} LSA_UNICODE_STRING, *PLSA_UNICODE_STRING, UNICODE_STRING, *PUNICODE_STRING;
-
-	// From http://undocumented.ntinternals.net/UserMode/Undocumented%20Functions/NT%20Objects/File/NtQueryDirectoryFile.html
-	// and http://msdn.microsoft.com/en-us/library/windows/hardware/ff567047(v=vs.85).aspx
-	typedef NTSTATUS (NTAPI *NtQueryDirectoryFile_t)(
-		/*_In_*/      HANDLE FileHandle,
-		/*_In_opt_*/  HANDLE Event,
-		/*_In_opt_*/  void *ApcRoutine,
-		/*_In_opt_*/  PVOID ApcContext,
-		/*_Out_*/     PIO_STATUS_BLOCK IoStatusBlock,
-		/*_Out_*/     PVOID FileInformation,
-		/*_In_*/      ULONG Length,
-		/*_In_*/      FILE_INFORMATION_CLASS FileInformationClass,
-		/*_In_*/      BOOLEAN ReturnSingleEntry,
-		/*_In_opt_*/  PUNICODE_STRING FileName,
-		/*_In_*/      BOOLEAN RestartScan
-		);
-
-	static NtQueryDirectoryFile_t NtQueryDirectoryFile;
-	if(!NtQueryDirectoryFile)
-		if(!(NtQueryDirectoryFile=(NtQueryDirectoryFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtQueryDirectoryFile")))
-			abort();
-
-	IO_STATUS_BLOCK isb={ 0 };
-	UNICODE_STRING _glob;
-	if(!glob.empty())
-	{
-		_glob.Buffer=const_cast<std::filesystem::path::value_type *>(glob.c_str());
-		_glob.Length=_glob.MaximumLength=(USHORT) glob.native().size();
-	}
-
-	if(namesonly)
-	{
-		FILE_NAMES_INFORMATION *buffer=(FILE_NAMES_INFORMATION *) malloc(sizeof(FILE_NAMES_INFORMATION)*maxitems);
-		if(!buffer) throw std::bad_alloc();
-		auto unbuffer=detail::Undoer([&buffer] { free(buffer); });
-
-		if(0/*STATUS_SUCCESS*/!=NtQueryDirectoryFile(h, NULL, NULL, NULL, &isb, buffer, (ULONG)(sizeof(FILE_NAMES_INFORMATION)*maxitems),
-			FileNamesInformation, FALSE, glob.empty() ? NULL : &_glob, FALSE))
-		{
-			return ret;
-		}
-		ret=std::unique_ptr<std::vector<directory_entry>>(new std::vector<directory_entry>);
-		std::vector<directory_entry> &_ret=*ret;
-		_ret.reserve(maxitems);
-		directory_entry item;
-		bool done=false;
-		for(FILE_NAMES_INFORMATION *ffdi=buffer; !done; ffdi=(FILE_NAMES_INFORMATION *)((size_t) ffdi + ffdi->NextEntryOffset))
-		{
-			size_t length=ffdi->FileNameLength/sizeof(std::filesystem::path::value_type);
-			if(length<=2 && '.'==ffdi->FileName[0])
-				if(1==length || '.'==ffdi->FileName[1]) continue;
-			std::filesystem::path::string_type leafname(ffdi->FileName, length);
-			item.leafname=std::move(leafname);
-			_ret.push_back(std::move(item));
-			if(!ffdi->NextEntryOffset) done=true;
-		}
-	}
-	else
-	{
-		FILE_ID_FULL_DIR_INFORMATION *buffer=(FILE_ID_FULL_DIR_INFORMATION *) malloc(sizeof(FILE_ID_FULL_DIR_INFORMATION)*maxitems);
-		if(!buffer) throw std::bad_alloc();
-		auto unbuffer=detail::Undoer([&buffer] { free(buffer); });
-
-		if(0/*STATUS_SUCCESS*/!=NtQueryDirectoryFile(h, NULL, NULL, NULL, &isb, buffer, (ULONG)(sizeof(FILE_ID_FULL_DIR_INFORMATION)*maxitems),
-			FileIdFullDirectoryInformation, FALSE, glob.empty() ? NULL : &_glob, FALSE))
-		{
-			return ret;
-		}
-		ret=std::unique_ptr<std::vector<directory_entry>>(new std::vector<directory_entry>);
-		std::vector<directory_entry> &_ret=*ret;
-		_ret.reserve(maxitems);
-		directory_entry item;
-		// This is what windows returns with each enumeration
-		item.have_metadata.have_ino=1;
-		item.have_metadata.have_type=1;
-		item.have_metadata.have_atim=1;
-		item.have_metadata.have_mtim=1;
-		item.have_metadata.have_ctim=1;
-		item.have_metadata.have_size=1;
-		item.have_metadata.have_allocated=1;
-		item.have_metadata.have_birthtim=1;
-		bool done=false;
-		for(FILE_ID_FULL_DIR_INFORMATION *ffdi=buffer; !done; ffdi=(FILE_ID_FULL_DIR_INFORMATION *)((size_t) ffdi + ffdi->NextEntryOffset))
-		{
-			size_t length=ffdi->FileNameLength/sizeof(std::filesystem::path::value_type);
-			if(length<=2 && '.'==ffdi->FileName[0])
-				if(1==length || '.'==ffdi->FileName[1]) continue;
-			std::filesystem::path::string_type leafname(ffdi->FileName, length);
-			item.leafname=std::move(leafname);
-			item.stat.st_ino=ffdi->FileId.QuadPart;
-			item.stat.st_type=to_st_type(ffdi->FileAttributes);
-			item.stat.st_atim=to_timespec(ffdi->LastAccessTime);
-			item.stat.st_mtim=to_timespec(ffdi->LastWriteTime);
-			item.stat.st_ctim=to_timespec(ffdi->ChangeTime);
-			item.stat.st_size=ffdi->EndOfFile.QuadPart;
-			item.stat.st_allocated=ffdi->AllocationSize.QuadPart;
-			item.stat.st_birthtim=to_timespec(ffdi->CreationTime);
-			_ret.push_back(std::move(item));
-			if(!ffdi->NextEntryOffset) done=true;
-		}
-	}
-	return ret;
-#else
-#ifdef __linux__
-	// Linux kernel defines a weird dirent with type packed at the end of d_name, so override default dirent
-	struct dirent {
-	   long           d_ino;
-	   off_t          d_off;
-	   unsigned short d_reclen;
-	   char           d_name[];
-	};
-	// Unlike FreeBSD, Linux doesn't define a getdents() function, so we'll do that here.
-	typedef int (*getdents_t)(int, char *, int);
-	getdents_t getdents=(getdents_t)([](int fd, char *buf, int count) -> int { return syscall(SYS_getdents, fd, buf, count); });
-#endif
-	dirent *buffer=(dirent *) malloc(sizeof(dirent)*maxitems);
-	if(!buffer) throw std::bad_alloc();
-	auto unbuffer=detail::Undoer([&buffer] { free(buffer); });
-
-	int bytes=getdents((int)(size_t)h, (char *) buffer, sizeof(dirent)*maxitems);
-	if(bytes<=0)
-		return ret;
-	ret=std::unique_ptr<std::vector<directory_entry>>(new std::vector<directory_entry>);
-	std::vector<directory_entry> &_ret=*ret;
-	_ret.reserve(maxitems);
-	directory_entry item;
-	// This is what POSIX returns with getdents()
-	item.have_metadata.have_ino=1;
-	item.have_metadata.have_type=1;
-	bool done=false;
-	for(dirent *dent=buffer; !done; dent=(dirent *)((size_t) dent + dent->d_reclen))
-	{
-		if(!(bytes-=dent->d_reclen)) done=true;
-		if(!dent->d_ino)
-			continue;
-		size_t length=strchr(dent->d_name, 0)-dent->d_name;
-		if(length<=2 && '.'==dent->d_name[0])
-			if(1==length || '.'==dent->d_name[1]) continue;
-		if(!glob.empty() && fnmatch(glob.native().c_str(), dent->d_name, 0)) continue;
-		std::filesystem::path::string_type leafname(dent->d_name, length);
-		item.leafname=std::move(leafname);
-		item.stat.st_ino=dent->d_ino;
-		char d_type=
-#ifdef __linux__
-				*((char *) dent + dent->d_reclen - 1)
-#else
-				dent->d_type
-#endif
-				;
-		if(DT_UNKNOWN==d_type)
-			item.have_metadata.have_type=0;
-		else
-		{
-			item.have_metadata.have_type=1;
-			switch(d_type)
-			{
-			case DT_BLK:
-				item.stat.st_type=S_IFBLK;
-				break;
-			case DT_CHR:
-				item.stat.st_type=S_IFCHR;
-				break;
-			case DT_DIR:
-				item.stat.st_type=S_IFDIR;
-				break;
-			case DT_FIFO:
-				item.stat.st_type=S_IFIFO;
-				break;
-			case DT_LNK:
-				item.stat.st_type=S_IFLNK;
-				break;
-			case DT_REG:
-				item.stat.st_type=S_IFREG;
-				break;
-			case DT_SOCK:
-				item.stat.st_type=S_IFSOCK;
-				break;
-			default:
-				item.have_metadata.have_type=0;
-				item.stat.st_type=0;
-				break;
-			}
-		}
-		_ret.push_back(std::move(item));
-	}
-	return ret;
-#endif
-}
-
-} // namespace
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Aug 2013
+*/
+
+#define __USE_XOPEN2K8 // Turns on timespecs in Linux
+#include "FastDirectoryEnumerator.hpp"
+#include "Undoer.hpp"
+#include "io_uring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <Windows.h>
+#include "boost/thread/tss.hpp"
+#else
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <dirent.h>     /* Defines DT_* constants */
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <poll.h>
+#include <list>
+#include <map>
+#endif
+#include <fnmatch.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define FASTDIRECTORYENUMERATOR_HAVE_AVX2_DISPATCH
+#endif
+#ifdef FASTDIRECTORYENUMERATOR_STATS
+#include <chrono>
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define FASTDIRECTORYENUMERATOR_PROBE1(name, a) DTRACE_PROBE1(fastdirectoryenumerator, name, a)
+#define FASTDIRECTORYENUMERATOR_PROBE2(name, a, b) DTRACE_PROBE2(fastdirectoryenumerator, name, a, b)
+#define FASTDIRECTORYENUMERATOR_PROBE3(name, a, b, c) DTRACE_PROBE3(fastdirectoryenumerator, name, a, b, c)
+#endif
+#endif
+// What's inside is only compiled when keeping stats
+#define FASTDIRECTORYENUMERATOR_IF_STATS(...) __VA_ARGS__
+#else
+#define FASTDIRECTORYENUMERATOR_IF_STATS(...)
+#endif
+#ifndef FASTDIRECTORYENUMERATOR_PROBE1
+#define FASTDIRECTORYENUMERATOR_PROBE1(name, a)
+#define FASTDIRECTORYENUMERATOR_PROBE2(name, a, b)
+#define FASTDIRECTORYENUMERATOR_PROBE3(name, a, b, c)
+#endif
+
+namespace FastDirectoryEnumerator
+{
+
+#ifdef WIN32
+#define TIMESPEC_TO_FILETIME_OFFSET (((long long)27111902 << 32) + (long long)3577643008)
+
+static inline struct timespec to_timespec(LARGE_INTEGER time)
+{
+	struct timespec ts;
+	ts.tv_sec = ((time.QuadPart - TIMESPEC_TO_FILETIME_OFFSET) / 10000000);
+	ts.tv_nsec = (long)((time.QuadPart - TIMESPEC_TO_FILETIME_OFFSET - ((long long)ts.tv_sec * (long long)10000000)) * 100);
+	return ts;
+}
+
+static inline uint16_t to_st_type(ULONG FileAttributes, uint16_t mode=0)
+{
+	if(FileAttributes&FILE_ATTRIBUTE_REPARSE_POINT)
+		mode|=S_IFLNK;
+	else if(FileAttributes&FILE_ATTRIBUTE_DIRECTORY)
+		mode|=S_IFDIR;
+	else
+		mode|=S_IFREG;
+	return mode;
+}
+#else
+static inline uint16_t to_st_type(unsigned char d_type)
+{
+	switch(d_type)
+	{
+	case DT_BLK:
+		return S_IFBLK;
+	case DT_CHR:
+		return S_IFCHR;
+	case DT_DIR:
+		return S_IFDIR;
+	case DT_FIFO:
+		return S_IFIFO;
+	case DT_LNK:
+		return S_IFLNK;
+	case DT_REG:
+		return S_IFREG;
+	case DT_SOCK:
+		return S_IFSOCK;
+	default:
+		// Includes DT_UNKNOWN, where the filing system needs a stat() to tell
+		return 0;
+	}
+}
+
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+#define HAVE_STATX
+// Kernels before 4.11 don't have statx(), in which case we fall back to fstatat()
+static bool statx_available()
+{
+	// Found once, as the first lookups may come from many worker threads at once
+	static const bool available=[]() -> bool {
+		struct statx s;
+		return -1!=statx(AT_FDCWD, "/", AT_SYMLINK_NOFOLLOW, STATX_TYPE, &s) || ENOSYS!=errno;
+	}();
+	return available;
+}
+
+// The minimal STATX_* mask which fetches wanted. st_dev, st_rdev and st_blksize always come back.
+static inline unsigned int to_statx_mask(have_metadata_flags wanted)
+{
+	unsigned int mask=0;
+	if(wanted.have_ino) mask|=STATX_INO;
+	if(wanted.have_type) mask|=STATX_TYPE;
+	if(wanted.have_mode) mask|=STATX_TYPE|STATX_MODE;
+	if(wanted.have_nlink) mask|=STATX_NLINK;
+	if(wanted.have_uid) mask|=STATX_UID;
+	if(wanted.have_gid) mask|=STATX_GID;
+	if(wanted.have_atim) mask|=STATX_ATIME;
+	if(wanted.have_mtim) mask|=STATX_MTIME;
+	if(wanted.have_ctim) mask|=STATX_CTIME;
+	if(wanted.have_size) mask|=STATX_SIZE;
+	if(wanted.have_allocated || wanted.have_blocks) mask|=STATX_BLOCKS;
+	if(wanted.have_birthtim) mask|=STATX_BTIME;
+	return mask;
+}
+
+// What a STATX_* mask returned by the kernel says is valid
+static inline have_metadata_flags from_statx_mask(unsigned int mask)
+{
+	have_metadata_flags ret; ret.value=0;
+	ret.have_dev=ret.have_rdev=ret.have_blksize=1;
+	ret.have_ino=!!(mask&STATX_INO);
+	ret.have_type=!!(mask&STATX_TYPE);
+	ret.have_mode=(STATX_TYPE|STATX_MODE)==(mask&(STATX_TYPE|STATX_MODE));
+	ret.have_nlink=!!(mask&STATX_NLINK);
+	ret.have_uid=!!(mask&STATX_UID);
+	ret.have_gid=!!(mask&STATX_GID);
+	ret.have_atim=!!(mask&STATX_ATIME);
+	ret.have_mtim=!!(mask&STATX_MTIME);
+	ret.have_ctim=!!(mask&STATX_CTIME);
+	ret.have_size=!!(mask&STATX_SIZE);
+	ret.have_allocated=ret.have_blocks=!!(mask&STATX_BLOCKS);
+	ret.have_birthtim=!!(mask&STATX_BTIME);
+	return ret;
+}
+#endif
+#endif
+
+bool stats_enabled() BOOST_NOEXCEPT_OR_NOTHROW
+{
+#ifdef FASTDIRECTORYENUMERATOR_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+#ifdef FASTDIRECTORYENUMERATOR_STATS
+namespace
+{
+	BOOST_CONSTEXPR_OR_CONST size_t stats_counters=sizeof(enumeration_stats)/sizeof(uint64_t);
+	// Each thread counts into a block of its own which only it writes, so counting takes no locked instructions.
+	// process_stats() adds up the blocks of the threads alive with what those which exited left behind.
+	struct thread_stats;
+	struct stats_registry
+	{
+		std::mutex lock;
+		std::vector<thread_stats *> live;
+		uint64_t exited[stats_counters];
+		stats_registry() { memset(exited, 0, sizeof(exited)); }
+	};
+	// Never destroyed, as threads can exit after static destruction
+	stats_registry &registry() { static stats_registry *ret=new stats_registry; return *ret; }
+	struct thread_stats
+	{
+		std::atomic<uint64_t> counters[stats_counters];
+		unsigned lookups;
+		thread_stats() : lookups(0)
+		{
+			for(auto &c : counters)
+				c.store(0, std::memory_order_relaxed);
+			stats_registry &r=registry();
+			std::lock_guard<std::mutex> g(r.lock);
+			r.live.push_back(this);
+		}
+		~thread_stats()
+		{
+			stats_registry &r=registry();
+			std::lock_guard<std::mutex> g(r.lock);
+			for(size_t n=0; n<stats_counters; n++)
+				r.exited[n]+=counters[n].load(std::memory_order_relaxed);
+			r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+		}
+		void add(size_t idx, uint64_t n) { counters[idx].store(counters[idx].load(std::memory_order_relaxed)+n, std::memory_order_relaxed); }
+	};
+	inline thread_stats &this_thread_stats() { static thread_local thread_stats ret; return ret; }
+	inline uint64_t stats_now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+	// Adds n to the counter at offset into enumeration_stats of this thread, and of a handle if given
+	inline void count(enumeration_stats *handle, size_t offset, uint64_t n)
+	{
+		this_thread_stats().add(offset/sizeof(uint64_t), n);
+		if(handle)
+			*(uint64_t *)((char *) handle+offset)+=n;
+	}
+	inline void count_kernel_call(enumeration_stats &stats, void *h, int64_t bytes, uint64_t begin)
+	{
+		uint64_t ns=stats_now()-begin;
+		count(&stats, offsetof(enumeration_stats, kernel_calls), 1);
+		count(&stats, offsetof(enumeration_stats, kernel_bytes), bytes>0 ? bytes : 0);
+		count(&stats, offsetof(enumeration_stats, syscall_ns), ns);
+		FASTDIRECTORYENUMERATOR_PROBE3(getdents, (size_t) h, bytes, ns);
+	}
+	// An allocation of bytes, timed from begin unless that is zero
+	inline void count_alloc(enumeration_stats *stats, size_t bytes, uint64_t begin)
+	{
+		uint64_t ns=begin ? stats_now()-begin : 0;
+		count(stats, offsetof(enumeration_stats, allocations), 1);
+		count(stats, offsetof(enumeration_stats, alloc_ns), ns);
+		FASTDIRECTORYENUMERATOR_PROBE2(alloc, bytes, ns);
+	}
+	// In the order of the lookup counters of enumeration_stats
+	enum lookup_kind { statx_lookup, fstatat_lookup, nt_query_lookup, nt_open_lookup, io_uring_lookup };
+	static_assert(offsetof(enumeration_stats, io_uring_statx)==offsetof(enumeration_stats, statx_calls)+io_uring_lookup*sizeof(uint64_t), "lookup counters out of order");
+	// Counts a lookup, returning when it started if it is one of those timed, else zero
+	inline uint64_t lookup_start(lookup_kind kind)
+	{
+		thread_stats &t=this_thread_stats();
+		t.add(offsetof(enumeration_stats, statx_calls)/sizeof(uint64_t)+kind, 1);
+		FASTDIRECTORYENUMERATOR_PROBE1(lookup__start, (int) kind);
+		return (t.lookups++%enumeration_stats::lookup_sample_rate) ? 0 : stats_now();
+	}
+	inline void lookup_done(lookup_kind kind, uint64_t begin, long result)
+	{
+		FASTDIRECTORYENUMERATOR_PROBE2(lookup__done, (int) kind, result);
+		if(begin)
+			count(nullptr, offsetof(enumeration_stats, syscall_ns), (stats_now()-begin)*enumeration_stats::lookup_sample_rate);
+	}
+	// Counts what one call of _int_for_each() parsed as it returns, the time spent in syscalls and allocating
+	// meanwhile being taken out of the time it took
+	struct parse_counter
+	{
+		enumeration_stats &stats;
+		const size_t &delivered;
+		uint64_t begin, syscall_ns, alloc_ns;
+		size_t parsed, filtered;
+		parse_counter(enumeration_stats &_stats, const size_t &_delivered) : stats(_stats), delivered(_delivered), begin(stats_now()), syscall_ns(_stats.syscall_ns), alloc_ns(_stats.alloc_ns), parsed(0), filtered(0) { }
+		~parse_counter()
+		{
+			uint64_t ns=stats_now()-begin-(stats.syscall_ns-syscall_ns)-(stats.alloc_ns-alloc_ns);
+			count(&stats, offsetof(enumeration_stats, entries_parsed), parsed);
+			count(&stats, offsetof(enumeration_stats, entries_skipped), parsed-filtered-delivered);
+			count(&stats, offsetof(enumeration_stats, entries_filtered), filtered);
+			count(&stats, offsetof(enumeration_stats, parse_ns), ns);
+			FASTDIRECTORYENUMERATOR_PROBE3(parse, parsed, delivered, ns);
+		}
+	};
+}
+#endif
+
+enumeration_stats process_stats()
+{
+	enumeration_stats ret;
+#ifdef FASTDIRECTORYENUMERATOR_STATS
+	uint64_t sums[stats_counters];
+	stats_registry &r=registry();
+	{
+		std::lock_guard<std::mutex> g(r.lock);
+		memcpy(sums, r.exited, sizeof(sums));
+		for(thread_stats *t : r.live)
+			for(size_t n=0; n<stats_counters; n++)
+				sums[n]+=t->counters[n].load(std::memory_order_relaxed);
+	}
+	memcpy(&ret, sums, sizeof(ret));
+#endif
+	return ret;
+}
+
+void directory_entry::_int_alloc_stat()
+{
+	FASTDIRECTORYENUMERATOR_IF_STATS(count_alloc(nullptr, sizeof(stat_t), 0);)
+	_stat.reset(new stat_t());
+}
+
+have_metadata_flags directory_entry::metadata_supported() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	have_metadata_flags ret; ret.value=0;
+#ifdef WIN32
+	ret.have_dev=0;
+	ret.have_ino=1;        // FILE_INTERNAL_INFORMATION, enumerated
+	ret.have_type=1;       // FILE_BASIC_INFORMATION, enumerated
+	ret.have_mode=0;
+	ret.have_nlink=1;      // FILE_STANDARD_INFORMATION
+	ret.have_uid=0;
+	ret.have_gid=0;
+	ret.have_rdev=0;
+	ret.have_atim=1;       // FILE_BASIC_INFORMATION, enumerated
+	ret.have_mtim=1;       // FILE_BASIC_INFORMATION, enumerated
+	ret.have_ctim=1;       // FILE_BASIC_INFORMATION, enumerated
+	ret.have_size=1;       // FILE_STANDARD_INFORMATION, enumerated
+	ret.have_allocated=1;  // FILE_STANDARD_INFORMATION, enumerated
+	ret.have_blocks=1;
+	ret.have_blksize=1;    // FILE_ALIGNMENT_INFORMATION
+	ret.have_flags=0;
+	ret.have_gen=0;
+	ret.have_birthtim=1;   // FILE_BASIC_INFORMATION, enumerated
+#elif defined(__linux__)
+	ret.have_dev=1;
+	ret.have_ino=1;
+	ret.have_type=1;
+	ret.have_mode=1;
+	ret.have_nlink=1;
+	ret.have_uid=1;
+	ret.have_gid=1;
+	ret.have_rdev=1;
+	ret.have_atim=1;
+	ret.have_mtim=1;
+	ret.have_ctim=1;
+	ret.have_size=1;
+	ret.have_allocated=1;
+	ret.have_blocks=1;
+	ret.have_blksize=1;
+	ret.have_flags=0;
+	ret.have_gen=0;
+#ifdef HAVE_STATX
+	// statx() returns birth time where the filing system keeps it
+	ret.have_birthtim=statx_available();
+#else
+	ret.have_birthtim=0;
+#endif
+#else
+	// Kinda assumes FreeBSD or OS X really ...
+	ret.have_dev=1;
+	ret.have_ino=1;
+	ret.have_type=1;
+	ret.have_mode=1;
+	ret.have_nlink=1;
+	ret.have_uid=1;
+	ret.have_gid=1;
+	ret.have_rdev=1;
+	ret.have_atim=1;
+	ret.have_mtim=1;
+	ret.have_ctim=1;
+	ret.have_size=1;
+	ret.have_allocated=1;
+	ret.have_blocks=1;
+	ret.have_blksize=1;
+#define HAVE_STAT_FLAGS
+	ret.have_flags=1;
+#define HAVE_STAT_GEN
+	ret.have_gen=1;
+#define HAVE_BIRTHTIMESPEC
+	ret.have_birthtim=1;
+#endif
+	return ret;
+}
+
+have_metadata_flags directory_entry::metadata_supported(const std::filesystem::path &path)
+{
+	have_metadata_flags ret=metadata_supported();
+#ifdef HAVE_STATX
+	struct statx s;
+	if(statx_available() && -1!=statx(AT_FDCWD, path.c_str(), AT_SYMLINK_NOFOLLOW, STATX_BASIC_STATS|STATX_BTIME, &s))
+		ret.value&=from_statx_mask(s.stx_mask).value;
+#else
+	(void) path;
+#endif
+	return ret;
+}
+
+have_metadata_flags directory_entry::fetch_metadata(const enumeration_handle &dir, have_metadata_flags wanted, bool nosync)
+{
+	have_metadata_flags tofetch;
+	wanted.value&=metadata_supported().value;
+	tofetch.value=wanted.value&~have_metadata.value;
+#ifdef WIN32
+	if(tofetch.value) _int_fetch(tofetch, dir.path(), nullptr, nosync);
+#else
+	// The lookup is relative to the fd, so the path needn't be copied
+	if(tofetch.value) _int_fetch(tofetch, std::filesystem::path(), dir.native_handle(), nosync);
+#endif
+	return have_metadata;
+}
+
+#ifdef HAVE_STATX
+void directory_entry::_int_fill_from_statx(have_metadata_flags wanted, const void *statxbuf)
+{
+	const struct statx &s=*(const struct statx *) statxbuf;
+	// The filing system may not have returned everything asked for
+	wanted.value&=from_statx_mask(s.stx_mask).value;
+	stat_t *stat=_int_stat(wanted);
+	if(wanted.have_dev) { stat->st_dev=makedev(s.stx_dev_major, s.stx_dev_minor); have_metadata.have_dev=1; }
+	if(wanted.have_ino) { _ino=s.stx_ino; have_metadata.have_ino=1; }
+	if(wanted.have_type) { _type=s.stx_mode&S_IFMT; have_metadata.have_type=1; }
+	if(wanted.have_mode) { stat->st_mode=s.stx_mode; have_metadata.have_mode=1; }
+	if(wanted.have_nlink) { stat->st_nlink=s.stx_nlink; have_metadata.have_nlink=1; }
+	if(wanted.have_uid) { stat->st_uid=s.stx_uid; have_metadata.have_uid=1; }
+	if(wanted.have_gid) { stat->st_gid=s.stx_gid; have_metadata.have_gid=1; }
+	if(wanted.have_rdev) { stat->st_rdev=makedev(s.stx_rdev_major, s.stx_rdev_minor); have_metadata.have_rdev=1; }
+	if(wanted.have_atim) { stat->st_atim.tv_sec=s.stx_atime.tv_sec; stat->st_atim.tv_nsec=s.stx_atime.tv_nsec; have_metadata.have_atim=1; }
+	if(wanted.have_mtim) { stat->st_mtim.tv_sec=s.stx_mtime.tv_sec; stat->st_mtim.tv_nsec=s.stx_mtime.tv_nsec; have_metadata.have_mtim=1; }
+	if(wanted.have_ctim) { stat->st_ctim.tv_sec=s.stx_ctime.tv_sec; stat->st_ctim.tv_nsec=s.stx_ctime.tv_nsec; have_metadata.have_ctim=1; }
+	if(wanted.have_size) { stat->st_size=s.stx_size; have_metadata.have_size=1; }
+	if(wanted.have_allocated) { stat->st_allocated=s.stx_blocks*s.stx_blksize; have_metadata.have_allocated=1; }
+	if(wanted.have_blocks) { stat->st_blocks=s.stx_blocks; have_metadata.have_blocks=1; }
+	if(wanted.have_blksize) { stat->st_blksize=s.stx_blksize; have_metadata.have_blksize=1; }
+	if(wanted.have_birthtim) { stat->st_birthtim.tv_sec=s.stx_btime.tv_sec; stat->st_birthtim.tv_nsec=s.stx_btime.tv_nsec; have_metadata.have_birthtim=1; }
+}
+#endif
+
+#ifdef __linux__
+namespace
+{
+	/* The directories a thread has looked up enumerated entries in, kept open most recently used first, so
+	that looking up more entries of one has the kernel walk just the leafname relative to its fd rather than
+	the whole path again. They are keyed by the st_dev and st_ino the enumeration_handle had, and an fd is
+	only cached if opening the path gets that same directory, so entries are never looked up in another
+	directory which has since taken the path. At most max_per_thread are kept by each thread, and all threads
+	together keep no more than a quarter of RLIMIT_NOFILE so the program never runs out of fds because of
+	them. The fds are O_PATH ones, which can be looked up relative to without read permission on the
+	directory.
+	*/
+	class dirfd_cache
+	{
+		static BOOST_CONSTEXPR_OR_CONST size_t max_per_thread=32;
+		struct node
+		{
+			int fd;
+			std::pair<uint64_t, uint64_t> inode;
+		};
+		typedef std::list<node>::iterator iterator;
+		std::list<node> _lru;
+		std::map<std::pair<uint64_t, uint64_t>, iterator> _byinode;
+		static std::atomic<size_t> &total() { static std::atomic<size_t> ret(0); return ret; }
+		static size_t max_total()
+		{
+			struct rlimit r;
+			if(-1==getrlimit(RLIMIT_NOFILE, &r) || RLIM_INFINITY==r.rlim_cur)
+				return 1024;
+			return (size_t) r.rlim_cur/4;
+		}
+		void _evict(iterator it)
+		{
+			_byinode.erase(it->inode);
+			close(it->fd);
+			_lru.erase(it);
+			--total();
+		}
+		// Makes room for another fd, returning false if there is none
+		bool _make_room()
+		{
+			while(!_lru.empty() && (_lru.size()>=max_per_thread || total()>=max_total()))
+				_evict(std::prev(_lru.end()));
+			return total()<max_total();
+		}
+	public:
+		~dirfd_cache() { clear(); }
+		static dirfd_cache &get() { static thread_local dirfd_cache ret; return ret; }
+		// An fd of the directory d, else -1 if it couldn't be opened or there are no fds to spare. Sets moved
+		// if the path of d now names another directory.
+		int open(const detail::directory_ref &d, bool &moved)
+		{
+			moved=false;
+			std::pair<uint64_t, uint64_t> inode(d.dev(), d.ino());
+			auto it=_byinode.find(inode);
+			if(it!=_byinode.end())
+			{
+				_lru.splice(_lru.begin(), _lru, it->second);
+				return it->second->fd;
+			}
+			if(!_make_room())
+				return -1;
+			int fd=::open(d.path().c_str(), O_PATH|O_DIRECTORY|O_CLOEXEC);
+			if(-1==fd && EMFILE==errno && !_lru.empty())
+			{
+				_evict(std::prev(_lru.end()));
+				fd=::open(d.path().c_str(), O_PATH|O_DIRECTORY|O_CLOEXEC);
+			}
+			if(-1==fd)
+				return -1;
+			struct stat s;
+			if(-1==fstat(fd, &s) || (uint64_t) s.st_dev!=inode.first || (uint64_t) s.st_ino!=inode.second)
+			{
+				close(fd);
+				moved=true;
+				return -1;
+			}
+			node n;
+			n.fd=fd;
+			n.inode=inode;
+			_lru.push_front(n);
+			++total();
+			_byinode[inode]=_lru.begin();
+			return fd;
+		}
+		/* If fd, cached for d, is of a directory since deleted, drops it and returns open(d), else -1. A new
+		directory can reuse the inode of a deleted one, and so its key. */
+		int reopen_if_deleted(const detail::directory_ref &d, int fd, bool &moved)
+		{
+			moved=false;
+			auto it=_byinode.find(std::make_pair(d.dev(), d.ino()));
+			struct stat s;
+			if(it==_byinode.end() || it->second->fd!=fd || -1==fstat(fd, &s) || s.st_nlink)
+				return -1;
+			_evict(it->second);
+			return open(d, moved);
+		}
+		void clear()
+		{
+			while(!_lru.empty())
+				_evict(_lru.begin());
+		}
+	};
+}
+#endif
+
+void close_cached_directories()
+{
+#ifdef __linux__
+	dirfd_cache::get().clear();
+#endif
+}
+
+void directory_entry::_int_fetch(have_metadata_flags wanted, std::filesystem::path prefix, void *dirh, bool nosync)
+{
+	// With no prefix an enumerated entry is looked up in the directory it came from
+	bool own=!dirh && prefix.empty() && _dir;
+	if(own)
+		prefix=_dir->path();
+#ifdef WIN32
+	// From http://undocumented.ntinternals.net/UserMode/Undocumented%20Functions/NT%20Objects/File/FILE_INFORMATION_CLASS.html
+	typedef enum _FILE_INFORMATION_CLASS {
+		FileDirectoryInformation                 = 1,
+		FileFullDirectoryInformation,
+		FileBothDirectoryInformation,
+		FileBasicInformation,
+		FileStandardInformation,
+		FileInternalInformation,
+		FileEaInformation,
+		FileAccessInformation,
+		FileNameInformation,
+		FileRenameInformation,
+		FileLinkInformation,
+		FileNamesInformation,
+		FileDispositionInformation,
+		FilePositionInformation,
+		FileFullEaInformation,
+		FileModeInformation,
+		FileAlignmentInformation,
+		FileAllInformation,
+		FileAllocationInformation,
+		FileEndOfFileInformation,
+		FileAlternateNameInformation,
+		FileStreamInformation,
+		FilePipeInformation,
+		FilePipeLocalInformation,
+		FilePipeRemoteInformation,
+		FileMailslotQueryInformation,
+		FileMailslotSetInformation,
+		FileCompressionInformation,
+		FileObjectIdInformation,
+		FileCompletionInformation,
+		FileMoveClusterInformation,
+		FileQuotaInformation,
+		FileReparsePointInformation,
+		FileNetworkOpenInformation,
+		FileAttributeTagInformation,
+		FileTrackingInformation,
+		FileIdBothDirectoryInformation,
+		FileIdFullDirectoryInformation,
+		FileValidDataLengthInformation,
+		FileShortNameInformation,
+		FileIoCompletionNotificationInformation,
+		FileIoStatusBlockRangeInformation,
+		FileIoPriorityHintInformation,
+		FileSfioReserveInformation,
+		FileSfioVolumeInformation,
+		FileHardLinkInformation,
+		FileProcessIdsUsingFileInformation,
+		FileNormalizedNameInformation,
+		FileNetworkPhysicalNameInformation,
+		FileIdGlobalTxDirectoryInformation,
+		FileIsRemoteDeviceInformation,
+		FileAttributeCacheInformation,
+		FileNumaNodeInformation,
+		FileStandardLinkInformation,
+		FileRemoteProtocolInformation,
+		FileMaximumInformation
+	} FILE_INFORMATION_CLASS, *PFILE_INFORMATION_CLASS;
+
+	typedef enum  { 
+	  FileFsVolumeInformation       = 1,
+	  FileFsLabelInformation        = 2,
+	  FileFsSizeInformation         = 3,
+	  FileFsDeviceInformation       = 4,
+	  FileFsAttributeInformation    = 5,
+	  FileFsControlInformation      = 6,
+	  FileFsFullSizeInformation     = 7,
+	  FileFsObjectIdInformation     = 8,
+	  FileFsDriverPathInformation   = 9,
+	  FileFsVolumeFlagsInformation  = 10,
+	  FileFsSectorSizeInformation   = 11
+	} FS_INFORMATION_CLASS;
+#ifndef NTSTATUS
+#define NTSTATUS LONG
+#endif
+
+	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff550671(v=vs.85).aspx
+	typedef struct _IO_STATUS_BLOCK {
+		union {
+			NTSTATUS Status;
+			PVOID    Pointer;
+		};
+		ULONG_PTR Information;
+	} IO_STATUS_BLOCK, *PIO_STATUS_BLOCK;
+
+	// From http://msdn.microsoft.com/en-us/library/windows/desktop/aa380518(v=vs.85).aspx
+	typedef struct _LSA_UNICODE_STRING {
+	  USHORT Length;
+	  USHORT MaximumLength;
+	  PWSTR  Buffer;
+	} LSA_UNICODE_STRING, *PLSA_UNICODE_STRING, UNICODE_STRING, *PUNICODE_STRING;
+
+	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff557749(v=vs.85).aspx
+	typedef struct _OBJECT_ATTRIBUTES {
+	  ULONG           Length;
+	  HANDLE          RootDirectory;
+	  PUNICODE_STRING ObjectName;
+	  ULONG           Attributes;
+	  PVOID           SecurityDescriptor;
+	  PVOID           SecurityQualityOfService;
+	}  OBJECT_ATTRIBUTES, *POBJECT_ATTRIBUTES;
+
+	typedef struct _RTLP_CURDIR_REF
+	{
+		LONG RefCount;
+		HANDLE Handle;
+	} RTLP_CURDIR_REF, *PRTLP_CURDIR_REF;
+
+	typedef struct RTL_RELATIVE_NAME_U {
+		UNICODE_STRING RelativeName;
+		HANDLE ContainingDirectory;
+		PRTLP_CURDIR_REF CurDirRef;
+	} RTL_RELATIVE_NAME_U, *PRTL_RELATIVE_NAME_U;
+
+	// From http://undocumented.ntinternals.net/UserMode/Undocumented%20Functions/NT%20Objects/File/NtQueryInformationFile.html
+	// and http://msdn.microsoft.com/en-us/library/windows/hardware/ff567052(v=vs.85).aspx
+	typedef NTSTATUS (NTAPI *NtQueryInformationFile_t)(
+		/*_In_*/   HANDLE FileHandle,
+		/*_Out_*/  PIO_STATUS_BLOCK IoStatusBlock,
+		/*_Out_*/  PVOID FileInformation,
+		/*_In_*/   ULONG Length,
+		/*_In_*/   FILE_INFORMATION_CLASS FileInformationClass
+		);
+
+	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff567070(v=vs.85).aspx
+	typedef NTSTATUS (NTAPI *NtQueryVolumeInformationFile_t)(
+		/*_In_*/   HANDLE FileHandle,
+		/*_Out_*/  PIO_STATUS_BLOCK IoStatusBlock,
+		/*_Out_*/  PVOID FsInformation,
+		/*_In_*/   ULONG Length,
+		/*_In_*/   FS_INFORMATION_CLASS FsInformationClass
+		);
+
+	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff566492(v=vs.85).aspx
+	typedef NTSTATUS (NTAPI *NtOpenDirectoryObject_t)(
+	  /*_Out_*/  PHANDLE DirectoryHandle,
+	  /*_In_*/   ACCESS_MASK DesiredAccess,
+	  /*_In_*/   POBJECT_ATTRIBUTES ObjectAttributes
+	);
+
+
+	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff567011(v=vs.85).aspx
+	typedef NTSTATUS (NTAPI *NtOpenFile_t)(
+	  /*_Out_*/  PHANDLE FileHandle,
+	  /*_In_*/   ACCESS_MASK DesiredAccess,
+	  /*_In_*/   POBJECT_ATTRIBUTES ObjectAttributes,
+	  /*_Out_*/  PIO_STATUS_BLOCK IoStatusBlock,
+	  /*_In_*/   ULONG ShareAccess,
+	  /*_In_*/   ULONG OpenOptions
+	);
+
+	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff566424(v=vs.85).aspx
+	typedef NTSTATUS (NTAPI *NtCreateFile_t)(
+	  /*_Out_*/     PHANDLE FileHandle,
+	  /*_In_*/      ACCESS_MASK DesiredAccess,
+	  /*_In_*/      POBJECT_ATTRIBUTES ObjectAttributes,
+	  /*_Out_*/     PIO_STATUS_BLOCK IoStatusBlock,
+	  /*_In_opt_*/  PLARGE_INTEGER AllocationSize,
+	  /*_In_*/      ULONG FileAttributes,
+	  /*_In_*/      ULONG ShareAccess,
+	  /*_In_*/      ULONG CreateDisposition,
+	  /*_In_*/      ULONG CreateOptions,
+	  /*_In_opt_*/  PVOID EaBuffer,
+	  /*_In_*/      ULONG EaLength
+	);
+
+	typedef NTSTATUS (NTAPI *NtClose_t)(
+	  /*_Out_*/  HANDLE FileHandle
+	);
+
+	typedef BOOLEAN (NTAPI *RtlDosPathNameToNtPathName_U_t)(
+                             PCWSTR DosName,
+                             PUNICODE_STRING NtName,
+                             PCWSTR *PartName,
+                             PRTL_RELATIVE_NAME_U RelativeName);
+
+	// From http://undocumented.ntinternals.net/UserMode/Undocumented%20Functions/NT%20Objects/File/NtQueryDirectoryFile.html
+	// and http://msdn.microsoft.com/en-us/library/windows/hardware/ff567047(v=vs.85).aspx
+	typedef NTSTATUS (NTAPI *NtQueryDirectoryFile_t)(
+		/*_In_*/      HANDLE FileHandle,
+		/*_In_opt_*/  HANDLE Event,
+		/*_In_opt_*/  void *ApcRoutine,
+		/*_In_opt_*/  PVOID ApcContext,
+		/*_Out_*/     PIO_STATUS_BLOCK IoStatusBlock,
+		/*_Out_*/     PVOID FileInformation,
+		/*_In_*/      ULONG Length,
+		/*_In_*/      FILE_INFORMATION_CLASS FileInformationClass,
+		/*_In_*/      BOOLEAN ReturnSingleEntry,
+		/*_In_opt_*/  PUNICODE_STRING FileName,
+		/*_In_*/      BOOLEAN RestartScan
+		);
+
+	typedef struct _FILE_BASIC_INFORMATION {
+	  LARGE_INTEGER CreationTime;
+	  LARGE_INTEGER LastAccessTime;
+	  LARGE_INTEGER LastWriteTime;
+	  LARGE_INTEGER ChangeTime;
+	  ULONG         FileAttributes;
+	} FILE_BASIC_INFORMATION, *PFILE_BASIC_INFORMATION;
+
+	typedef struct _FILE_STANDARD_INFORMATION {
+	  LARGE_INTEGER AllocationSize;
+	  LARGE_INTEGER EndOfFile;
+	  ULONG         NumberOfLinks;
+	  BOOLEAN       DeletePending;
+	  BOOLEAN       Directory;
+	} FILE_STANDARD_INFORMATION, *PFILE_STANDARD_INFORMATION;
+
+	typedef struct _FILE_INTERNAL_INFORMATION {
+	  LARGE_INTEGER IndexNumber;
+	} FILE_INTERNAL_INFORMATION, *PFILE_INTERNAL_INFORMATION;
+
+	typedef struct _FILE_EA_INFORMATION {
+	  ULONG EaSize;
+	} FILE_EA_INFORMATION, *PFILE_EA_INFORMATION;
+
+	typedef struct _FILE_ACCESS_INFORMATION {
+	  ACCESS_MASK AccessFlags;
+	} FILE_ACCESS_INFORMATION, *PFILE_ACCESS_INFORMATION;
+
+	typedef struct _FILE_POSITION_INFORMATION {
+	  LARGE_INTEGER CurrentByteOffset;
+	} FILE_POSITION_INFORMATION, *PFILE_POSITION_INFORMATION;
+
+	typedef struct _FILE_MODE_INFORMATION {
+	  ULONG Mode;
+	} FILE_MODE_INFORMATION, *PFILE_MODE_INFORMATION;
+
+	typedef struct _FILE_ALIGNMENT_INFORMATION {
+	  ULONG AlignmentRequirement;
+	} FILE_ALIGNMENT_INFORMATION, *PFILE_ALIGNMENT_INFORMATION;
+
+	typedef struct _FILE_NAME_INFORMATION {
+	  ULONG FileNameLength;
+	  WCHAR FileName[1];
+	} FILE_NAME_INFORMATION, *PFILE_NAME_INFORMATION;
+
+	typedef struct _FILE_ALL_INFORMATION {
+	  FILE_BASIC_INFORMATION     BasicInformation;
+	  FILE_STANDARD_INFORMATION  StandardInformation;
+	  FILE_INTERNAL_INFORMATION  InternalInformation;
+	  FILE_EA_INFORMATION        EaInformation;
+	  FILE_ACCESS_INFORMATION    AccessInformation;
+	  FILE_POSITION_INFORMATION  PositionInformation;
+	  FILE_MODE_INFORMATION      ModeInformation;
+	  FILE_ALIGNMENT_INFORMATION AlignmentInformation;
+	  FILE_NAME_INFORMATION      NameInformation;
+	} FILE_ALL_INFORMATION, *PFILE_ALL_INFORMATION;
+
+	typedef struct _FILE_FS_SECTOR_SIZE_INFORMATION {
+	  ULONG LogicalBytesPerSector;
+	  ULONG PhysicalBytesPerSectorForAtomicity;
+	  ULONG PhysicalBytesPerSectorForPerformance;
+	  ULONG FileSystemEffectivePhysicalBytesPerSectorForAtomicity;
+	  ULONG Flags;
+	  ULONG ByteOffsetForSectorAlignment;
+	  ULONG ByteOffsetForPartitionAlignment;
+	} FILE_FS_SECTOR_SIZE_INFORMATION, *PFILE_FS_SECTOR_SIZE_INFORMATION;
+
+	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff540310(v=vs.85).aspx
+	typedef struct _FILE_ID_FULL_DIR_INFORMATION  {
+	  ULONG         NextEntryOffset;
+	  ULONG         FileIndex;
+	  LARGE_INTEGER CreationTime;
+	  LARGE_INTEGER LastAccessTime;
+	  LARGE_INTEGER LastWriteTime;
+	  LARGE_INTEGER ChangeTime;
+	  LARGE_INTEGER EndOfFile;
+	  LARGE_INTEGER AllocationSize;
+	  ULONG         FileAttributes;
+	  ULONG         FileNameLength;
+	  ULONG         EaSize;
+	  LARGE_INTEGER FileId;
+	  WCHAR         FileName[1];
+	} FILE_ID_FULL_DIR_INFORMATION, *PFILE_ID_FULL_DIR_INFORMATION;
+
+	static NtQueryInformationFile_t NtQueryInformationFile;
+	if(!NtQueryInformationFile)
+		if(!(NtQueryInformationFile=(NtQueryInformationFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtQueryInformationFile")))
+			abort();
+	static NtQueryVolumeInformationFile_t NtQueryVolumeInformationFile;
+	if(!NtQueryVolumeInformationFile)
+		if(!(NtQueryVolumeInformationFile=(NtQueryVolumeInformationFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtQueryVolumeInformationFile")))
+			abort();
+	static NtOpenDirectoryObject_t NtOpenDirectoryObject;
+	if(!NtOpenDirectoryObject)
+		if(!(NtOpenDirectoryObject=(NtOpenDirectoryObject_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtOpenDirectoryObject")))
+			abort();
+	static NtOpenFile_t NtOpenFile;
+	if(!NtOpenFile)
+		if(!(NtOpenFile=(NtOpenFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtOpenFile")))
+			abort();
+	static NtCreateFile_t NtCreateFile;
+	if(!NtCreateFile)
+		if(!(NtCreateFile=(NtCreateFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtCreateFile")))
+			abort();
+	static NtClose_t NtClose;
+	if(!NtClose)
+		if(!(NtClose=(NtClose_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtClose")))
+			abort();
+	static RtlDosPathNameToNtPathName_U_t RtlDosPathNameToNtPathName_U;
+	if(!RtlDosPathNameToNtPathName_U)
+		if(!(RtlDosPathNameToNtPathName_U=(RtlDosPathNameToNtPathName_U_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "RtlDosPathNameToNtPathName_U")))
+			abort();
+
+	static NtQueryDirectoryFile_t NtQueryDirectoryFile;
+	if(!NtQueryDirectoryFile)
+		if(!(NtQueryDirectoryFile=(NtQueryDirectoryFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtQueryDirectoryFile")))
+			abort();
+
+	IO_STATUS_BLOCK isb={ 0 };
+	bool slowPath=(wanted.have_nlink || wanted.have_blocks || wanted.have_blksize);
+
+	// NTFS does *not* perform well when opening handles to files with absolute paths in a directory with lots of entries
+	// I'm assuming this is because NTFS is pure B-tree, so what I'm going to do is open its containing directory as
+	// a separate HANDLE and keep a per-thread cache of that HANDLE so lookups in the same directory are fast.
+	NTSTATUS ntval=0;
+	OBJECT_ATTRIBUTES oa={sizeof(OBJECT_ATTRIBUTES)};
+	struct dirhinfo_t
+	{
+		HANDLE h;
+		UNICODE_STRING path;
+		std::filesystem::path _path;
+		dirhinfo_t() : h(nullptr) { memset(&path, 0, sizeof(path)); }
+		~dirhinfo_t() { if(h) NtClose(h); }
+	};
+	static boost::thread_specific_ptr<dirhinfo_t> _dirhinfo;
+	if(!_dirhinfo.get())
+		_dirhinfo.reset(new dirhinfo_t);
+	dirhinfo_t &dirhinfo=*_dirhinfo;
+	std::filesystem::path::value_type buffer[sizeof(FILE_ALL_INFORMATION)/sizeof(std::filesystem::path::value_type)+32769];
+	prefix=std::filesystem::absolute(prefix);
+	if(dirhinfo._path!=prefix)
+	{
+		if(dirhinfo.h)
+		{
+			NtClose(dirhinfo.h);
+			dirhinfo.h=nullptr;
+		}
+		dirhinfo._path=prefix;
+		dirhinfo.path.Buffer=buffer;
+		dirhinfo.path.Length=dirhinfo.path.MaximumLength=(USHORT) sizeof(buffer);
+		RtlDosPathNameToNtPathName_U(dirhinfo._path.c_str(), &dirhinfo.path, NULL, NULL);
+		oa.ObjectName=&dirhinfo.path;
+		oa.Attributes=0x40/*OBJ_CASE_INSENSITIVE*/;
+		//ntval|=NtOpenDirectoryObject(&dirhinfo.h, 0x1/*DIRECTORY_QUERY*/|0x2/*DIRECTORY_TRAVERSE*/, &oa);
+		ntval=NtOpenFile(&dirhinfo.h, FILE_LIST_DIRECTORY|SYNCHRONIZE, &oa, &isb, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+			0x01/*FILE_DIRECTORY_FILE*/|0x20/*FILE_SYNCHRONOUS_IO_NONALERT*/|0x4000/*FILE_OPEN_FOR_BACKUP_INTENT*/);
+		if(0/*STATUS_SUCCESS*/!=ntval)
+			return;
+	}
+	//slowPath=false;
+
+	if(!slowPath)
+	{
+		// Fast path skips opening a handle per file by enumerating the containing directory using a glob
+		// exactly matching the leafname
+		UNICODE_STRING _glob;
+		_glob.Buffer=const_cast<std::filesystem::path::value_type *>(leafname.c_str());
+		_glob.MaximumLength=(_glob.Length=(USHORT) (leafname.native().size()*sizeof(std::filesystem::path::value_type)))+sizeof(std::filesystem::path::value_type);
+		FILE_ID_FULL_DIR_INFORMATION *ffdi=(FILE_ID_FULL_DIR_INFORMATION *) buffer;
+		FASTDIRECTORYENUMERATOR_IF_STATS(uint64_t begin=lookup_start(nt_query_lookup);)
+		ntval=NtQueryDirectoryFile(dirhinfo.h, NULL, NULL, NULL, &isb, ffdi, sizeof(buffer), FileIdFullDirectoryInformation, TRUE, &_glob, FALSE);
+		FASTDIRECTORYENUMERATOR_IF_STATS(lookup_done(nt_query_lookup, begin, ntval);)
+		if(0/*STATUS_SUCCESS*/!=ntval)
+			return;
+		stat_t *stat=_int_stat(wanted);
+		if(wanted.have_ino) { _ino=ffdi->FileId.QuadPart; have_metadata.have_ino=1; }
+		if(wanted.have_type) { _type=to_st_type(ffdi->FileAttributes); have_metadata.have_type=1; }
+		if(wanted.have_atim) { stat->st_atim=to_timespec(ffdi->LastAccessTime); have_metadata.have_atim=1; }
+		if(wanted.have_mtim) { stat->st_mtim=to_timespec(ffdi->LastWriteTime); have_metadata.have_mtim=1; }
+		if(wanted.have_ctim) { stat->st_ctim=to_timespec(ffdi->ChangeTime); have_metadata.have_ctim=1; }
+		if(wanted.have_size) { stat->st_size=ffdi->EndOfFile.QuadPart; have_metadata.have_size=1; }
+		if(wanted.have_allocated) { stat->st_allocated=ffdi->AllocationSize.QuadPart; have_metadata.have_allocated=1; }
+		if(wanted.have_birthtim) { stat->st_birthtim=to_timespec(ffdi->CreationTime); have_metadata.have_birthtim=1; }
+	}
+	else
+	{
+		HANDLE h=nullptr;
+		UNICODE_STRING path;
+		path.Buffer=const_cast<std::filesystem::path::value_type *>(leafname.c_str());
+		path.MaximumLength=(path.Length=(USHORT) (leafname.native().size()*sizeof(std::filesystem::path::value_type)))+sizeof(std::filesystem::path::value_type);
+		oa.ObjectName=&path;
+		oa.RootDirectory=dirhinfo.h;
+		oa.Attributes=0x40/*OBJ_CASE_INSENSITIVE*/; //|0x100/*OBJ_OPENLINK*/;
+		FASTDIRECTORYENUMERATOR_IF_STATS(uint64_t begin=lookup_start(nt_open_lookup);)
+		ntval=NtOpenFile(&h, FILE_READ_ATTRIBUTES, &oa, &isb, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+			0x040/*FILE_NON_DIRECTORY_FILE*/|0x4000/*FILE_OPEN_FOR_BACKUP_INTENT*/|0x00200000/*FILE_OPEN_REPARSE_POINT*/);
+		//ntval=NtCreateFile(&h, FILE_READ_ATTRIBUTES, &oa, &isb, NULL, 0, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+		//	0x1/*FILE_OPEN*/, 0x040/*FILE_NON_DIRECTORY_FILE*/|0x4000/*FILE_OPEN_FOR_BACKUP_INTENT*/, NULL, 0);
+		if(0/*STATUS_SUCCESS*/!=ntval)
+		{
+			FASTDIRECTORYENUMERATOR_IF_STATS(lookup_done(nt_open_lookup, begin, ntval);)
+			return;
+		}
+		auto undirh=::detail::Undoer([&h] { NtClose(h); });
+		FILE_ALL_INFORMATION &fai=*(FILE_ALL_INFORMATION *)buffer;
+		FILE_FS_SECTOR_SIZE_INFORMATION ffssi={0};
+		bool needInternal=(wanted.have_ino);
+		bool needBasic=(wanted.have_type || wanted.have_atim || wanted.have_mtim || wanted.have_ctim || wanted.have_birthtim);
+		bool needStandard=(wanted.have_nlink || wanted.have_size || wanted.have_allocated || wanted.have_blocks);
+		// It's not widely known that the NT kernel supplies a stat() equivalent i.e. get me everything in a single syscall
+		// However fetching FileAlignmentInformation which comes with FILE_ALL_INFORMATION is slow as it touches the device driver,
+		// so only use if we need more than one item
+		if((needInternal+needBasic+needStandard)>=2)
+			ntval|=NtQueryInformationFile(h, &isb, &fai, sizeof(buffer), FileAllInformation);
+		else
+		{
+			if(needInternal)
+				ntval|=NtQueryInformationFile(h, &isb, &fai.InternalInformation, sizeof(fai.InternalInformation), FileInternalInformation);
+			if(needBasic)
+				ntval|=NtQueryInformationFile(h, &isb, &fai.BasicInformation, sizeof(fai.BasicInformation), FileBasicInformation);
+			if(needStandard)
+				ntval|=NtQueryInformationFile(h, &isb, &fai.StandardInformation, sizeof(fai.StandardInformation), FileStandardInformation);
+		}
+		if(wanted.have_blocks || wanted.have_blksize)
+			ntval|=NtQueryVolumeInformationFile(h, &isb, &ffssi, sizeof(ffssi), FileFsSectorSizeInformation);
+		FASTDIRECTORYENUMERATOR_IF_STATS(lookup_done(nt_open_lookup, begin, ntval);)
+		if(0/*STATUS_SUCCESS*/!=ntval)
+			return;
+		stat_t *stat=_int_stat(wanted);
+		if(wanted.have_ino) { _ino=fai.InternalInformation.IndexNumber.QuadPart; have_metadata.have_ino=1; }
+		if(wanted.have_type) { _type=to_st_type(fai.BasicInformation.FileAttributes); have_metadata.have_type=1; }
+		if(wanted.have_nlink) { stat->st_nlink=(int16_t) fai.StandardInformation.NumberOfLinks; have_metadata.have_nlink=1; }
+		if(wanted.have_atim) { stat->st_atim=to_timespec(fai.BasicInformation.LastAccessTime); have_metadata.have_atim=1; }
+		if(wanted.have_mtim) { stat->st_mtim=to_timespec(fai.BasicInformation.LastWriteTime); have_metadata.have_mtim=1; }
+		if(wanted.have_ctim) { stat->st_ctim=to_timespec(fai.BasicInformation.ChangeTime); have_metadata.have_ctim=1; }
+		if(wanted.have_size) { stat->st_size=fai.StandardInformation.EndOfFile.QuadPart; have_metadata.have_size=1; }
+		if(wanted.have_allocated) { stat->st_allocated=fai.StandardInformation.AllocationSize.QuadPart; have_metadata.have_allocated=1; }
+		if(wanted.have_blocks) { stat->st_blocks=fai.StandardInformation.AllocationSize.QuadPart/ffssi.PhysicalBytesPerSectorForPerformance; have_metadata.have_blocks=1; }
+		if(wanted.have_blksize) { stat->st_blksize=(uint16_t) ffssi.PhysicalBytesPerSectorForPerformance; have_metadata.have_blksize=1; }
+		if(wanted.have_birthtim) { stat->st_birthtim=to_timespec(fai.BasicInformation.CreationTime); have_metadata.have_birthtim=1; }
+	}
+#else
+	// With a directory fd the lookup is relative to it, else relative to prefix
+	int dirfd=dirh ? (int)(size_t)dirh : AT_FDCWD;
+#ifdef __linux__
+	// An enumerated entry with no prefix is looked up relative to a cached fd of the directory it came from.
+	// A prefix given is always walked, as only walking it tells which directory it names now.
+	bool cached=false, moved=false;
+	if(own && _dir->ino())
+	{
+		int fd=dirfd_cache::get().open(*_dir, moved);
+		if(moved)
+			return;
+		if(-1!=fd)
+		{
+			dirfd=fd;
+			dirh=(void *)(size_t) fd;
+			cached=true;
+		}
+	}
+	// Only if the cached directory was deleted since is the lookup tried again
+	auto retry=[&]() -> bool {
+		return cached && ENOENT==errno && -1!=(dirfd=dirfd_cache::get().reopen_if_deleted(*_dir, dirfd, moved));
+	};
+#else
+	(void) own;
+	auto retry=[]() { return false; };
+#endif
+	if(!dirh)
+		prefix/=leafname;
+	const char *path=dirh ? leafname.c_str() : prefix.c_str();
+	int ret;
+#ifdef HAVE_STATX
+	if(statx_available())
+	{
+		struct statx s;
+		do
+		{
+			FASTDIRECTORYENUMERATOR_IF_STATS(uint64_t begin=lookup_start(statx_lookup);)
+			ret=statx(dirfd, path, AT_SYMLINK_NOFOLLOW|(nosync ? AT_STATX_DONT_SYNC : 0), to_statx_mask(wanted), &s);
+			FASTDIRECTORYENUMERATOR_IF_STATS(lookup_done(statx_lookup, begin, ret);)
+		} while(-1==ret && retry());
+		if(-1==ret)
+			return;
+		_int_fill_from_statx(wanted, &s);
+		return;
+	}
+#else
+	(void) nosync;
+#endif
+	struct stat s={};
+	do
+	{
+		FASTDIRECTORYENUMERATOR_IF_STATS(uint64_t begin=lookup_start(fstatat_lookup);)
+		ret=fstatat(dirfd, path, &s, AT_SYMLINK_NOFOLLOW);
+		FASTDIRECTORYENUMERATOR_IF_STATS(lookup_done(fstatat_lookup, begin, ret);)
+	} while(-1==ret && retry());
+	if(-1!=ret)
+	{
+		stat_t *stat=_int_stat(wanted);
+		if(wanted.have_dev) { stat->st_dev=s.st_dev; have_metadata.have_dev=1; }
+		if(wanted.have_ino) { _ino=s.st_ino; have_metadata.have_ino=1; }
+		if(wanted.have_type) { _type=s.st_mode&S_IFMT; have_metadata.have_type=1; }
+		if(wanted.have_mode) { stat->st_mode=s.st_mode; have_metadata.have_mode=1; }
+		if(wanted.have_nlink) { stat->st_nlink=s.st_nlink; have_metadata.have_nlink=1; }
+		if(wanted.have_uid) { stat->st_uid=s.st_uid; have_metadata.have_uid=1; }
+		if(wanted.have_gid) { stat->st_gid=s.st_gid; have_metadata.have_gid=1; }
+		if(wanted.have_rdev) { stat->st_rdev=s.st_rdev; have_metadata.have_rdev=1; }
+		if(wanted.have_atim) { stat->st_atim.tv_sec=s.st_atim.tv_sec; stat->st_atim.tv_nsec=s.st_atim.tv_nsec; have_metadata.have_atim=1; }
+		if(wanted.have_mtim) { stat->st_mtim.tv_sec=s.st_mtim.tv_sec; stat->st_mtim.tv_nsec=s.st_mtim.tv_nsec; have_metadata.have_mtim=1; }
+		if(wanted.have_ctim) { stat->st_ctim.tv_sec=s.st_ctim.tv_sec; stat->st_ctim.tv_nsec=s.st_ctim.tv_nsec; have_metadata.have_ctim=1; }
+		if(wanted.have_size) { stat->st_size=s.st_size; have_metadata.have_size=1; }
+		if(wanted.have_allocated) { stat->st_allocated=s.st_blocks*s.st_blksize; have_metadata.have_allocated=1; }
+		if(wanted.have_blocks) { stat->st_blocks=s.st_blocks; have_metadata.have_blocks=1; }
+		if(wanted.have_blksize) { stat->st_blksize=s.st_blksize; have_metadata.have_blksize=1; }
+#ifdef HAVE_STAT_FLAGS
+		if(wanted.have_flags) { stat->st_flags=s.st_flags; have_metadata.have_flags=1; }
+#endif
+#ifdef HAVE_STAT_GEN
+		if(wanted.have_gen) { stat->st_gen=s.st_gen; have_metadata.have_gen=1; }
+#endif
+#ifdef HAVE_BIRTHTIMESPEC
+		if(wanted.have_birthtim) { stat->st_birthtim.tv_sec=s.st_birthtim.tv_sec; stat->st_birthtim.tv_nsec=s.st_birthtim.tv_nsec; have_metadata.have_birthtim=1; }
+#endif
+	}
+#endif
+}
+
+#if defined(FASTDIRECTORYENUMERATOR_HAVE_IO_URING) && defined(HAVE_STATX)
+// Cleared if a ring ever can't be waited on, after which the batch fetch no longer uses io_uring
+static std::atomic<bool> io_uring_usable(true);
+// Whether io_uring can do IORING_OP_STATX on this kernel, found by setting up a ring the first time
+static bool io_uring_statx_available()
+{
+	static const bool available=[]() -> bool {
+		detail::io_uring_ring ring(1);
+		return statx_available() && ring.is_open() && ring.supports(IORING_OP_STATX);
+	}();
+	return available && io_uring_usable;
+}
+#endif
+
+bool fetch_metadata_uses_io_uring()
+{
+#if defined(FASTDIRECTORYENUMERATOR_HAVE_IO_URING) && defined(HAVE_STATX)
+	return io_uring_statx_available();
+#else
+	return false;
+#endif
+}
+
+// The entries of [begin, end) in ascending st_ino, those without it last, else empty if they already are
+static std::vector<directory_entry *> sort_by_inode(directory_entry *begin, directory_entry *end)
+{
+	// Sorting the keys alongside the pointers keeps the comparisons in cache, and the pointers break ties
+	// between hard links in the order given
+	std::vector<std::pair<uint64_t, directory_entry *>> keyed;
+	keyed.reserve(end-begin);
+	for(directory_entry *e=begin; e!=end; ++e)
+		keyed.push_back(std::make_pair(e->metadata_ready().have_ino ? e->st_ino() : (uint64_t)-1, e));
+	std::vector<directory_entry *> ret;
+	if(std::is_sorted(keyed.begin(), keyed.end()))
+		return ret;
+	std::sort(keyed.begin(), keyed.end());
+	ret.reserve(keyed.size());
+	for(auto &k : keyed)
+		ret.push_back(k.second);
+	return ret;
+}
+
+void fetch_metadata(const enumeration_handle &dir, directory_entry *begin, directory_entry *end, have_metadata_flags wanted, bool nosync, fetch_order order)
+{
+	wanted.value&=directory_entry::metadata_supported().value;
+	size_t count=end-begin;
+	std::vector<directory_entry *> sorted;
+	if(fetch_order::by_inode==order && count>1)
+		sorted=sort_by_inode(begin, end);
+	auto at=[begin, &sorted](size_t idx) { return sorted.empty() ? begin+idx : sorted[idx]; };
+#if defined(FASTDIRECTORYENUMERATOR_HAVE_IO_URING) && defined(HAVE_STATX)
+	if(count>1 && io_uring_statx_available())
+	{
+		// Keep up to queue_depth statx() in flight, each slot with its own result buffer. The results
+		// must outlive the ring so nothing in flight can write into freed memory.
+		static BOOST_CONSTEXPR_OR_CONST unsigned queue_depth=256;
+		struct slot_t
+		{
+			directory_entry *entry;
+			have_metadata_flags tofetch;
+			struct statx result;
+		};
+		std::vector<slot_t> slots(queue_depth);
+		detail::io_uring_ring ring(queue_depth);
+		if(ring.is_open())
+		{
+			std::vector<unsigned> freeslots;
+			freeslots.reserve(queue_depth);
+			for(unsigned n=0; n<queue_depth; n++)
+				freeslots.push_back(queue_depth-1-n);
+			unsigned inflight=0;
+			bool failed=false;
+			size_t next=0;
+			auto complete=[&](const io_uring_cqe &cqe) {
+				slot_t &slot=slots[cqe.user_data];
+				FASTDIRECTORYENUMERATOR_IF_STATS(lookup_done(io_uring_lookup, 0, cqe.res);)
+				if(cqe.res>=0)
+					slot.entry->_int_fill_from_statx(slot.tofetch, &slot.result);
+				freeslots.push_back((unsigned) cqe.user_data);
+				--inflight;
+			};
+			while(next!=count || inflight)
+			{
+				while(next!=count && !freeslots.empty())
+				{
+					have_metadata_flags tofetch;
+					tofetch.value=wanted.value&~at(next)->have_metadata.value;
+					if(!tofetch.value)
+					{
+						++next;
+						continue;
+					}
+					io_uring_sqe *sqe=ring.get_sqe();
+					if(!sqe)
+						break;
+					unsigned idx=freeslots.back();
+					freeslots.pop_back();
+					slot_t &slot=slots[idx];
+					slot.entry=at(next++);
+					slot.tofetch=tofetch;
+					sqe->opcode=IORING_OP_STATX;
+					sqe->fd=(int)(size_t)dir.native_handle();
+					sqe->addr=(uint64_t)(uintptr_t) slot.entry->leafname.c_str();
+					sqe->len=to_statx_mask(tofetch);
+					sqe->addr2=(uint64_t)(uintptr_t) &slot.result;
+					sqe->statx_flags=AT_SYMLINK_NOFOLLOW|(nosync ? AT_STATX_DONT_SYNC : 0);
+					sqe->user_data=idx;
+					++inflight;
+					FASTDIRECTORYENUMERATOR_IF_STATS(lookup_start(io_uring_lookup);)
+				}
+				if(!inflight)
+					break;
+				if(ring.submit(1)<0 && EINTR!=errno && EAGAIN!=errno && EBUSY!=errno)
+				{
+					failed=true;
+					break;
+				}
+				ring.reap(complete);
+			}
+			// The kernel still writes into the slots of any statx() it took off the ring before the failure, so
+			// wait for those before the ring and slots go
+			while(failed && inflight>ring.unsubmitted())
+			{
+				if(ring.submit(1)<0 && EINTR!=errno)
+				{
+					// Closing the ring only starts cancelling what is in flight, and a statx() already running on
+					// a kernel worker can still write its result afterwards. So the slots go to a graveyard living
+					// as long as the process, and io_uring isn't used again, which bounds it to the batches
+					// already running when this first happens.
+					static std::mutex graveyardlock;
+					static std::vector<std::unique_ptr<std::vector<slot_t>>> graveyard;
+					io_uring_usable=false;
+					std::lock_guard<std::mutex> g(graveyardlock);
+					graveyard.push_back(std::unique_ptr<std::vector<slot_t>>(new std::vector<slot_t>(std::move(slots))));
+					break;
+				}
+				ring.reap(complete);
+			}
+			if(!failed)
+				return;
+		}
+	}
+#endif
+	for(size_t n=0; n<count; n++)
+		at(n)->fetch_metadata(dir, wanted, nosync);
+}
+
+#if defined(FASTDIRECTORYENUMERATOR_HAVE_IO_URING) && defined(HAVE_STATX)
+namespace detail
+{
+	// One thread owning an io_uring which any thread can queue statx() lookups on. Only the reactor thread
+	// touches the ring, so queueing is a push onto pending and a write to an eventfd the ring polls, and
+	// however many batches are queued no more than queue_depth lookups are ever in flight.
+	class statx_reactor
+	{
+		static BOOST_CONSTEXPR_OR_CONST unsigned queue_depth=1024;
+		static BOOST_CONSTEXPR_OR_CONST uint64_t wake_tag=(uint64_t)-1;
+		struct batch
+		{
+			size_t remaining;
+			const std::atomic<bool> *cancelled;
+			detail::fetch_done_t done;
+			void *ctx;
+		};
+		struct request
+		{
+			directory_entry *entry;
+			int dirfd;
+			have_metadata_flags tofetch;
+			bool nosync;
+			batch *b;
+		};
+		struct slot_t
+		{
+			request req;
+			struct statx result;
+		};
+		detail::io_uring_ring ring;
+		int wakefd;
+		std::mutex lock;
+		std::vector<request> pending;  // queued but not yet submitted, taken from the back
+		std::vector<slot_t> slots;
+		std::vector<unsigned> freeslots;
+		bool polling;
+		statx_reactor() : ring(queue_depth+1), wakefd(eventfd(0, EFD_CLOEXEC)), slots(queue_depth), polling(false)
+		{
+			for(unsigned n=0; n<queue_depth; n++)
+				freeslots.push_back(n);
+		}
+		// Returns true if that was the last of its batch, which the caller then completes
+		static bool finished(batch *b) { return !--b->remaining; }
+		void run()
+		{
+			std::vector<batch *> complete;
+			std::vector<request> taken;
+			for(;;)
+			{
+				if(!polling)
+				{
+					io_uring_sqe *sqe=ring.get_sqe();
+					sqe->opcode=IORING_OP_POLL_ADD;
+					sqe->fd=wakefd;
+					sqe->poll_events=POLLIN;
+					sqe->user_data=wake_tag;
+					polling=true;
+				}
+				{
+					std::lock_guard<std::mutex> g(lock);
+					while(!pending.empty() && taken.size()<freeslots.size())
+					{
+						taken.push_back(pending.back());
+						pending.pop_back();
+					}
+				}
+				for(auto &req : taken)
+				{
+					if(req.b->cancelled && req.b->cancelled->load(std::memory_order_relaxed))
+					{
+						if(finished(req.b))
+							complete.push_back(req.b);
+						continue;
+					}
+					unsigned idx=freeslots.back();
+					freeslots.pop_back();
+					slot_t &slot=slots[idx];
+					slot.req=req;
+					io_uring_sqe *sqe=ring.get_sqe();
+					sqe->opcode=IORING_OP_STATX;
+					sqe->fd=req.dirfd;
+					sqe->addr=(uint64_t)(uintptr_t) req.entry->leafname.c_str();
+					sqe->len=to_statx_mask(req.tofetch);
+					sqe->addr2=(uint64_t)(uintptr_t) &slot.result;
+					sqe->statx_flags=AT_SYMLINK_NOFOLLOW|(req.nosync ? AT_STATX_DONT_SYNC : 0);
+					sqe->user_data=idx;
+					FASTDIRECTORYENUMERATOR_IF_STATS(lookup_start(io_uring_lookup);)
+				}
+				taken.clear();
+				for(batch *b : complete)
+				{
+					b->done(b->ctx);
+					delete b;
+				}
+				complete.clear();
+				ring.submit(1);
+				ring.reap([&](const io_uring_cqe &cqe) {
+					if(wake_tag==cqe.user_data)
+					{
+						uint64_t count;
+						if(read(wakefd, &count, sizeof(count))) { }
+						polling=false;
+						return;
+					}
+					slot_t &slot=slots[cqe.user_data];
+					FASTDIRECTORYENUMERATOR_IF_STATS(lookup_done(io_uring_lookup, 0, cqe.res);)
+					if(cqe.res>=0)
+						slot.req.entry->_int_fill_from_statx(slot.req.tofetch, &slot.result);
+					freeslots.push_back((unsigned) cqe.user_data);
+					if(finished(slot.req.b))
+						complete.push_back(slot.req.b);
+				});
+			}
+		}
+	public:
+		// The reactor, started the first time, or null if io_uring can't statx(). It lives as long as the process.
+		static statx_reactor *get()
+		{
+			static statx_reactor *reactor=[]() -> statx_reactor * {
+				if(!io_uring_statx_available())
+					return nullptr;
+				statx_reactor *ret=new statx_reactor;
+				if(!ret->ring.is_open() || -1==ret->wakefd)
+				{
+					if(-1!=ret->wakefd) close(ret->wakefd);
+					delete ret;
+					return nullptr;
+				}
+				std::thread(&statx_reactor::run, ret).detach();
+				return ret;
+			}();
+			return reactor;
+		}
+		void queue(const enumeration_handle &dir, directory_entry *begin, directory_entry *end, have_metadata_flags wanted, bool nosync,
+			const std::atomic<bool> *cancelled, detail::fetch_done_t done, void *ctx)
+		{
+			std::unique_ptr<batch> b(new batch);
+			b->remaining=0;
+			b->cancelled=cancelled;
+			b->done=done;
+			b->ctx=ctx;
+			{
+				std::lock_guard<std::mutex> g(lock);
+				// Queued in reverse, as the reactor takes from the back
+				for(directory_entry *e=end; e--!=begin;)
+				{
+					request req;
+					req.tofetch.value=wanted.value&~e->have_metadata.value;
+					if(!req.tofetch.value)
+						continue;
+					req.entry=e;
+					req.dirfd=(int)(size_t)dir.native_handle();
+					req.nosync=nosync;
+					req.b=b.get();
+					pending.push_back(req);
+					++b->remaining;
+				}
+				if(b->remaining)
+					b.release();
+			}
+			if(b)
+				done(ctx);
+			else
+			{
+				uint64_t one=1;
+				if(write(wakefd, &one, sizeof(one))) { }
+			}
+		}
+	};
+}
+#endif
+
+bool detail::fetch_metadata_reactor(const enumeration_handle &dir, directory_entry *begin, directory_entry *end, have_metadata_flags wanted, bool nosync,
+	const std::atomic<bool> *cancelled, detail::fetch_done_t done, void *ctx)
+{
+#if defined(FASTDIRECTORYENUMERATOR_HAVE_IO_URING) && defined(HAVE_STATX)
+	detail::statx_reactor *reactor=detail::statx_reactor::get();
+	if(!reactor)
+		return false;
+	wanted.value&=directory_entry::metadata_supported().value;
+	reactor->queue(dir, begin, end, wanted, nosync, cancelled, done, ctx);
+	return true;
+#else
+	(void) dir; (void) begin; (void) end; (void) wanted; (void) nosync; (void) cancelled; (void) done; (void) ctx;
+	return false;
+#endif
+}
+
+void parallel_fetch_metadata(const enumeration_handle &dir, directory_entry *begin, directory_entry *end, have_metadata_flags wanted, size_t threads, bool nosync, fetch_order order)
+{
+	static BOOST_CONSTEXPR_OR_CONST size_t chunk=1024;
+	size_t count=end-begin;
+	std::vector<directory_entry *> sorted;
+	if(fetch_order::by_inode==order && count>1)
+		sorted=sort_by_inode(begin, end);
+	auto at=[begin, &sorted](size_t idx) { return sorted.empty() ? begin+idx : sorted[idx]; };
+	if(!threads)
+		threads=std::max(1u, std::thread::hardware_concurrency());
+	threads=std::min(threads, (count+chunk-1)/chunk);
+	if(threads<=1)
+	{
+		for(size_t n=0; n<count; n++)
+			at(n)->fetch_metadata(dir, wanted, nosync);
+		return;
+	}
+	// Workers take the next chunk of entries until none remain, so slow lookups don't hold up the others
+	std::atomic<size_t> next(0);
+	std::mutex errorlock;
+	std::exception_ptr error;
+	auto worker=[&] {
+		try
+		{
+			enumeration_handle mydir(dir.native_handle(), ".", dir.path(), 0);
+			const enumeration_handle &lookupdir=mydir.is_open() ? mydir : dir;
+			size_t idx;
+			while((idx=next.fetch_add(chunk))<count)
+			{
+				for(size_t n=idx, n_end=std::min(idx+chunk, count); n<n_end; n++)
+					at(n)->fetch_metadata(lookupdir, wanted, nosync);
+			}
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> g(errorlock);
+			if(!error)
+				error=std::current_exception();
+		}
+	};
+	std::vector<std::thread> workers;
+	for(size_t n=1; n<threads; n++)
+		workers.push_back(std::thread(worker));
+	worker();
+	for(auto &w : workers)
+		w.join();
+	if(error)
+		std::rethrow_exception(error);
+}
+
+#ifdef WIN32
+namespace nt
+{
+	// From http://undocumented.ntinternals.net/UserMode/Undocumented%20Functions/NT%20Objects/File/FILE_INFORMATION_CLASS.html
+	// (only the directory enumeration classes are used here)
+	typedef enum _FILE_INFORMATION_CLASS {
+		FileNamesInformation                     = 12,
+		FileIdFullDirectoryInformation           = 38
+	} FILE_INFORMATION_CLASS;
+
+	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff540310(v=vs.85).aspx
+	typedef struct _FILE_ID_FULL_DIR_INFORMATION  {
+	  ULONG         NextEntryOffset;
+	  ULONG         FileIndex;
+	  LARGE_INTEGER CreationTime;
+	  LARGE_INTEGER LastAccessTime;
+	  LARGE_INTEGER LastWriteTime;
+	  LARGE_INTEGER ChangeTime;
+	  LARGE_INTEGER EndOfFile;
+	  LARGE_INTEGER AllocationSize;
+	  ULONG         FileAttributes;
+	  ULONG         FileNameLength;
+	  ULONG         EaSize;
+	  LARGE_INTEGER FileId;
+	  WCHAR         FileName[1];
+	} FILE_ID_FULL_DIR_INFORMATION, *PFILE_ID_FULL_DIR_INFORMATION;
+
+	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff540329(v=vs.85).aspx
+	typedef struct _FILE_NAMES_INFORMATION {
+	  ULONG NextEntryOffset;
+	  ULONG FileIndex;
+	  ULONG FileNameLength;
+	  WCHAR FileName[1];
+	} FILE_NAMES_INFORMATION, *PFILE_NAMES_INFORMATION;
+
+#ifndef NTSTATUS
+#define NTSTATUS LONG
+#endif
+#define STATUS_NO_MORE_FILES ((NTSTATUS) 0x80000006L)
+
+	// From http://msdn.microsoft.com/en-us/library/windows/hardware/ff550671(v=vs.85).aspx
+	typedef struct _IO_STATUS_BLOCK {
+		union {
+			NTSTATUS Status;
+			PVOID    Pointer;
+		};
+		ULONG_PTR Information;
+	} IO_STATUS_BLOCK, *PIO_STATUS_BLOCK;
+
+	// From http://msdn.microsoft.com/en-us/library/windows/desktop/aa380518(v=vs.85).aspx
+	typedef struct _LSA_UNICODE_STRING {
+	  USHORT Length;
+	  USHORT MaximumLength;
+	  PWSTR  Buffer;
+	} LSA_UNICODE_STRING, *PLSA_UNICODE_STRING, UNICODE_STRING, *PUNICODE_STRING;
+
+	// From http://undocumented.ntinternals.net/UserMode/Undocumented%20Functions/NT%20Objects/File/NtQueryDirectoryFile.html
+	// and http://msdn.microsoft.com/en-us/library/windows/hardware/ff567047(v=vs.85).aspx
+	typedef NTSTATUS (NTAPI *NtQueryDirectoryFile_t)(
+		/*_In_*/      HANDLE FileHandle,
+		/*_In_opt_*/  HANDLE Event,
+		/*_In_opt_*/  void *ApcRoutine,
+		/*_In_opt_*/  PVOID ApcContext,
+		/*_Out_*/     PIO_STATUS_BLOCK IoStatusBlock,
+		/*_Out_*/     PVOID FileInformation,
+		/*_In_*/      ULONG Length,
+		/*_In_*/      FILE_INFORMATION_CLASS FileInformationClass,
+		/*_In_*/      BOOLEAN ReturnSingleEntry,
+		/*_In_opt_*/  PUNICODE_STRING FileName,
+		/*_In_*/      BOOLEAN RestartScan
+		);
+}
+#else
+#ifdef __linux__
+// The kernel's struct linux_dirent64 as filled by getdents64(). Unlike the legacy getdents() the type
+// is a proper field rather than packed after the name.
+struct kernel_dirent
+{
+	uint64_t       d_ino;
+	int64_t        d_off;
+	unsigned short d_reclen;
+	unsigned char  d_type;
+	char           d_name[];
+};
+// glibc only recently gained a getdents64() wrapper, so call the syscall directly.
+static inline int kernel_getdents(int fd, char *buf, size_t count) { return (int) syscall(SYS_getdents64, fd, buf, count); }
+#else
+typedef struct dirent kernel_dirent;
+static inline int kernel_getdents(int fd, char *buf, size_t count) { return getdents(fd, buf, (int) count); }
+#endif
+#endif
+
+enumeration_handle::enumeration_handle(std::filesystem::path path, size_t buffersize) : h(nullptr), _path(std::move(path)), buffer(nullptr), buffer_size(0), buffer_pos(0), buffer_end(0), buffer_max(0), buffer_full(false), buffer_namesonly(false), eof(false), _kernel_calls(0), _pos(0), _dir(nullptr)
+#ifdef WIN32
+	, _restart(false), _skip(0)
+#endif
+{
+#ifdef WIN32
+	_int_open(nullptr, _path, buffersize);
+#else
+	_int_open(nullptr, _path.c_str(), buffersize);
+#endif
+#ifndef __linux__
+	// Where a relative path is has to be known before the current directory can change
+	if(h && !_path.is_absolute())
+		_int_dir();
+#endif
+}
+
+enumeration_handle::enumeration_handle(void *dirh, const std::filesystem::path &leafname, std::filesystem::path path, size_t buffersize) : h(nullptr), _path(std::move(path)), buffer(nullptr), buffer_size(0), buffer_pos(0), buffer_end(0), buffer_max(0), buffer_full(false), buffer_namesonly(false), eof(false), _kernel_calls(0), _pos(0), _dir(nullptr)
+#ifdef WIN32
+	, _restart(false), _skip(0)
+#endif
+{
+#ifdef WIN32
+	// CreateFile() can't open relative to a HANDLE, so this is just an open of path
+	(void) dirh; (void) leafname;
+	_int_open(nullptr, _path, buffersize);
+#else
+	_int_open(dirh, leafname.c_str(), buffersize);
+#endif
+#ifndef __linux__
+	if(h && !_path.is_absolute())
+		_int_dir();
+#endif
+}
+
+#ifdef WIN32
+void enumeration_handle::_int_open(void *, const std::filesystem::path &path, size_t buffersize)
+{
+	HANDLE ret=CreateFile(path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if(INVALID_HANDLE_VALUE==ret)
+		return;
+	h=ret;
+	if(!buffersize)
+		return;
+	// Directories have no size on NTFS worth guessing from, so adaptive buffers start at a page
+	if(adaptive_buffer_size==buffersize || adaptive_buffer_size_from_stat==buffersize)
+	{
+		buffer_max=max_adaptive_buffer_size;
+		buffersize=4096;
+	}
+	if(!_int_alloc(buffersize))
+	{
+		CloseHandle(h);
+		h=nullptr;
+		throw std::bad_alloc();
+	}
+}
+
+#else
+void enumeration_handle::_int_open(void *dirh, const char *path, size_t buffersize)
+{
+	int ret=openat(dirh ? (int)(size_t)dirh : AT_FDCWD, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(-1==ret)
+		return;
+	h=(void *)(size_t)ret;
+	if(!buffersize)
+		return;
+	if(adaptive_buffer_size==buffersize || adaptive_buffer_size_from_stat==buffersize)
+	{
+		buffer_max=max_adaptive_buffer_size;
+		struct stat s;
+		// getdents64() records run a little larger than what most filing systems keep on disk
+		if(adaptive_buffer_size_from_stat==buffersize && -1!=fstat(ret, &s) && s.st_size>0)
+			buffersize=std::min((size_t) s.st_size+(size_t) s.st_size/2, buffer_max);
+		else
+			buffersize=1;
+	}
+	if(!_int_alloc(buffersize))
+	{
+		close(ret);
+		h=nullptr;
+		throw std::bad_alloc();
+	}
+}
+#endif
+
+namespace
+{
+	// Kernel buffers below this come from the heap, as mapping, faulting in and unmapping fresh pages for every
+	// handle costs more than enumerating a small directory does
+	static BOOST_CONSTEXPR_OR_CONST size_t heap_buffer_limit=64*1024;
+	inline size_t page_size()
+	{
+#ifdef WIN32
+		return 4096;
+#else
+		static size_t pagesize=(size_t) sysconf(_SC_PAGESIZE);
+		return pagesize;
+#endif
+	}
+	inline char *alloc_buffer(size_t size)
+	{
+		if(size<heap_buffer_limit)
+		{
+#ifdef WIN32
+			return (char *) _aligned_malloc(size, page_size());
+#else
+			void *mem;
+			return posix_memalign(&mem, page_size(), size) ? nullptr : (char *) mem;
+#endif
+		}
+		// Otherwise page aligned memory straight from the kernel without touching the allocator
+#ifdef WIN32
+		return (char *) VirtualAlloc(nullptr, size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+#else
+		void *mem=mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		return MAP_FAILED==mem ? nullptr : (char *) mem;
+#endif
+	}
+	inline void free_buffer(char *buffer, size_t size)
+	{
+		if(!buffer)
+			return;
+#ifdef WIN32
+		if(size<heap_buffer_limit)
+			_aligned_free(buffer);
+		else
+			VirtualFree(buffer, 0, MEM_RELEASE);
+#else
+		if(size<heap_buffer_limit)
+			free(buffer);
+		else
+			munmap(buffer, size);
+#endif
+	}
+}
+
+bool enumeration_handle::_int_alloc(size_t buffersize)
+{
+	buffersize=(buffersize+page_size()-1)&~(page_size()-1);
+	FASTDIRECTORYENUMERATOR_IF_STATS(uint64_t begin=stats_now();)
+	char *mem=alloc_buffer(buffersize);
+	if(!mem)
+		return false;
+	FASTDIRECTORYENUMERATOR_IF_STATS(count_alloc(&_stats, buffersize, begin);)
+	free_buffer(buffer, buffer_size);
+	buffer=mem;
+	buffer_size=buffersize;
+	return true;
+}
+
+enumeration_handle::enumeration_handle(enumeration_handle &&o) BOOST_NOEXCEPT_OR_NOTHROW : h(o.h), _path(std::move(o._path)), buffer(o.buffer), buffer_size(o.buffer_size),
+	buffer_pos(o.buffer_pos), buffer_end(o.buffer_end), buffer_max(o.buffer_max), buffer_full(o.buffer_full), buffer_namesonly(o.buffer_namesonly), eof(o.eof), _kernel_calls(o._kernel_calls), _pos(o._pos), _stats(o._stats), _dir(o._dir)
+#ifdef WIN32
+	, _restart(o._restart), _skip(o._skip)
+#endif
+{
+	o.h=nullptr;
+	o._dir=nullptr;
+	o.buffer=nullptr;
+	o.buffer_size=o.buffer_pos=o.buffer_end=0;
+}
+
+detail::directory_ref *enumeration_handle::_int_dir()
+{
+	if(!_dir)
+	{
+		uint64_t dev=0, ino=0;
+		std::filesystem::path path;
+#ifdef __linux__
+		// Which directory this is, so a cached fd of it is known to be of the same one
+		struct stat s;
+		if(h && -1!=fstat((int)(size_t) h, &s))
+		{
+			dev=s.st_dev;
+			ino=s.st_ino;
+		}
+		// A relative path is taken from the fd, as the current directory may have changed since it was opened
+		if(h && !_path.is_absolute())
+		{
+			char link[32], buffer[PATH_MAX];
+			sprintf(link, "/proc/self/fd/%d", (int)(size_t) h);
+			ssize_t len=readlink(link, buffer, sizeof(buffer));
+			if(len>0 && len<(ssize_t) sizeof(buffer) && '/'==buffer[0])
+				path=std::string(buffer, len);
+		}
+#endif
+		// Elsewhere a relative path was made absolute when opened
+		_dir=new detail::directory_ref(path.empty() ? std::filesystem::absolute(_path) : std::move(path), dev, ino);
+	}
+	return _dir;
+}
+
+enumeration_handle::~enumeration_handle()
+{
+	free_buffer(buffer, buffer_size);
+	detail::directory_ref::release(_dir);
+#ifdef WIN32
+	if(h) CloseHandle(h);
+#else
+	if(h) close((int)(size_t)h);
+#endif
+}
+
+void *enumeration_handle::release() BOOST_NOEXCEPT_OR_NOTHROW
+{
+	free_buffer(buffer, buffer_size);
+	void *ret=h;
+	h=nullptr;
+	buffer=nullptr;
+	buffer_size=buffer_pos=buffer_end=0;
+	eof=true;
+	return ret;
+}
+
+bool enumeration_handle::seek(position_type pos)
+{
+	if(!h)
+		return false;
+#ifdef WIN32
+	// NtQueryDirectoryFile() can only start over, so pass over pos entries again
+	if(pos<0)
+		return false;
+	_restart=true;
+	_skip=pos;
+	_pos=0;
+#else
+	if(-1==lseek((int)(size_t)h, (off_t) pos, SEEK_SET))
+		return false;
+	_pos=pos;
+#endif
+	buffer_pos=buffer_end=0;
+	eof=false;
+	return true;
+}
+
+bool enumeration_handle::_int_refill(const std::filesystem::path &kernelglob, bool namesonly)
+{
+	buffer_pos=buffer_end=0;
+	if(eof || !h)
+		return false;
+	// The buffer is empty, so growing it loses nothing. If it can't be grown, carry on at the size it is.
+	if(buffer_full && buffer_max && buffer_size<buffer_max && !_int_alloc(std::min(buffer_size*2, buffer_max)))
+		buffer_max=0;
+	++_kernel_calls;
+#ifdef WIN32
+	static nt::NtQueryDirectoryFile_t NtQueryDirectoryFile;
+	if(!NtQueryDirectoryFile)
+		if(!(NtQueryDirectoryFile=(nt::NtQueryDirectoryFile_t) GetProcAddress(GetModuleHandleA("NTDLL.DLL"), "NtQueryDirectoryFile")))
+			abort();
+	nt::IO_STATUS_BLOCK isb={ 0 };
+	nt::UNICODE_STRING _glob;
+	if(!kernelglob.empty())
+	{
+		_glob.Buffer=const_cast<std::filesystem::path::value_type *>(kernelglob.c_str());
+		_glob.Length=_glob.MaximumLength=(USHORT) (kernelglob.native().size()*sizeof(std::filesystem::path::value_type));
+	}
+	FASTDIRECTORYENUMERATOR_IF_STATS(uint64_t begin=stats_now();)
+	NTSTATUS ntval=NtQueryDirectoryFile(h, NULL, NULL, NULL, &isb, buffer, (ULONG) buffer_size,
+		namesonly ? nt::FileNamesInformation : nt::FileIdFullDirectoryInformation, FALSE, kernelglob.empty() ? NULL : &_glob, _restart ? TRUE : FALSE);
+	FASTDIRECTORYENUMERATOR_IF_STATS(count_kernel_call(_stats, h, 0/*STATUS_SUCCESS*/==ntval ? (int64_t) isb.Information : 0, begin);)
+	_restart=false;
+	if(0/*STATUS_SUCCESS*/!=ntval)
+	{
+		// STATUS_NO_MORE_FILES is the normal end, anything else we treat as the end too
+		eof=true;
+		return false;
+	}
+	buffer_end=isb.Information;
+	buffer_namesonly=namesonly;
+	// Room left for less than an entry with the longest leafname means there may have been more
+	buffer_full=buffer_size-buffer_end<sizeof(nt::FILE_ID_FULL_DIR_INFORMATION)+MAX_PATH*sizeof(wchar_t);
+#else
+	(void) kernelglob;  // getdents() can't filter, so callers match every name themselves
+	FASTDIRECTORYENUMERATOR_IF_STATS(uint64_t begin=stats_now();)
+	int bytes=kernel_getdents((int)(size_t)h, buffer, buffer_size);
+	FASTDIRECTORYENUMERATOR_IF_STATS(count_kernel_call(_stats, h, bytes, begin);)
+	if(bytes<=0)
+	{
+		eof=true;
+		return false;
+	}
+	buffer_end=bytes;
+	buffer_namesonly=namesonly;
+	// Room left for less than an entry with the longest leafname means there may have been more
+	buffer_full=buffer_size-buffer_end<offsetof(kernel_dirent, d_name)+NAME_MAX+1+8;
+#endif
+	return true;
+}
+
+glob_matcher::glob_matcher(std::filesystem::path pattern) : _pattern(std::move(pattern)), _shape(shape_t::everything)
+{
+	const string_type &p=_pattern.native();
+	if(p.empty())
+		return;
+	_shape=shape_t::general;
+	// Anything with ?, [ or an escape needs the full glob semantics
+	size_t stars=0;
+	for(auto c : p)
+		if('?'==c || '['==c || '\\'==c)
+			return;
+		else if('*'==c)
+			++stars;
+	size_t first=p.find('*'), last=p.rfind('*');
+	if(!stars)
+	{
+		_shape=shape_t::literal;
+		_a=p;
+	}
+	else if(stars==p.size())
+		_shape=shape_t::everything;
+	else if(1==stars)
+	{
+		_a=p.substr(0, first);
+		_b=p.substr(first+1);
+		_shape=_b.empty() ? shape_t::prefix : _a.empty() ? shape_t::suffix : shape_t::prefix_suffix;
+		if(shape_t::suffix==_shape)
+			std::swap(_a, _b);
+	}
+	else if(2==stars && 0==first && p.size()-1==last)
+	{
+		_shape=shape_t::substring;
+		_a=p.substr(1, p.size()-2);
+	}
+}
+
+bool glob_matcher::_int_match_substring(name_view name) const
+{
+	const std::filesystem::path::value_type *s=name.data(), *needle=_a.data();
+	size_t n=name.size(), k=_a.size(), i=0;
+	if(n<k)
+		return false;
+#if defined(__SSE2__) && !defined(WIN32)
+	// Compare sixteen positions at once against the needle's first and last characters, only checking the
+	// middle of the needle where both match. Loads never go beyond the end of name.
+	const __m128i firstc=_mm_set1_epi8(needle[0]), lastc=_mm_set1_epi8(needle[k-1]);
+	for(; i+k-1+16<=n; i+=16)
+	{
+		__m128i bf=_mm_loadu_si128((const __m128i *)(s+i));
+		__m128i bl=_mm_loadu_si128((const __m128i *)(s+i+k-1));
+		unsigned mask=(unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(bf, firstc), _mm_cmpeq_epi8(bl, lastc)));
+		for(; mask; mask&=mask-1)
+			if(k<=2 || !memcmp(s+i+__builtin_ctz(mask)+1, needle+1, k-2))
+				return true;
+	}
+#endif
+	for(; i+k<=n; i++)
+		if(s[i]==needle[0] && !traits_type::compare(s+i+1, needle+1, k-1))
+			return true;
+	return false;
+}
+
+#ifdef WIN32
+// Windows wildcards are just * and ?
+static bool wildcard_match(const wchar_t *p, const wchar_t *pend, const wchar_t *s, const wchar_t *send)
+{
+	const wchar_t *star=nullptr, *resume=nullptr;
+	while(s!=send)
+	{
+		if(p!=pend && ('?'==*p || *p==*s))
+		{
+			++p; ++s;
+		}
+		else if(p!=pend && '*'==*p)
+		{
+			star=++p;
+			resume=s;
+		}
+		else if(star)
+		{
+			p=star;
+			s=++resume;
+		}
+		else
+			return false;
+	}
+	while(p!=pend && '*'==*p)
+		++p;
+	return p==pend;
+}
+#endif
+
+bool glob_matcher::_int_match_general(name_view name) const
+{
+#ifdef WIN32
+	const string_type &p=_pattern.native();
+	return wildcard_match(p.data(), p.data()+p.size(), name.data(), name.data()+name.size());
+#else
+	// fnmatch() wants a null terminated name, and leafnames fit into NAME_MAX
+	char buffer[256];
+	if(name.size()<sizeof(buffer))
+	{
+		memcpy(buffer, name.data(), name.size());
+		buffer[name.size()]=0;
+		return !fnmatch(_pattern.c_str(), buffer, 0);
+	}
+	return !fnmatch(_pattern.c_str(), std::string(name.data(), name.size()).c_str(), 0);
+#endif
+}
+
+// Returns the longest run of characters in a glob pattern which any match must contain, or empty if unsure
+static std::filesystem::path::string_type required_literal(const std::filesystem::path::string_type &p)
+{
+	std::filesystem::path::string_type best, run;
+	for(size_t n=0; n<p.size(); n++)
+	{
+		auto c=p[n];
+		bool literal=('*'!=c && '?'!=c);
+#ifndef WIN32
+		if('\\'==c)
+		{
+			literal=false;
+			++n;
+		}
+		else if('['==c)
+		{
+			literal=false;
+			size_t close=n+1;
+			if(close<p.size() && ('!'==p[close] || '^'==p[close])) ++close;
+			if(close<p.size() && ']'==p[close]) ++close;
+			close=p.find(']', close);
+			// Character classes like [[:alpha:]] have brackets within brackets, which isn't worth parsing
+			if(std::filesystem::path::string_type::npos!=close && std::filesystem::path::string_type::npos!=p.find('[', n+1) && p.find('[', n+1)<close)
+				return std::filesystem::path::string_type();
+			// An unclosed [ is a literal [, but not worth the bother
+			if(std::filesystem::path::string_type::npos!=close)
+				n=close;
+		}
+#endif
+		if(literal)
+			run.push_back(c);
+		else
+			run.clear();
+		if(run.size()>best.size())
+			best=run;
+	}
+	return best;
+}
+
+filter_set::filter_set() : _have_includes(false), _have_excludes(false), _alphabet(1)
+{
+	memset(_classes, 0, sizeof(_classes));
+}
+
+filter_set::filter_set(const std::vector<std::filesystem::path> &includes, const std::vector<std::filesystem::path> &excludes) : _have_includes(!includes.empty()), _have_excludes(!excludes.empty()), _alphabet(1)
+{
+	typedef std::filesystem::path::value_type value_type;
+	typedef std::make_unsigned<value_type>::type uchar;
+	memset(_classes, 0, sizeof(_classes));
+	_patterns.reserve(includes.size()+excludes.size());
+	for(size_t n=0; n<includes.size()+excludes.size(); n++)
+	{
+		bool exclude=(n>=includes.size());
+		pattern_t p={ glob_matcher(exclude ? excludes[n-includes.size()] : includes[n]), std::filesystem::path::string_type(), exclude };
+		// prefix_suffix is found by its prefix and checked in full
+		if(glob_matcher::shape_t::general==p.glob.shape())
+			p.key=required_literal(p.glob.pattern().native());
+		else
+			p.key=p.glob._a;
+		_patterns.push_back(std::move(p));
+	}
+	for(uint32_t n=0; n<_patterns.size(); n++)
+	{
+		const pattern_t &p=_patterns[n];
+		if(p.key.empty())
+			_general.push_back(n);
+		else
+		{
+			for(auto c : p.key)
+			{
+				if(_int_byte((uchar) c))
+				{
+					if(!_classes[(uchar) c])
+						_classes[(uchar) c]=(unsigned char) _alphabet++;
+				}
+				else if(!_int_class(c))
+				{
+					_wide_classes.insert(std::lower_bound(_wide_classes.begin(), _wide_classes.end(), std::make_pair(c, (uint32_t) 0)), std::make_pair(c, _alphabet++));
+				}
+			}
+		}
+	}
+	if(_general.size()==_patterns.size())
+		return;
+	// More than 255 distinct characters would overflow _classes, so fall back to trying those patterns one by one
+	if(_alphabet>256)
+	{
+		_general.clear();
+		for(uint32_t n=0; n<_patterns.size(); n++)
+			_general.push_back(n);
+		return;
+	}
+	// Build the trie of keys
+	static BOOST_CONSTEXPR_OR_CONST uint32_t none=(uint32_t)-1;
+	std::vector<std::vector<uint32_t>> outs(1);
+	_next.assign(_alphabet, none);
+	for(uint32_t n=0; n<_patterns.size(); n++)
+	{
+		if(_patterns[n].key.empty())
+			continue;
+		uint32_t state=0;
+		for(auto c : _patterns[n].key)
+		{
+			uint32_t &next=_next[state*_alphabet+_int_class(c)];
+			if(none==next)
+			{
+				next=(uint32_t) outs.size();
+				outs.push_back(std::vector<uint32_t>());
+				_next.resize(_next.size()+_alphabet, none);
+			}
+			state=_next[state*_alphabet+_int_class(c)];
+		}
+		outs[state].push_back(n);
+	}
+	// Breadth first, add the failure transitions and the outputs of each state's failure state
+	std::vector<uint32_t> fail(outs.size(), 0), queue;
+	queue.reserve(outs.size());
+	for(uint32_t c=0; c<_alphabet; c++)
+	{
+		uint32_t &next=_next[c];
+		if(none==next)
+			next=0;
+		else
+			queue.push_back(next);
+	}
+	for(size_t q=0; q<queue.size(); q++)
+	{
+		uint32_t state=queue[q];
+		for(uint32_t c=0; c<_alphabet; c++)
+		{
+			uint32_t &next=_next[state*_alphabet+c];
+			if(none==next)
+				next=_next[fail[state]*_alphabet+c];
+			else
+			{
+				fail[next]=_next[fail[state]*_alphabet+c];
+				outs[next].insert(outs[next].end(), outs[fail[next]].begin(), outs[fail[next]].end());
+				queue.push_back(next);
+			}
+		}
+	}
+	_out_begin.reserve(outs.size()+1);
+	for(auto &out : outs)
+	{
+		_out_begin.push_back((uint32_t) _outs.size());
+		_outs.insert(_outs.end(), out.begin(), out.end());
+	}
+	_out_begin.push_back((uint32_t) _outs.size());
+}
+
+bool filter_set::_int_hit(const pattern_t &p, name_view name, size_t end) const
+{
+	// The pattern's key ends at end within name
+	switch(p.glob.shape())
+	{
+	case glob_matcher::shape_t::general:
+		return p.glob(name);
+	case glob_matcher::shape_t::literal:
+		return end==name.size() && end==p.glob._a.size();
+	case glob_matcher::shape_t::prefix:
+		return end==p.glob._a.size();
+	case glob_matcher::shape_t::suffix:
+		return end==name.size();
+	case glob_matcher::shape_t::prefix_suffix:
+		return end==p.glob._a.size() && p.glob(name);
+	default:
+		return true;
+	}
+}
+
+bool filter_set::operator()(name_view name) const
+{
+	bool included=!_have_includes;
+	if(!_next.empty())
+	{
+		uint32_t state=0;
+		for(size_t i=0; i<name.size(); i++)
+		{
+			state=_next[state*_alphabet+_int_class(name[i])];
+			for(uint32_t o=_out_begin[state]; o<_out_begin[state+1]; o++)
+			{
+				const pattern_t &p=_patterns[_outs[o]];
+				if(!p.exclude && included)
+					continue;
+				if(!_int_hit(p, name, i+1))
+					continue;
+				if(p.exclude)
+					return false;
+				included=true;
+				if(!_have_excludes)
+					return true;
+			}
+		}
+	}
+	for(auto n : _general)
+	{
+		const pattern_t &p=_patterns[n];
+		if(!p.exclude && included)
+			continue;
+		if(p.glob(name))
+		{
+			if(p.exclude)
+				return false;
+			included=true;
+		}
+	}
+	return included;
+}
+
+std::unique_ptr<enumeration_handle> begin_enumerate_directory(std::filesystem::path path, size_t buffersize)
+{
+	std::unique_ptr<enumeration_handle> ret(new enumeration_handle(std::move(path), buffersize));
+	if(!ret->is_open())
+		ret.reset();
+	return ret;
+}
+
+std::unique_ptr<enumeration_handle> resume_enumerate_directory(std::filesystem::path path, enumeration_handle::position_type pos, size_t buffersize)
+{
+	std::unique_ptr<enumeration_handle> ret(new enumeration_handle(std::move(path), buffersize));
+	if(!ret->is_open() || !ret->seek(pos))
+		ret.reset();
+	return ret;
+}
+
+std::unique_ptr<std::vector<directory_entry>> enumerate_directory(enumeration_handle &h, size_t maxitems, std::filesystem::path glob, bool namesonly)
+{
+	std::unique_ptr<std::vector<directory_entry>> ret(new std::vector<directory_entry>);
+	// A full kernel buffer of short leafnames holds about this many, so a small directory doesn't pay for maxitems
+	ret->reserve(std::min(maxitems, h.kernel_buffer_size()/32));
+	if(!enumerate_directory(h, *ret, maxitems, std::move(glob), namesonly))
+		ret.reset();
+	return ret;
+}
+
+namespace
+{
+	// Windows applies a single glob in the kernel, which matches case insensitively, so it isn't matched again
+	inline const std::filesystem::path &kernel_glob(const glob_matcher &glob) { return glob.pattern(); }
+	inline const std::filesystem::path &kernel_glob(const filter_set &) { static const std::filesystem::path none; return none; }
+	inline bool user_match(const glob_matcher &glob, name_view name)
+	{
+#ifdef WIN32
+		(void) glob; (void) name;
+		return true;
+#else
+		return glob(name);
+#endif
+	}
+	inline bool user_match(const filter_set &filter, name_view name) { return filter(name); }
+}
+
+template<class M, class F> bool enumeration_handle::_int_for_each(size_t maxitems, const M &match, bool namesonly, F &&f)
+{
+	// Calls f(view, raw) for each entry which isn't '.', '..', deleted or filtered out by match. raw is the
+	// kernel's record if it carries more than names, else null. An adaptive chunk refills at most once.
+	size_t count=0;
+	dirent_view v;
+	bool once=(enumeration_handle::adaptive_chunk==maxitems), refilled=false;
+	if(once)
+		maxitems=(size_t)-1;
+	FASTDIRECTORYENUMERATOR_IF_STATS(parse_counter counter(_stats, count);)
+	while(count<maxitems)
+	{
+		if(buffer_pos>=buffer_end)
+		{
+			if((once && refilled) || !_int_refill(kernel_glob(match), namesonly))
+				break;
+			refilled=true;
+		}
+		while(buffer_pos<buffer_end && count<maxitems)
+		{
+#ifdef WIN32
+			const void *raw;
+			size_t length;
+			if(buffer_namesonly)
+			{
+				nt::FILE_NAMES_INFORMATION *ffdi=(nt::FILE_NAMES_INFORMATION *)(buffer+buffer_pos);
+				buffer_pos=ffdi->NextEntryOffset ? buffer_pos+ffdi->NextEntryOffset : buffer_end;
+				length=ffdi->FileNameLength/sizeof(std::filesystem::path::value_type);
+				v.name=name_view(ffdi->FileName, length);
+				v.d_ino=0;
+				v.st_type=0;
+				raw=nullptr;
+			}
+			else
+			{
+				nt::FILE_ID_FULL_DIR_INFORMATION *ffdi=(nt::FILE_ID_FULL_DIR_INFORMATION *)(buffer+buffer_pos);
+				buffer_pos=ffdi->NextEntryOffset ? buffer_pos+ffdi->NextEntryOffset : buffer_end;
+				length=ffdi->FileNameLength/sizeof(std::filesystem::path::value_type);
+				v.name=name_view(ffdi->FileName, length);
+				v.d_ino=ffdi->FileId.QuadPart;
+				v.st_type=to_st_type(ffdi->FileAttributes);
+				raw=ffdi;
+			}
+			// FileIndex is meaningless on NTFS, so the position is the count of entries returned
+			v.d_off=++_pos;
+			FASTDIRECTORYENUMERATOR_IF_STATS(++counter.parsed;)
+			if(_skip)
+			{
+				--_skip;
+				continue;
+			}
+			if(length<=2 && '.'==v.name[0])
+				if(1==length || '.'==v.name[1]) continue;
+			if(!user_match(match, v.name))
+			{
+				FASTDIRECTORYENUMERATOR_IF_STATS(++counter.filtered;)
+				continue;
+			}
+#else
+			const void *raw=nullptr;
+			kernel_dirent *dent=(kernel_dirent *)(buffer+buffer_pos);
+			buffer_pos+=dent->d_reclen;
+			_pos=dent->d_off;
+			FASTDIRECTORYENUMERATOR_IF_STATS(++counter.parsed;)
+			if(!dent->d_ino)
+				continue;
+			size_t length=strlen(dent->d_name);
+			if(length<=2 && '.'==dent->d_name[0])
+				if(1==length || '.'==dent->d_name[1]) continue;
+			v.name=name_view(dent->d_name, length);
+			if(!user_match(match, v.name))
+			{
+				FASTDIRECTORYENUMERATOR_IF_STATS(++counter.filtered;)
+				continue;
+			}
+			v.d_ino=dent->d_ino;
+			v.d_off=dent->d_off;
+			v.st_type=to_st_type(dent->d_type);
+#endif
+			++count;
+			if(!f(v, raw))
+				return true;
+		}
+	}
+	return count>0 || buffer_pos<buffer_end || !eof;
+}
+
+void directory_entry::_int_fill_from_dirent(const dirent_view &v, const void *raw)
+{
+	leafname=std::filesystem::path::string_type(v.name.data(), v.name.size());
+#ifdef WIN32
+	if(raw)
+	{
+		const nt::FILE_ID_FULL_DIR_INFORMATION *ffdi=(const nt::FILE_ID_FULL_DIR_INFORMATION *) raw;
+		// This is what windows returns with each enumeration
+		have_metadata.value=0;
+		have_metadata.have_ino=1;
+		have_metadata.have_type=1;
+		have_metadata.have_atim=1;
+		have_metadata.have_mtim=1;
+		have_metadata.have_ctim=1;
+		have_metadata.have_size=1;
+		have_metadata.have_allocated=1;
+		have_metadata.have_birthtim=1;
+		_ino=v.d_ino;
+		_type=v.st_type;
+		stat_t &stat=_int_stat();
+		stat.st_atim=to_timespec(ffdi->LastAccessTime);
+		stat.st_mtim=to_timespec(ffdi->LastWriteTime);
+		stat.st_ctim=to_timespec(ffdi->ChangeTime);
+		stat.st_size=ffdi->EndOfFile.QuadPart;
+		stat.st_allocated=ffdi->AllocationSize.QuadPart;
+		stat.st_birthtim=to_timespec(ffdi->CreationTime);
+	}
+	else
+		have_metadata.value=0;
+#else
+	(void) raw;
+	// This is what POSIX returns with getdents()
+	have_metadata.value=0;
+	have_metadata.have_ino=1;
+	have_metadata.have_type=(0!=v.st_type);
+	_ino=v.d_ino;
+	_type=v.st_type;
+#endif
+}
+
+// Appends item to out, counting any growth of out and the leafname if it was too long to be stored inline
+static inline void push_back_counted(enumeration_stats &stats, std::vector<directory_entry> &out, directory_entry &&item, size_t namelength)
+{
+#ifdef FASTDIRECTORYENUMERATOR_STATS
+	static const size_t inline_name=std::filesystem::path::string_type().capacity();
+	if(namelength>inline_name)
+		count_alloc(&stats, (namelength+1)*sizeof(std::filesystem::path::value_type), 0);
+	if(out.size()==out.capacity())
+	{
+		uint64_t begin=stats_now();
+		out.push_back(std::move(item));
+		count_alloc(&stats, out.capacity()*sizeof(directory_entry), begin);
+		return;
+	}
+#else
+	(void) stats; (void) namelength;
+#endif
+	out.push_back(std::move(item));
+}
+
+bool enumerate_directory(enumeration_handle &h, std::vector<directory_entry> &out, size_t maxitems, const glob_matcher &glob, bool namesonly)
+{
+	out.clear();
+	directory_entry item;
+	return h._int_for_each(maxitems, glob, namesonly, [&](const dirent_view &v, const void *raw) -> bool {
+		item._int_fill_from_dirent(v, raw);
+		item._int_set_dir(h._int_dir());
+		push_back_counted(h._stats, out, std::move(item), v.name.size());
+		return true;
+	});
+}
+
+bool enumerate_directory(enumeration_handle &h, std::vector<directory_entry> &out, size_t maxitems, const filter_set &filter, bool namesonly)
+{
+	out.clear();
+	directory_entry item;
+	return h._int_for_each(maxitems, filter, namesonly, [&](const dirent_view &v, const void *raw) -> bool {
+		item._int_fill_from_dirent(v, raw);
+		item._int_set_dir(h._int_dir());
+		push_back_counted(h._stats, out, std::move(item), v.name.size());
+		return true;
+	});
+}
+
+bool visit_directory(enumeration_handle &h, detail::dirent_visitor_t visitor, void *ctx, size_t maxitems, const glob_matcher &glob)
+{
+	return h._int_for_each(maxitems, glob, false, [visitor, ctx](const dirent_view &v, const void *) { return visitor(ctx, v); });
+}
+
+bool visit_directory(enumeration_handle &h, detail::dirent_visitor_t visitor, void *ctx, size_t maxitems, const filter_set &filter)
+{
+	return h._int_for_each(maxitems, filter, false, [visitor, ctx](const dirent_view &v, const void *) { return visitor(ctx, v); });
+}
+
+size_t parallel_enumerate_directory(const std::filesystem::path &path, std::vector<directory_entry> &out, size_t threads)
+{
+	typedef enumeration_handle::position_type position_type;
+	out.clear();
+	// One page of buffer is plenty for probing, which only looks at the first entry found
+	enumeration_handle dir(path, 4096);
+	if(!dir.is_open())
+		return 0;
+	if(!threads)
+		threads=std::max(1u, std::thread::hardware_concurrency());
+	const glob_matcher everything;
+	std::vector<position_type> starts;
+#ifndef WIN32
+	if(threads>1)
+	{
+		// Returns false if nothing is at or after x, else the position just after the first entry which is
+		auto probe=[&](position_type x, position_type &found) -> bool {
+			bool any=false;
+			if(dir.seek(x))
+				dir._int_for_each(1, everything, true, [&](const dirent_view &v, const void *) { found=v.d_off; any=true; return false; });
+			return any;
+		};
+		// Find roughly where the positions end by doubling then bisecting
+		position_type found, lo=0, hi=1;
+		if(probe(0, found))
+		{
+			while(hi<((position_type) 1<<62) && probe(hi, found))
+				lo=hi, hi*=2;
+			while(hi-lo>1)
+			{
+				position_type mid=lo+(hi-lo)/2;
+				if(probe(mid, found)) lo=mid; else hi=mid;
+			}
+			// Partitions start where entries returned start, so entries skipped as '.', '..' or deleted never
+			// straddle a boundary. Several partitions per thread even out uneven ones.
+			size_t parts=threads*4;
+			bool increasing=true;
+			for(size_t n=1; n<parts && increasing; n++)
+			{
+				position_type x=(position_type)(lo/(double) parts*n);
+				if(probe(x, found))
+				{
+					increasing=found>x;
+					starts.push_back(found);
+				}
+			}
+			std::sort(starts.begin(), starts.end());
+			starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+			if(!increasing || (!starts.empty() && starts.front()<=0))
+				starts.clear();
+		}
+	}
+#endif
+	if(!starts.empty())
+	{
+		starts.insert(starts.begin(), 0);
+		std::vector<std::vector<directory_entry>> parts(starts.size());
+		// Every worker's entries share the one directory
+		detail::directory_ref *ref=dir._int_dir();
+		std::atomic<size_t> next(0);
+		std::atomic<bool> failed(false);
+		std::mutex errorlock;
+		std::exception_ptr error;
+		auto worker=[&] {
+			try
+			{
+				enumeration_handle mine(dir.native_handle(), ".", path);
+				if(!mine.is_open())
+				{
+					failed=true;
+					return;
+				}
+				size_t idx;
+				while(!failed && (idx=next++)<parts.size())
+				{
+					position_type pos=starts[idx], end=(idx+1<starts.size()) ? starts[idx+1] : std::numeric_limits<position_type>::max();
+					if(!mine.seek(pos))
+					{
+						failed=true;
+						return;
+					}
+					std::vector<directory_entry> &part=parts[idx];
+					directory_entry item;
+					mine._int_for_each((size_t)-1, everything, false, [&](const dirent_view &v, const void *raw) -> bool {
+						// pos is where this entry starts
+						if(pos>=end)
+							return false;
+						if(v.d_off<=pos)
+						{
+							failed=true;
+							return false;
+						}
+						pos=v.d_off;
+						item._int_fill_from_dirent(v, raw);
+						item._int_set_dir(ref);
+						part.push_back(std::move(item));
+						return true;
+					});
+				}
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> g(errorlock);
+				if(!error)
+					error=std::current_exception();
+			}
+		};
+		std::vector<std::thread> workers;
+		for(size_t n=1; n<std::min(threads, parts.size()); n++)
+			workers.push_back(std::thread(worker));
+		worker();
+		for(auto &w : workers)
+			w.join();
+		if(error)
+			std::rethrow_exception(error);
+		if(!failed)
+		{
+			size_t count=0;
+			for(auto &part : parts)
+				count+=part.size();
+			out.reserve(count);
+			for(auto &part : parts)
+				std::move(part.begin(), part.end(), std::back_inserter(out));
+			return parts.size();
+		}
+	}
+	enumeration_handle h(path);
+	if(!h.is_open())
+		return 0;
+	std::vector<directory_entry> chunk;
+	while(enumerate_directory(h, chunk, 4096, everything, false))
+		std::move(chunk.begin(), chunk.end(), std::back_inserter(out));
+	return 1;
+}
+
+void packed_enumeration::push_back(name_view name, uint64_t st_ino, uint16_t st_type)
+{
+	record r;
+	r.st_ino=st_ino;
+	r.name_offset=names.size();
+	r.stat_index=no_stat;
+	r.name_length=(uint16_t) name.size();
+	r.st_type=st_type;
+	r.have_metadata.value=0;
+#ifndef WIN32
+	// This is what POSIX returns with getdents()
+	r.have_metadata.have_ino=1;
+#else
+	r.have_metadata.have_ino=(0!=st_ino);
+#endif
+	r.have_metadata.have_type=(0!=st_type);
+	names.insert(names.end(), name.data(), name.data()+name.size());
+	names.push_back(0);
+	records.push_back(r);
+}
+
+void packed_enumeration::push_back(const directory_entry &e)
+{
+	const std::filesystem::path::string_type &leafname=e.leafname.native();
+	push_back(name_view(leafname.data(), leafname.size()), e._ino, e._type);
+	record &r=records.back();
+	r.have_metadata=e.have_metadata;
+	have_metadata_flags inline_metadata; inline_metadata.value=0;
+	inline_metadata.have_ino=inline_metadata.have_type=1;
+	if(e.have_metadata.value&~inline_metadata.value)
+	{
+		r.stat_index=(uint32_t) stats.size();
+		stats.push_back(e._int_stat_copy());
+	}
+}
+
+directory_entry packed_enumeration::to_directory_entry(size_t idx) const
+{
+	const record &r=records[idx];
+	directory_entry ret;
+	if(no_stat!=r.stat_index)
+		ret._stat.reset(new directory_entry::stat_t(stats[r.stat_index]));
+	ret.leafname=std::filesystem::path::string_type(names.data()+r.name_offset, r.name_length);
+	ret.have_metadata=r.have_metadata;
+	ret._ino=r.st_ino;
+	ret._type=r.st_type;
+	return ret;
+}
+
+have_metadata_flags packed_enumeration::fetch_metadata(size_t idx, std::filesystem::path prefix, have_metadata_flags wanted)
+{
+	record &r=records[idx];
+	have_metadata_flags tofetch;
+	tofetch.value=wanted.value&directory_entry::metadata_supported().value&~r.have_metadata.value;
+	if(!tofetch.value)
+		return r.have_metadata;
+	directory_entry e(to_directory_entry(idx));
+	e._int_fetch(tofetch, std::move(prefix));
+	if(no_stat==r.stat_index)
+	{
+		r.stat_index=(uint32_t) stats.size();
+		stats.push_back(e._int_stat_copy());
+	}
+	else
+		stats[r.stat_index]=e._int_stat_copy();
+	r.have_metadata=e.have_metadata;
+	r.st_ino=e._ino;
+	r.st_type=e._type;
+	return r.have_metadata;
+}
+
+bool enumerate_directory(enumeration_handle &h, packed_enumeration &out, size_t maxitems, const glob_matcher &glob)
+{
+	return visit_directory(h, [&out](const dirent_view &v) { out.push_back(v.name, v.d_ino, v.st_type); return true; }, maxitems, glob);
+}
+
+bool enumerate_directory(enumeration_handle &h, packed_enumeration &out, size_t maxitems, const filter_set &filter)
+{
+	return visit_directory(h, [&out](const dirent_view &v) { out.push_back(v.name, v.d_ino, v.st_type); return true; }, maxitems, filter);
+}
+
+void columnar_enumeration::push_back(name_view name, uint64_t st_ino, uint16_t st_type)
+{
+	_name_offset.push_back(_names.size());
+	_names.insert(_names.end(), name.data(), name.data()+name.size());
+	_names.push_back(0);
+	_st_ino.push_back(st_ino);
+	_st_type.push_back(st_type);
+	if(!_fetched.empty())
+	{
+		have_metadata_flags none; none.value=0;
+		_fetched.push_back(none);
+		_st_size.push_back(0);
+		_st_mtim.push_back(timespec());
+	}
+}
+
+void columnar_enumeration::fetch_metadata(const enumeration_handle &dir, have_metadata_flags wanted, bool nosync)
+{
+	have_metadata_flags tofetch; tofetch.value=0;
+	tofetch.have_size=wanted.have_size;
+	tofetch.have_mtim=wanted.have_mtim;
+	if(!tofetch.value)
+		return;
+	have_metadata_flags none; none.value=0;
+	_fetched.resize(size(), none);
+	_st_size.resize(size(), 0);
+	_st_mtim.resize(size(), timespec());
+	// Go through the batch fetch a chunk at a time so it can use io_uring
+	static BOOST_CONSTEXPR_OR_CONST size_t chunk=4096;
+	std::vector<directory_entry> entries;
+	for(size_t base=0; base<size(); base+=chunk)
+	{
+		size_t count=std::min(chunk, size()-base);
+		entries.resize(count);
+		for(size_t n=0; n<count; n++)
+		{
+			name_view leafname=name(base+n);
+			entries[n].leafname=std::filesystem::path::string_type(leafname.data(), leafname.size());
+			entries[n].have_metadata=metadata_ready(base+n);
+			entries[n].have_metadata.value&=~tofetch.value;
+			entries[n]._ino=_st_ino[base+n];
+			entries[n]._type=_st_type[base+n];
+		}
+		FastDirectoryEnumerator::fetch_metadata(dir, entries.data(), entries.data()+count, tofetch, nosync);
+		for(size_t n=0; n<count; n++)
+		{
+			const directory_entry &e=entries[n];
+			have_metadata_flags &fetched=_fetched[base+n];
+			if(e.have_metadata.have_size)
+			{
+				_st_size[base+n]=e._stat->st_size;
+				fetched.have_size=1;
+			}
+			if(e.have_metadata.have_mtim)
+			{
+				_st_mtim[base+n]=e._stat->st_mtim;
+				fetched.have_mtim=1;
+			}
+		}
+	}
+}
+
+namespace
+{
+	// The predicate kernels either count matching rows or append their indices to a selection vector. The
+	// SIMD kernels hand over a mask with one bit set per matching row, lanebits bits apart.
+	struct row_counter
+	{
+		size_t count;
+		row_counter() : count(0) { }
+		void add(size_t) { ++count; }
+#if defined(__SSE2__) || defined(FASTDIRECTORYENUMERATOR_HAVE_AVX2_DISPATCH)
+		void add_mask(size_t, unsigned mask, unsigned) { count+=__builtin_popcount(mask); }
+#endif
+	};
+	struct row_selector
+	{
+		std::vector<uint32_t> &selection;
+		explicit row_selector(std::vector<uint32_t> &_selection) : selection(_selection) { }
+		void add(size_t idx) { selection.push_back((uint32_t) idx); }
+#if defined(__SSE2__) || defined(FASTDIRECTORYENUMERATOR_HAVE_AVX2_DISPATCH)
+		void add_mask(size_t base, unsigned mask, unsigned lanebits)
+		{
+			for(; mask; mask&=mask-1)
+				selection.push_back((uint32_t)(base+__builtin_ctz(mask)/lanebits));
+		}
+#endif
+	};
+
+	template<class Sink> void scan_eq16(const uint16_t *p, size_t n, uint16_t v, Sink &sink)
+	{
+		size_t i=0;
+#ifdef __SSE2__
+		const __m128i needle=_mm_set1_epi16((short) v);
+		for(; i+8<=n; i+=8)
+		{
+			// Keep one bit of the two movemask gives each 16 bit lane
+			unsigned mask=(unsigned) _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)(p+i)), needle))&0x5555;
+			if(mask)
+				sink.add_mask(i, mask, 2);
+		}
+#endif
+		for(; i<n; i++)
+			if(p[i]==v)
+				sink.add(i);
+	}
+
+#ifdef FASTDIRECTORYENUMERATOR_HAVE_AVX2_DISPATCH
+	// x lies within [lo, hi] if x-lo<=hi-lo unsigned, and AVX2 only compares signed so flip the sign bits
+	template<class T, class Sink> __attribute__((target("avx2"))) void scan_range64_avx2(const T *p, size_t n, T lo, T hi, Sink &sink, size_t &i)
+	{
+		const __m256i sign=_mm256_set1_epi64x((long long) 0x8000000000000000ULL);
+		const __m256i vlo=_mm256_set1_epi64x((long long) lo), width=_mm256_xor_si256(_mm256_set1_epi64x((long long)(hi-lo)), sign);
+		for(; i+4<=n; i+=4)
+		{
+			__m256i d=_mm256_xor_si256(_mm256_sub_epi64(_mm256_loadu_si256((const __m256i *)(p+i)), vlo), sign);
+			unsigned mask=~(unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(d, width)))&0xf;
+			if(mask)
+				sink.add_mask(i, mask, 1);
+		}
+	}
+	static bool have_avx2()
+	{
+		static const bool ret=__builtin_cpu_supports("avx2");
+		return ret;
+	}
+#endif
+	template<class T, class Sink> void scan_range64(const T *p, size_t n, T lo, T hi, Sink &sink)
+	{
+		static_assert(8==sizeof(T) && !std::is_signed<T>::value, "scan_range64 is for unsigned 64 bit columns");
+		size_t i=0;
+		if(lo>hi)
+			return;
+#ifdef FASTDIRECTORYENUMERATOR_HAVE_AVX2_DISPATCH
+		if(have_avx2())
+			scan_range64_avx2(p, n, lo, hi, sink, i);
+#endif
+		const T width=hi-lo;
+		for(; i<n; i++)
+			if(p[i]-lo<=width)
+				sink.add(i);
+	}
+}
+
+size_t columnar_enumeration::count_type(uint16_t st_type) const BOOST_NOEXCEPT_OR_NOTHROW
+{
+	row_counter sink;
+	scan_eq16(_st_type.data(), _st_type.size(), st_type, sink);
+	return sink.count;
+}
+
+void columnar_enumeration::select_type(uint16_t st_type, std::vector<uint32_t> &selection) const
+{
+	row_selector sink(selection);
+	scan_eq16(_st_type.data(), _st_type.size(), st_type, sink);
+}
+
+size_t columnar_enumeration::count_ino_range(uint64_t lo, uint64_t hi) const BOOST_NOEXCEPT_OR_NOTHROW
+{
+	row_counter sink;
+	scan_range64(_st_ino.data(), _st_ino.size(), lo, hi, sink);
+	return sink.count;
+}
+
+void columnar_enumeration::select_ino_range(uint64_t lo, uint64_t hi, std::vector<uint32_t> &selection) const
+{
+	row_selector sink(selection);
+	scan_range64(_st_ino.data(), _st_ino.size(), lo, hi, sink);
+}
+
+void columnar_enumeration::select_size_range(off_t lo, off_t hi, std::vector<uint32_t> &selection) const
+{
+	row_selector sink(selection);
+	scan_range64(_st_size.data(), _st_size.size(), lo, hi, sink);
+}
+
+bool enumerate_directory(enumeration_handle &h, columnar_enumeration &out, size_t maxitems, const glob_matcher &glob)
+{
+	return visit_directory(h, [&out](const dirent_view &v) { out.push_back(v.name, v.d_ino, v.st_type); return true; }, maxitems, glob);
+}
+
+bool enumerate_directory(enumeration_handle &h, columnar_enumeration &out, size_t maxitems, const filter_set &filter)
+{
+	return visit_directory(h, [&out](const dirent_view &v) { out.push_back(v.name, v.d_ino, v.st_type); return true; }, maxitems, filter);
+}
+
+} // namespace
@@ -1,183 +1,968 @@
-/* FastDirectoryEnumerator
-Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
-(C) 2013 Niall Douglas http://www.nedprod.com/
-File created: Aug 2013
-*/
-
-#ifndef FASTDIRECTORYENUMERATOR_H
-#define FASTDIRECTORYENUMERATOR_H
-
-#ifndef FASTDIRECTORYENUMERATOR_API
-#define FASTDIRECTORYENUMERATOR_API
-#endif
-
-#include "std_filesystem.hpp"
-#include <sys/types.h>
-#ifdef WIN32
-#ifndef S_IFLNK
-#define S_IFLNK 0x1400
-#endif
-#endif
-
-namespace FastDirectoryEnumerator
-{
-	struct timespec
-	{
-		time_t tv_sec;
-		long tv_nsec;
-	};
-	typedef unsigned long long off_t;
-
-	/*! \brief Bitflags for availability of metadata
-
-	These replicate the `stat` structure. `st_birthtime` is a BSD extension, but
-	also is available on Windows.
-	*/
-	union have_metadata_flags
-	{
-		struct
-		{
-			unsigned int have_dev:1, have_ino:1, have_type:1, have_mode:1, have_nlink:1, have_uid:1, have_gid:1,
-				have_rdev:1, have_atim:1, have_mtim:1, have_ctim:1, have_size:1,
-				have_allocated:1, have_blocks:1, have_blksize:1, have_flags:1, have_gen:1, have_birthtim:1;
-		};
-		unsigned int value;
-	};
-	//! An entry in a directory
-	class FASTDIRECTORYENUMERATOR_API directory_entry
-	{
-		friend std::unique_ptr<std::vector<directory_entry>> enumerate_directory(void *h, size_t maxitems, std::filesystem::path glob=std::filesystem::path(), bool namesonly=false);
-
-		std::filesystem::path leafname;
-		have_metadata_flags have_metadata;
-		struct stat_t // Derived from BSD
-		{
-			uint64_t        st_dev;           /* inode of device containing file */
-			uint64_t        st_ino;           /* inode of file */
-			uint16_t        st_type;          /* type of file */
-			uint16_t        st_mode;          /* type and perms of file */
-			int16_t         st_nlink;         /* number of hard links */
-			int16_t         st_uid;           /* user ID of the file */
-			int16_t         st_gid;           /* group ID of the file */
-			dev_t           st_rdev;          /* id of file if special */
-			struct timespec st_atim;          /* time of last access */
-			struct timespec st_mtim;          /* time of last data modification */
-			struct timespec st_ctim;          /* time of last status change */
-			off_t           st_size;          /* file size, in bytes */
-			off_t           st_allocated;     /* bytes allocated for file */
-			off_t           st_blocks;        /* number of blocks allocated */
-			uint16_t        st_blksize;       /* block size used by this device */
-			uint32_t        st_flags;         /* user defined flags for file */
-			uint32_t        st_gen;           /* file generation number */
-			int32_t         st_lspare;
-			struct timespec st_birthtim;      /* time of file creation (birth) */
-		} stat;
-		void _int_fetch(have_metadata_flags wanted, std::filesystem::path prefix=std::filesystem::path());
-	public:
-		//! Constructs an instance
-		directory_entry()
-		{
-			have_metadata.value=0;
-			memset(&stat, 0, sizeof(stat));
-		}
-		bool operator==(const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname == rhs.leafname; }
-		bool operator!=(const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname != rhs.leafname; }
-		bool operator< (const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname < rhs.leafname; }
-		bool operator<=(const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname <= rhs.leafname; }
-		bool operator> (const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname > rhs.leafname; }
-		bool operator>=(const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname >= rhs.leafname; }
-		//! The name of the directory entry
-		std::filesystem::path name() const BOOST_NOEXCEPT_OR_NOTHROW { return leafname; }
-		//! A bitfield of what metadata is ready right now
-		have_metadata_flags metadata_ready() const BOOST_NOEXCEPT_OR_NOTHROW { return have_metadata; }
-		//! Fetches the specified metadata, returning that newly available. This is a blocking call.
-		have_metadata_flags fetch_metadata(std::filesystem::path prefix, have_metadata_flags wanted)
-		{
-			have_metadata_flags tofetch;
-			wanted.value&=metadata_supported().value;
-			tofetch.value=wanted.value&~have_metadata.value;
-			if(tofetch.value) _int_fetch(tofetch, prefix);
-			return have_metadata;
-		}
-		//! Returns st_dev
-		uint64_t st_dev() { if(!have_metadata.have_dev) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_dev=1; _int_fetch(tofetch); } return stat.st_dev; }
-		//! Returns st_ino
-		uint64_t st_ino() { if(!have_metadata.have_ino) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_ino=1; _int_fetch(tofetch); } return stat.st_ino; }
-		//! Returns st_type
-		uint16_t st_type() { if(!have_metadata.have_type) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_type=1; _int_fetch(tofetch); } return stat.st_type; }
-		//! Returns st_mode
-		uint16_t st_mode() { if(!have_metadata.have_mode) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_mode=1; _int_fetch(tofetch); } return stat.st_mode; }
-		//! Returns st_nlink
-		int16_t st_nlink() { if(!have_metadata.have_nlink) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_nlink=1; _int_fetch(tofetch); } return stat.st_nlink; }
-		//! Returns st_uid
-		int16_t st_uid() { if(!have_metadata.have_uid) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_uid=1; _int_fetch(tofetch); } return stat.st_uid; }
-		//! Returns st_gid
-		int16_t st_gid() { if(!have_metadata.have_gid) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_gid=1; _int_fetch(tofetch); } return stat.st_gid; }
-		//! Returns st_rdev
-		dev_t st_rdev() { if(!have_metadata.have_rdev) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_rdev=1; _int_fetch(tofetch); } return stat.st_rdev; }
-		//! Returns st_atim
-		struct timespec st_atim() { if(!have_metadata.have_atim) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_atim=1; _int_fetch(tofetch); } return stat.st_atim; }
-		//! Returns st_mtim
-		struct timespec st_mtim() { if(!have_metadata.have_mtim) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_mtim=1; _int_fetch(tofetch); } return stat.st_mtim; }
-		//! Returns st_ctim
-		struct timespec st_ctim() { if(!have_metadata.have_ctim) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_ctim=1; _int_fetch(tofetch); } return stat.st_ctim; }
-		//! Returns st_size
-		off_t st_size() { if(!have_metadata.have_size) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_size=1; _int_fetch(tofetch); } return stat.st_size; }
-		//! Returns st_allocated
-		off_t st_allocated() { if(!have_metadata.have_allocated) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_allocated=1; _int_fetch(tofetch); } return stat.st_allocated; }
-		//! Returns st_blocks
-		off_t st_blocks() { if(!have_metadata.have_blocks) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_blocks=1; _int_fetch(tofetch); } return stat.st_blocks; }
-		//! Returns st_blksize
-		uint16_t st_blksize() { if(!have_metadata.have_blksize) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_blksize=1; _int_fetch(tofetch); } return stat.st_blksize; }
-		//! Returns st_flags
-		uint32_t st_flags() { if(!have_metadata.have_flags) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_flags=1; _int_fetch(tofetch); } return stat.st_flags; }
-		//! Returns st_gen
-		uint32_t st_gen() { if(!have_metadata.have_gen) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_gen=1; _int_fetch(tofetch); } return stat.st_gen; }
-		//! Returns st_birthtim
-		struct timespec st_birthtim() { if(!have_metadata.have_birthtim) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_birthtim=1; _int_fetch(tofetch); } return stat.st_birthtim; }
-
-		//! A bitfield of what metadata is available on this platform. This doesn't mean all is available for every filing system.
-		static have_metadata_flags metadata_supported() BOOST_NOEXCEPT_OR_NOTHROW;
-	};
-
-	//! Starts the enumeration of a directory. This actually simply opens the directory and returns the fd or `HANDLE`.
-	extern FASTDIRECTORYENUMERATOR_API void *begin_enumerate_directory(std::filesystem::path path);
-	//! Ends the enumeration of a directory. This simply closes the fd or `HANDLE`.
-	extern FASTDIRECTORYENUMERATOR_API void end_enumerate_directory(void *h);
-	/*! \brief Enumerates a directory as quickly as possible, retrieving all zero-cost metadata.
-
-	Note that maxitems items may not be retreived for various reasons, including that glob filtered them out.
-	A zero item vector return is entirely possible, but this does not mean end of enumeration: only a null
-	shared_ptr means that.
-
-	Windows returns the common stat items, Linux and FreeBSD returns `st_ino` and usually `st_rdev`, other POSIX just `st_ino`.
-	Setting namesonly to true returns as little information as possible.
-
-	Suggested code for merging chunks of enumeration into a single vector:
-	\code
-	void *h=begin_enumerate_directory(_L("testdir"));
-	std::unique_ptr<std::vector<directory_entry>> enumeration, chunk;
-	while((chunk=enumerate_directory(h, NUMBER_OF_FILES)))
-		if(!enumeration)
-			enumeration=std::move(chunk);
-		else
-			enumeration->insert(enumeration->end(), std::make_move_iterator(chunk->begin()), std::make_move_iterator(chunk->end()));
-	end_enumerate_directory(h);
-	\endcode
-	*/
-	extern FASTDIRECTORYENUMERATOR_API std::unique_ptr<std::vector<directory_entry>> enumerate_directory(void *h, size_t maxitems, std::filesystem::path glob, bool namesonly);
-} // namespace
-
-namespace std
-{
-	template<> struct hash<FastDirectoryEnumerator::directory_entry>
-	{
-	public:
-		size_t operator()(const FastDirectoryEnumerator::directory_entry& p) const
-		{
-			return boost::filesystem::hash_value(p.name());
-		}
-	};
-}
-
-#endif
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Aug 2013
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_H
+#define FASTDIRECTORYENUMERATOR_H
+
+#ifndef FASTDIRECTORYENUMERATOR_API
+#define FASTDIRECTORYENUMERATOR_API
+#endif
+
+#include "std_filesystem.hpp"
+#include "boost/config.hpp"
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <string_view>
+#define FASTDIRECTORYENUMERATOR_HAVE_STRING_VIEW
+#else
+#include "boost/utility/string_ref.hpp"
+#endif
+#include <sys/types.h>
+#ifdef WIN32
+#ifndef S_IFLNK
+#define S_IFLNK 0x1400
+#endif
+#endif
+
+namespace FastDirectoryEnumerator
+{
+	struct timespec
+	{
+		time_t tv_sec;
+		long tv_nsec;
+	};
+	typedef unsigned long long off_t;
+
+	/*! \brief Bitflags for availability of metadata
+
+	These replicate the `stat` structure. `st_birthtime` is a BSD extension, but
+	also is available on Windows.
+	*/
+	union have_metadata_flags
+	{
+		struct
+		{
+			unsigned int have_dev:1, have_ino:1, have_type:1, have_mode:1, have_nlink:1, have_uid:1, have_gid:1,
+				have_rdev:1, have_atim:1, have_mtim:1, have_ctim:1, have_size:1,
+				have_allocated:1, have_blocks:1, have_blksize:1, have_flags:1, have_gen:1, have_birthtim:1;
+		};
+		unsigned int value;
+	};
+	//! A non-owning view of a leafname
+#ifdef FASTDIRECTORYENUMERATOR_HAVE_STRING_VIEW
+	typedef std::basic_string_view<std::filesystem::path::value_type> name_view;
+#else
+	typedef boost::basic_string_ref<std::filesystem::path::value_type> name_view;
+#endif
+
+	/*! \brief A glob pattern compiled once for matching against many leafnames.
+
+	The common shapes of pattern `*.ext`, `prefix*`, `prefix*suffix`, `*substr*` and a literal name are
+	matched by comparing the literal parts directly, substrings being searched for sixteen bytes at a time
+	using SSE2 where available. Anything else falls back to `fnmatch()` with its full semantics on POSIX,
+	or to `*` and `?` wildcard matching on Windows. Construct one once and pass it to every chunk of an
+	enumeration, or to the enumerations of many directories.
+	*/
+	class FASTDIRECTORYENUMERATOR_API glob_matcher
+	{
+	public:
+		//! How a pattern gets matched
+		enum class shape_t
+		{
+			everything,     //!< Empty pattern or `*`
+			literal,        //!< No wildcards at all
+			prefix,         //!< `prefix*`
+			suffix,         //!< `*suffix`
+			prefix_suffix,  //!< `prefix*suffix`
+			substring,      //!< `*substr*`
+			general         //!< Anything else
+		};
+	private:
+		friend class filter_set;
+		typedef std::filesystem::path::string_type string_type;
+		typedef std::char_traits<std::filesystem::path::value_type> traits_type;
+		std::filesystem::path _pattern;
+		shape_t _shape;
+		string_type _a, _b;  // the literal parts, _b being the suffix of prefix_suffix
+		bool _int_match_substring(name_view name) const;
+		bool _int_match_general(name_view name) const;
+	public:
+		//! Constructs a matcher which matches everything
+		glob_matcher() : _shape(shape_t::everything) { }
+		//! Compiles pattern
+		explicit glob_matcher(std::filesystem::path pattern);
+		//! The pattern compiled
+		const std::filesystem::path &pattern() const BOOST_NOEXCEPT_OR_NOTHROW { return _pattern; }
+		//! How the pattern gets matched
+		shape_t shape() const BOOST_NOEXCEPT_OR_NOTHROW { return _shape; }
+		//! True if every leafname matches
+		bool matches_everything() const BOOST_NOEXCEPT_OR_NOTHROW { return shape_t::everything==_shape; }
+		//! True if leafname matches the pattern
+		bool operator()(name_view name) const
+		{
+			switch(_shape)
+			{
+			case shape_t::everything:
+				return true;
+			case shape_t::literal:
+				return name.size()==_a.size() && !traits_type::compare(name.data(), _a.data(), _a.size());
+			case shape_t::prefix:
+				return name.size()>=_a.size() && !traits_type::compare(name.data(), _a.data(), _a.size());
+			case shape_t::suffix:
+				return name.size()>=_a.size() && !traits_type::compare(name.data()+name.size()-_a.size(), _a.data(), _a.size());
+			case shape_t::prefix_suffix:
+				return name.size()>=_a.size()+_b.size() && !traits_type::compare(name.data(), _a.data(), _a.size())
+					&& !traits_type::compare(name.data()+name.size()-_b.size(), _b.data(), _b.size());
+			case shape_t::substring:
+				return _int_match_substring(name);
+			default:
+				return _int_match_general(name);
+			}
+		}
+	};
+
+	/*! \brief Many include and exclude glob patterns checked against a leafname in a single pass.
+
+	A leafname passes if it matches any of the include patterns, or there are none, and none of the exclude
+	patterns. The literal part of every pattern of a shape `glob_matcher` matches directly is compiled into
+	one Aho-Corasick automaton, as is the longest run of literal characters of patterns which need the full
+	glob semantics. One walk along the leafname then finds every pattern which could match however many there
+	are, with only the hits checked further. Patterns without any literal characters are tried one by one.
+	*/
+	class FASTDIRECTORYENUMERATOR_API filter_set
+	{
+		struct pattern_t
+		{
+			glob_matcher glob;
+			std::filesystem::path::string_type key;  // literal part which must appear in any match, found by the automaton
+			bool exclude;
+		};
+		std::vector<pattern_t> _patterns;
+		std::vector<uint32_t> _general;      // patterns without a key
+		bool _have_includes, _have_excludes;
+		unsigned char _classes[256];         // character to automaton input class, zero being none of the patterns use it
+		std::vector<std::pair<std::filesystem::path::value_type, uint32_t>> _wide_classes;  // sorted, for characters beyond 255
+		uint32_t _alphabet;
+		std::vector<uint32_t> _next;         // state*_alphabet+class to next state, failure transitions folded in
+		std::vector<uint32_t> _out_begin;    // patterns whose literal part ends at state lie in _outs from here to the next state's
+		std::vector<uint32_t> _outs;
+		// Whether c has a slot in _classes, which every narrow character has without comparing it (-Wtype-limits)
+		static bool _int_byte(unsigned char) BOOST_NOEXCEPT_OR_NOTHROW { return true; }
+		template<class T> static bool _int_byte(T c) BOOST_NOEXCEPT_OR_NOTHROW { return c<256; }
+		uint32_t _int_class(std::filesystem::path::value_type c) const
+		{
+			typedef std::make_unsigned<std::filesystem::path::value_type>::type uchar;
+			if(_int_byte((uchar) c))
+				return _classes[(uchar) c];
+			auto it=std::lower_bound(_wide_classes.begin(), _wide_classes.end(), std::make_pair(c, (uint32_t) 0));
+			return (it!=_wide_classes.end() && it->first==c) ? it->second : 0;
+		}
+		bool _int_hit(const pattern_t &p, name_view name, size_t end) const;
+	public:
+		//! Constructs a filter set which passes everything
+		filter_set();
+		//! Compiles the include and exclude patterns
+		explicit filter_set(const std::vector<std::filesystem::path> &includes, const std::vector<std::filesystem::path> &excludes=std::vector<std::filesystem::path>());
+		//! The number of patterns
+		size_t size() const BOOST_NOEXCEPT_OR_NOTHROW { return _patterns.size(); }
+		//! True if there are no patterns
+		bool empty() const BOOST_NOEXCEPT_OR_NOTHROW { return _patterns.empty(); }
+		//! The number of states in the automaton
+		size_t states() const BOOST_NOEXCEPT_OR_NOTHROW { return _out_begin.empty() ? 0 : _out_begin.size()-1; }
+		//! True if leafname passes the filter
+		bool operator()(name_view name) const;
+	};
+
+	/*! \brief Counts of the work done enumerating directories and fetching metadata.
+
+	Only kept if the library was built with `FASTDIRECTORYENUMERATOR_STATS` defined, else they stay zero and
+	counting costs nothing. `enumeration_handle::stats()` has those of the enumeration done through one handle,
+	and `process_stats()` everything done by the whole process, which is the only place lookups are counted as
+	many threads may look up relative to one handle at once. Timing every lookup would cost more than the 2% of
+	a warm `statx()` counting is allowed, so one in every `lookup_sample_rate` lookups a thread makes is timed
+	and `syscall_ns` counts it that many times over.
+
+	Built with `FASTDIRECTORYENUMERATOR_STATS` and where `<sys/sdt.h>` exists, the same points are also USDT
+	probes of provider `fastdirectoryenumerator` for perf and bpftrace to attach to:
+	- `getdents(fd, bytes, ns)` after each enumeration syscall
+	- `parse(parsed, delivered, ns)` after each chunk is parsed
+	- `alloc(bytes, ns)` after a kernel buffer is allocated or a vector enumerated into grows
+	- `lookup__start(kind)` and `lookup__done(kind, result)` around each lookup, kind being the order of the
+	lookup counters below starting from zero
+	*/
+	struct enumeration_stats
+	{
+		uint64_t kernel_calls;       //!< getdents64() or NtQueryDirectoryFile() calls enumerating
+		uint64_t kernel_bytes;       //!< Bytes of records those calls returned
+		uint64_t entries_parsed;     //!< Records parsed out of the kernel buffer
+		uint64_t entries_skipped;    //!< Records passed over for being '.', '..', deleted or before a position sought to
+		uint64_t entries_filtered;   //!< Records failing the glob or filter
+		uint64_t allocations;        //!< Kernel buffers, growths of a vector enumerated into, leafnames too long to store inline, and stat blocks
+		uint64_t statx_calls;        //!< statx() lookups
+		uint64_t fstatat_calls;      //!< fstatat() lookups, where statx() is unavailable
+		uint64_t nt_query_calls;     //!< Windows lookups made by enumerating the containing directory for the leafname
+		uint64_t nt_open_calls;      //!< Windows lookups made by opening the file
+		uint64_t io_uring_statx;     //!< statx() lookups submitted to io_uring
+		uint64_t syscall_ns;         //!< Nanoseconds in enumeration syscalls and sampled lookups
+		uint64_t parse_ns;           //!< Nanoseconds parsing kernel buffers, including making the entries
+		uint64_t alloc_ns;           //!< Nanoseconds allocating kernel buffers and growing vectors enumerated into
+		//! One in this many lookups is timed
+		static BOOST_CONSTEXPR_OR_CONST unsigned lookup_sample_rate=16;
+		enumeration_stats() { memset(this, 0, sizeof(*this)); }
+	};
+	//! True if the library was built with `FASTDIRECTORYENUMERATOR_STATS` defined and so keeps `enumeration_stats`
+	extern FASTDIRECTORYENUMERATOR_API bool stats_enabled() BOOST_NOEXCEPT_OR_NOTHROW;
+	//! The counts of every thread of the process so far. Take the difference of two to measure something in between.
+	extern FASTDIRECTORYENUMERATOR_API enumeration_stats process_stats();
+
+	class directory_entry;
+	class enumeration_handle;
+	struct dirent_view;
+	namespace detail { typedef bool (*dirent_visitor_t)(void *, const dirent_view &); }
+	extern FASTDIRECTORYENUMERATOR_API bool visit_directory(enumeration_handle &h, detail::dirent_visitor_t visitor, void *ctx, size_t maxitems, const glob_matcher &glob);
+	extern FASTDIRECTORYENUMERATOR_API bool visit_directory(enumeration_handle &h, detail::dirent_visitor_t visitor, void *ctx, size_t maxitems, const filter_set &filter);
+	//! The order the batch `fetch_metadata()` looks entries up in
+	enum class fetch_order
+	{
+		as_given,  //!< The order of the entries, which straight after enumeration is the order the kernel returned them in
+		by_inode   //!< Ascending `st_ino`, entries lacking it last
+	};
+	/*! \brief Fetches the specified metadata for every entry in [begin, end) relative to the open directory dir. This is a blocking call.
+
+	On Linux 5.6 or later this submits `IORING_OP_STATX` requests through io_uring in large batches, filling in
+	each entry as its completion arrives. Elsewhere it is a loop of `directory_entry::fetch_metadata()`.
+
+	Filing systems like ext4 return entries in the order of a hash of their leafnames, so looking them up in
+	that order jumps at random through the inode tables, which on a cold cache costs a seek per entry. With
+	`fetch_order::by_inode` the lookups are issued in order of the `st_ino` enumeration already filled in, so
+	the inode tables are read in sequence. Either way the entries stay where they are.
+	*/
+	extern FASTDIRECTORYENUMERATOR_API void fetch_metadata(const enumeration_handle &dir, directory_entry *begin, directory_entry *end, have_metadata_flags wanted, bool nosync=false, fetch_order order=fetch_order::as_given);
+	//! True if the batch `fetch_metadata()` uses io_uring on this kernel
+	extern FASTDIRECTORYENUMERATOR_API bool fetch_metadata_uses_io_uring();
+	namespace detail
+	{
+		class statx_reactor;
+		typedef void (*fetch_done_t)(void *);
+		/* Queues lookups of every entry in [begin, end) relative to dir on a process wide thread reaping io_uring
+		completions, which calls done(ctx) once they are all complete. Entries not yet submitted once *cancelled
+		is true are skipped. Returns false having queued nothing if io_uring can't statx() on this kernel. */
+		extern FASTDIRECTORYENUMERATOR_API bool fetch_metadata_reactor(const enumeration_handle &dir, directory_entry *begin, directory_entry *end, have_metadata_flags wanted, bool nosync,
+			const std::atomic<bool> *cancelled, fetch_done_t done, void *ctx);
+	}
+	/*! \brief Fetches the specified metadata for every entry in [begin, end) relative to the open directory dir using threads threads. This is a blocking call.
+
+	Lookups of different leafnames in the same directory proceed in parallel in the kernel, so this splits the
+	range into chunks shared out between threads worker threads, zero meaning one per hardware thread. Each
+	worker opens its own fd for the directory so they don't contend on the same open file. With
+	`fetch_order::by_inode` each chunk is a run of neighbouring inodes.
+	*/
+	extern FASTDIRECTORYENUMERATOR_API void parallel_fetch_metadata(const enumeration_handle &dir, directory_entry *begin, directory_entry *end, have_metadata_flags wanted, size_t threads=0, bool nosync=false, fetch_order order=fetch_order::as_given);
+	/*! \brief Enumerates the next chunk of up to maxitems entries matching glob into out, reusing its capacity.
+
+	Returns false when the enumeration has ended, in which case out is empty. Reusing the same vector
+	for every chunk means a chunked enumeration makes no allocations once out has grown to size.
+
+	If maxitems is `enumeration_handle::adaptive_chunk`, the chunk is whatever the next kernel call returns,
+	so there is no guessing how many entries to ask for. With a handle opened with
+	`enumeration_handle::adaptive_buffer_size`, chunks start at a page's worth and grow as they keep coming
+	back full:
+	\code
+	auto h=begin_enumerate_directory(_L("spool"), enumeration_handle::adaptive_buffer_size);
+	std::vector<directory_entry> chunk;
+	while(enumerate_directory(*h, chunk, enumeration_handle::adaptive_chunk))
+		process(chunk);
+	\endcode
+	*/
+	extern FASTDIRECTORYENUMERATOR_API bool enumerate_directory(enumeration_handle &h, std::vector<directory_entry> &out, size_t maxitems, const glob_matcher &glob, bool namesonly=false);
+	//! \overload Entries failing filter are skipped before any `directory_entry` is made for them.
+	extern FASTDIRECTORYENUMERATOR_API bool enumerate_directory(enumeration_handle &h, std::vector<directory_entry> &out, size_t maxitems, const filter_set &filter, bool namesonly=false);
+	//! \overload
+	inline bool enumerate_directory(enumeration_handle &h, std::vector<directory_entry> &out, size_t maxitems, std::filesystem::path glob=std::filesystem::path(), bool namesonly=false)
+	{
+		return enumerate_directory(h, out, maxitems, glob_matcher(std::move(glob)), namesonly);
+	}
+
+	namespace detail
+	{
+		// The absolute path and inode of an enumerated directory, shared by every entry enumerated from it
+		class directory_ref
+		{
+			std::atomic<size_t> _refs;
+			std::filesystem::path _path;
+			uint64_t _dev, _ino;
+			directory_ref(std::filesystem::path path, uint64_t dev, uint64_t ino) : _refs(1), _path(std::move(path)), _dev(dev), _ino(ino) { }
+			friend class FastDirectoryEnumerator::enumeration_handle;
+		public:
+			static directory_ref *acquire(directory_ref *d) BOOST_NOEXCEPT_OR_NOTHROW { if(d) d->_refs.fetch_add(1, std::memory_order_relaxed); return d; }
+			static void release(directory_ref *d) BOOST_NOEXCEPT_OR_NOTHROW { if(d && 1==d->_refs.fetch_sub(1, std::memory_order_acq_rel)) delete d; }
+			const std::filesystem::path &path() const BOOST_NOEXCEPT_OR_NOTHROW { return _path; }
+			//! The st_dev of the directory when enumerated, zero if unknown
+			uint64_t dev() const BOOST_NOEXCEPT_OR_NOTHROW { return _dev; }
+			//! The st_ino of the directory when enumerated, zero if unknown
+			uint64_t ino() const BOOST_NOEXCEPT_OR_NOTHROW { return _ino; }
+		};
+	}
+
+	/*! \brief Closes the directory fds this thread keeps open for looking up enumerated entries.
+
+	On Linux, looking up an enumerated entry in the directory it came from, through an `st_*()` accessor or
+	`directory_entry::fetch_metadata()` with an empty prefix, opens the directory and keeps its fd in a small
+	per-thread cache keyed by the directory's `st_dev` and `st_ino`, so that further lookups in it are relative
+	to the fd and the kernel walks only the leafname rather than every component of the path again. Each thread
+	keeps at most 32, and all together no more than a quarter of `RLIMIT_NOFILE`. Call this to close them, say
+	before unmounting the filing system they are on. Elsewhere this does nothing.
+	*/
+	extern FASTDIRECTORYENUMERATOR_API void close_cached_directories();
+
+	//! An entry in a directory
+	class FASTDIRECTORYENUMERATOR_API directory_entry
+	{
+		friend bool enumerate_directory(enumeration_handle &h, std::vector<directory_entry> &out, size_t maxitems, const glob_matcher &glob, bool namesonly);
+		friend bool enumerate_directory(enumeration_handle &h, std::vector<directory_entry> &out, size_t maxitems, const filter_set &filter, bool namesonly);
+		friend class packed_enumeration;
+		friend class columnar_enumeration;
+		friend class directory_snapshot;
+		friend class watched_directory;
+		friend void fetch_metadata(const enumeration_handle &dir, directory_entry *begin, directory_entry *end, have_metadata_flags wanted, bool nosync, fetch_order order);
+		friend size_t parallel_enumerate_directory(const std::filesystem::path &path, std::vector<directory_entry> &out, size_t threads);
+		friend class detail::statx_reactor;
+
+	public:
+		//! The metadata of an entry. Only the fields flagged by `metadata_ready()` are valid.
+		struct stat_t // Derived from BSD
+		{
+			uint64_t        st_dev;           /* inode of device containing file */
+			uint64_t        st_ino;           /* inode of file */
+			uint16_t        st_type;          /* type of file */
+			uint16_t        st_mode;          /* type and perms of file */
+			int16_t         st_nlink;         /* number of hard links */
+			int16_t         st_uid;           /* user ID of the file */
+			int16_t         st_gid;           /* group ID of the file */
+			dev_t           st_rdev;          /* id of file if special */
+			struct timespec st_atim;          /* time of last access */
+			struct timespec st_mtim;          /* time of last data modification */
+			struct timespec st_ctim;          /* time of last status change */
+			off_t           st_size;          /* file size, in bytes */
+			off_t           st_allocated;     /* bytes allocated for file */
+			off_t           st_blocks;        /* number of blocks allocated */
+			uint16_t        st_blksize;       /* block size used by this device */
+			uint32_t        st_flags;         /* user defined flags for file */
+			uint32_t        st_gen;           /* file generation number */
+			int32_t         st_lspare;
+			struct timespec st_birthtim;      /* time of file creation (birth) */
+		};
+	private:
+		// Enumeration fills in only the name, inode and type, so the rest of the metadata lives in a block of
+		// its own allocated when first fetched, keeping entries small and cheap to move around
+		std::filesystem::path leafname;
+		uint64_t _ino;
+		std::unique_ptr<stat_t> _stat;    // all but st_ino and st_type, null until metadata other than those is fetched
+		detail::directory_ref *_dir;      // the directory enumerated from, null if not enumerated
+		have_metadata_flags have_metadata;
+		uint16_t _type;
+		void _int_set_dir(detail::directory_ref *d) BOOST_NOEXCEPT_OR_NOTHROW { if(d!=_dir) { detail::directory_ref::release(_dir); _dir=detail::directory_ref::acquire(d); } }
+		stat_t &_int_stat() { if(!_stat) _int_alloc_stat(); return *_stat; }
+		void _int_alloc_stat();
+		// The stat block if wanted includes metadata kept in it, else null
+		stat_t *_int_stat(have_metadata_flags wanted) { wanted.have_ino=wanted.have_type=0; return wanted.value ? &_int_stat() : nullptr; }
+		// All the metadata as one stat_t, as packed_enumeration stores it
+		stat_t _int_stat_copy() const
+		{
+			stat_t ret;
+			if(_stat)
+				ret=*_stat;
+			else
+				memset(&ret, 0, sizeof(ret));
+			ret.st_ino=_ino;
+			ret.st_type=_type;
+			return ret;
+		}
+		void _int_fetch(have_metadata_flags wanted, std::filesystem::path prefix=std::filesystem::path(), void *dirh=nullptr, bool nosync=false);
+		void _int_fill_from_statx(have_metadata_flags wanted, const void *statxbuf);
+		void _int_fill_from_dirent(const dirent_view &v, const void *raw);
+	public:
+		//! Constructs an instance
+		directory_entry() : _ino(0), _dir(nullptr), _type(0)
+		{
+			have_metadata.value=0;
+		}
+		//! Copy constructor
+		directory_entry(const directory_entry &o) : leafname(o.leafname), _ino(o._ino), _stat(o._stat ? new stat_t(*o._stat) : nullptr), _dir(detail::directory_ref::acquire(o._dir)), have_metadata(o.have_metadata), _type(o._type) { }
+		//! Move constructor
+		directory_entry(directory_entry &&o) BOOST_NOEXCEPT_OR_NOTHROW : leafname(std::move(o.leafname)), _ino(o._ino), _stat(std::move(o._stat)), _dir(o._dir), have_metadata(o.have_metadata), _type(o._type) { o._dir=nullptr; }
+		~directory_entry() { detail::directory_ref::release(_dir); }
+		//! Copy assignment
+		directory_entry &operator=(const directory_entry &o)
+		{
+			if(this!=&o)
+			{
+				leafname=o.leafname;
+				_ino=o._ino;
+				if(!o._stat)
+					_stat.reset();
+				else if(_stat)
+					*_stat=*o._stat;
+				else
+					_stat.reset(new stat_t(*o._stat));
+				_int_set_dir(o._dir);
+				have_metadata=o.have_metadata;
+				_type=o._type;
+			}
+			return *this;
+		}
+		//! Move assignment
+		directory_entry &operator=(directory_entry &&o) BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			leafname=std::move(o.leafname);
+			_ino=o._ino;
+			_stat=std::move(o._stat);
+			std::swap(_dir, o._dir);
+			have_metadata=o.have_metadata;
+			_type=o._type;
+			return *this;
+		}
+		bool operator==(const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname == rhs.leafname; }
+		bool operator!=(const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname != rhs.leafname; }
+		bool operator< (const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname < rhs.leafname; }
+		bool operator<=(const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname <= rhs.leafname; }
+		bool operator> (const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname > rhs.leafname; }
+		bool operator>=(const directory_entry& rhs) const BOOST_NOEXCEPT_OR_NOTHROW { return leafname >= rhs.leafname; }
+		//! The name of the directory entry
+		std::filesystem::path name() const BOOST_NOEXCEPT_OR_NOTHROW { return leafname; }
+		/*! \brief The absolute path of the directory the entry was enumerated from, else empty for the current directory.
+
+		The `st_*()` accessors, and `fetch_metadata()` with an empty prefix, look the entry up in that directory.
+		If it has been moved since, they either still find the entry in it or find nothing, never an entry of
+		whatever directory has taken its path. A prefix given to `fetch_metadata()` is always walked afresh.
+		*/
+		std::filesystem::path directory() const { return _dir ? _dir->path() : std::filesystem::path(); }
+		//! A bitfield of what metadata is ready right now
+		have_metadata_flags metadata_ready() const BOOST_NOEXCEPT_OR_NOTHROW { return have_metadata; }
+		/*! \brief Fetches the specified metadata, returning that newly available. This is a blocking call.
+
+		On Linux only the metadata wanted is asked of the kernel. Setting nosync lets network and FUSE filing
+		systems answer from what they have cached rather than revalidating with the server.
+		*/
+		have_metadata_flags fetch_metadata(std::filesystem::path prefix, have_metadata_flags wanted, bool nosync=false)
+		{
+			have_metadata_flags tofetch;
+			wanted.value&=metadata_supported().value;
+			tofetch.value=wanted.value&~have_metadata.value;
+			if(tofetch.value) _int_fetch(tofetch, prefix, nullptr, nosync);
+			return have_metadata;
+		}
+		//! Fetches the specified metadata relative to the open directory dir, saving the kernel a path walk. This is a blocking call.
+		have_metadata_flags fetch_metadata(const enumeration_handle &dir, have_metadata_flags wanted, bool nosync=false);
+		//! Returns st_dev
+		uint64_t st_dev() { if(!have_metadata.have_dev) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_dev=1; _int_fetch(tofetch); } return _stat ? _stat->st_dev : 0; }
+		//! Returns st_ino
+		uint64_t st_ino() { if(!have_metadata.have_ino) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_ino=1; _int_fetch(tofetch); } return _ino; }
+		//! Returns st_type
+		uint16_t st_type() { if(!have_metadata.have_type) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_type=1; _int_fetch(tofetch); } return _type; }
+		//! Returns st_mode
+		uint16_t st_mode() { if(!have_metadata.have_mode) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_mode=1; _int_fetch(tofetch); } return _stat ? _stat->st_mode : 0; }
+		//! Returns st_nlink
+		int16_t st_nlink() { if(!have_metadata.have_nlink) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_nlink=1; _int_fetch(tofetch); } return _stat ? _stat->st_nlink : 0; }
+		//! Returns st_uid
+		int16_t st_uid() { if(!have_metadata.have_uid) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_uid=1; _int_fetch(tofetch); } return _stat ? _stat->st_uid : 0; }
+		//! Returns st_gid
+		int16_t st_gid() { if(!have_metadata.have_gid) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_gid=1; _int_fetch(tofetch); } return _stat ? _stat->st_gid : 0; }
+		//! Returns st_rdev
+		dev_t st_rdev() { if(!have_metadata.have_rdev) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_rdev=1; _int_fetch(tofetch); } return _stat ? _stat->st_rdev : 0; }
+		//! Returns st_atim
+		struct timespec st_atim() { if(!have_metadata.have_atim) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_atim=1; _int_fetch(tofetch); } return _stat ? _stat->st_atim : timespec(); }
+		//! Returns st_mtim
+		struct timespec st_mtim() { if(!have_metadata.have_mtim) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_mtim=1; _int_fetch(tofetch); } return _stat ? _stat->st_mtim : timespec(); }
+		//! Returns st_ctim
+		struct timespec st_ctim() { if(!have_metadata.have_ctim) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_ctim=1; _int_fetch(tofetch); } return _stat ? _stat->st_ctim : timespec(); }
+		//! Returns st_size
+		off_t st_size() { if(!have_metadata.have_size) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_size=1; _int_fetch(tofetch); } return _stat ? _stat->st_size : 0; }
+		//! Returns st_allocated
+		off_t st_allocated() { if(!have_metadata.have_allocated) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_allocated=1; _int_fetch(tofetch); } return _stat ? _stat->st_allocated : 0; }
+		//! Returns st_blocks
+		off_t st_blocks() { if(!have_metadata.have_blocks) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_blocks=1; _int_fetch(tofetch); } return _stat ? _stat->st_blocks : 0; }
+		//! Returns st_blksize
+		uint16_t st_blksize() { if(!have_metadata.have_blksize) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_blksize=1; _int_fetch(tofetch); } return _stat ? _stat->st_blksize : 0; }
+		//! Returns st_flags
+		uint32_t st_flags() { if(!have_metadata.have_flags) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_flags=1; _int_fetch(tofetch); } return _stat ? _stat->st_flags : 0; }
+		//! Returns st_gen
+		uint32_t st_gen() { if(!have_metadata.have_gen) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_gen=1; _int_fetch(tofetch); } return _stat ? _stat->st_gen : 0; }
+		//! Returns st_birthtim
+		struct timespec st_birthtim() { if(!have_metadata.have_birthtim) { have_metadata_flags tofetch; tofetch.value=0; tofetch.have_birthtim=1; _int_fetch(tofetch); } return _stat ? _stat->st_birthtim : timespec(); }
+
+		//! A bitfield of what metadata is available on this platform. This doesn't mean all is available for every filing system.
+		static have_metadata_flags metadata_supported() BOOST_NOEXCEPT_OR_NOTHROW;
+		//! A bitfield of what metadata the filing system holding path can actually provide on this kernel.
+		static have_metadata_flags metadata_supported(const std::filesystem::path &path);
+	};
+
+	/*! \brief An open directory being enumerated.
+
+	Owns the fd or `HANDLE` of the directory plus a page aligned buffer which the kernel fills with directory
+	entries. The buffer is reused by every call to `enumerate_directory()`, and entries the kernel returned
+	which didn't fit into the last chunk are kept for the next, so chunked enumeration of even a very large
+	directory makes no allocations for the kernel to write into and as few syscalls as the buffer allows.
+	Closes the directory on destruction.
+	*/
+	class FASTDIRECTORYENUMERATOR_API enumeration_handle
+	{
+		friend bool enumerate_directory(enumeration_handle &h, std::vector<directory_entry> &out, size_t maxitems, const glob_matcher &glob, bool namesonly);
+		friend bool enumerate_directory(enumeration_handle &h, std::vector<directory_entry> &out, size_t maxitems, const filter_set &filter, bool namesonly);
+		friend bool visit_directory(enumeration_handle &h, detail::dirent_visitor_t visitor, void *ctx, size_t maxitems, const glob_matcher &glob);
+		friend bool visit_directory(enumeration_handle &h, detail::dirent_visitor_t visitor, void *ctx, size_t maxitems, const filter_set &filter);
+		friend size_t parallel_enumerate_directory(const std::filesystem::path &path, std::vector<directory_entry> &out, size_t threads);
+
+		void *h;                        // fd or HANDLE
+		std::filesystem::path _path;
+		char *buffer;                   // page aligned kernel buffer
+		size_t buffer_size;
+		size_t buffer_pos, buffer_end;  // unconsumed entries lie between these
+		size_t buffer_max;              // non-zero if the buffer grows while the kernel keeps filling it, up to this
+		bool buffer_full;               // the last kernel call may have had more to return than fitted
+		bool buffer_namesonly;          // Windows fills the buffer differently for names only
+		bool eof;
+		size_t _kernel_calls;
+		int64_t _pos;                   // just after the last entry consumed
+		enumeration_stats _stats;
+		detail::directory_ref *_dir;    // made when first needed by an entry
+#ifdef WIN32
+		bool _restart;                  // the next refill starts the scan over
+		int64_t _skip;                  // entries still to pass over to get back to a position
+#endif
+		template<class M, class F> bool _int_for_each(size_t maxitems, const M &match, bool namesonly, F &&f);
+		enumeration_handle(const enumeration_handle &) = delete;
+		enumeration_handle &operator=(const enumeration_handle &) = delete;
+		bool _int_refill(const std::filesystem::path &kernelglob, bool namesonly);
+		bool _int_alloc(size_t buffersize);
+		detail::directory_ref *_int_dir();
+#ifdef WIN32
+		void _int_open(void *dirh, const std::filesystem::path &path, size_t buffersize);
+#else
+		void _int_open(void *dirh, const char *path, size_t buffersize);
+#endif
+	public:
+		//! The size of kernel buffer used by default. Room for about 8000 short leafnames.
+		static BOOST_CONSTEXPR_OR_CONST size_t default_buffer_size=256*1024;
+		/*! \brief A buffersize which starts the kernel buffer at one page and grows it as the directory turns out to need.
+
+		Each time a kernel call fills the buffer, it is doubled before the next call, up to
+		`max_adaptive_buffer_size`. A directory of a dozen entries thus costs one page, while a huge one reaches
+		full size after a handful of calls, and the handle keeps the size it grew to if sought back and enumerated
+		again.
+		*/
+		static BOOST_CONSTEXPR_OR_CONST size_t adaptive_buffer_size=(size_t)-1;
+		/*! \brief As `adaptive_buffer_size`, but starting from a size guessed from the directory's `st_size`.
+
+		On ext4, XFS, btrfs and tmpfs `st_size` grows with the entries held, so this usually fits a small or
+		medium directory into one kernel call, at the cost of an `fstat()` when opened. Windows has no such hint
+		and starts at one page.
+		*/
+		static BOOST_CONSTEXPR_OR_CONST size_t adaptive_buffer_size_from_stat=(size_t)-2;
+		//! The most an adaptive kernel buffer grows to
+		static BOOST_CONSTEXPR_OR_CONST size_t max_adaptive_buffer_size=4*default_buffer_size;
+		//! Passed as maxitems to `enumerate_directory()`, each chunk is whatever one kernel call returned, so chunks grow with an adaptive buffer
+		static BOOST_CONSTEXPR_OR_CONST size_t adaptive_chunk=0;
+		//! Opens the directory at path. Check `is_open()` for success. A buffersize of zero allocates no kernel buffer, for handles only used for metadata lookups.
+		explicit enumeration_handle(std::filesystem::path path, size_t buffersize=default_buffer_size);
+		//! Opens the directory leafname within the open directory dirh, which is at path. Check `is_open()` for success.
+		enumeration_handle(void *dirh, const std::filesystem::path &leafname, std::filesystem::path path, size_t buffersize=default_buffer_size);
+		enumeration_handle(enumeration_handle &&o) BOOST_NOEXCEPT_OR_NOTHROW;
+		~enumeration_handle();
+		//! True if the directory was opened
+		bool is_open() const BOOST_NOEXCEPT_OR_NOTHROW { return h!=nullptr; }
+		//! The fd or `HANDLE` of the directory
+		void *native_handle() const BOOST_NOEXCEPT_OR_NOTHROW { return h; }
+		//! Frees the kernel buffer and gives up ownership of the fd or `HANDLE`, returning it. Enumeration ends.
+		void *release() BOOST_NOEXCEPT_OR_NOTHROW;
+		//! The path the directory was opened with
+		const std::filesystem::path &path() const BOOST_NOEXCEPT_OR_NOTHROW { return _path; }
+		//! The size of the kernel buffer in bytes, which for an adaptive buffer is what it has grown to so far
+		size_t kernel_buffer_size() const BOOST_NOEXCEPT_OR_NOTHROW { return buffer_size; }
+		//! The number of directory enumeration syscalls made so far
+		size_t kernel_calls() const BOOST_NOEXCEPT_OR_NOTHROW { return _kernel_calls; }
+		//! What enumerating through this handle has done so far, if the library keeps `enumeration_stats`
+		const enumeration_stats &stats() const BOOST_NOEXCEPT_OR_NOTHROW { return _stats; }
+		//! A position in the enumeration of a directory
+		typedef int64_t position_type;
+		/*! \brief The position just after the last entry enumerated, from which `seek()` carries on.
+
+		On POSIX this is the `d_off` cookie the kernel gave that entry, which stays valid for the directory when
+		it is opened again, even by another process, so a long enumeration can save it to resume from after a
+		crash or hand the rest of the enumeration to someone else. On Windows it is a count of the entries the
+		kernel returned, which `seek()` has to enumerate again to pass over, and so only holds if the same glob
+		is used. Entries created or removed meanwhile may or may not be seen, as with any enumeration of a
+		directory that changes during it. The position at the start is zero.
+		*/
+		position_type tell() const BOOST_NOEXCEPT_OR_NOTHROW { return _pos; }
+		//! Carries on the enumeration from pos, a position from `tell()` or `dirent_view::d_off`. Returns false if the kernel refused it.
+		bool seek(position_type pos);
+	};
+
+	/*! \brief A directory entry as the kernel returned it, pointing straight into the kernel buffer.
+
+	Only valid for the duration of the visitor call it was passed to, as the next kernel call overwrites it.
+	*/
+	struct dirent_view
+	{
+		name_view name;         //!< The leafname. Not null terminated on Windows.
+		uint64_t  d_ino;        //!< st_ino, zero if the platform returns names only
+		int64_t   d_off;        //!< The position just after this entry, to `enumeration_handle::seek()` to
+		uint16_t  st_type;      //!< st_type as S_IF* flags, zero if the filing system didn't say
+	};
+	/*! \brief Calls visitor for each of up to maxitems entries in the directory, without copying anything.
+
+	`visitor(const dirent_view &)` returns false to stop the enumeration early, after which the next call
+	carries on with the following entry. The same '.', '..' and glob filtering as `enumerate_directory()` is
+	applied. Returns false when the enumeration has ended.
+
+	\code
+	size_t files=0;
+	visit_directory(*h, [&files](const dirent_view &v) { if(S_IFREG==v.st_type) ++files; return true; });
+	\endcode
+	*/
+	template<class F> inline bool visit_directory(enumeration_handle &h, F &&visitor, size_t maxitems, const glob_matcher &glob)
+	{
+		typedef typename std::remove_reference<F>::type visitor_type;
+		return visit_directory(h, [](void *ctx, const dirent_view &v) -> bool { return (*(visitor_type *) ctx)(v); },
+			const_cast<void *>(static_cast<const void *>(std::addressof(visitor))), maxitems, glob);
+	}
+	//! \overload
+	template<class F> inline bool visit_directory(enumeration_handle &h, F &&visitor, size_t maxitems, const filter_set &filter)
+	{
+		typedef typename std::remove_reference<F>::type visitor_type;
+		return visit_directory(h, [](void *ctx, const dirent_view &v) -> bool { return (*(visitor_type *) ctx)(v); },
+			const_cast<void *>(static_cast<const void *>(std::addressof(visitor))), maxitems, filter);
+	}
+	//! \overload
+	template<class F> inline bool visit_directory(enumeration_handle &h, F &&visitor, size_t maxitems=(size_t)-1, const std::filesystem::path &glob=std::filesystem::path())
+	{
+		return visit_directory(h, std::forward<F>(visitor), maxitems, glob_matcher(glob));
+	}
+
+	//! \overload
+	inline void fetch_metadata(const enumeration_handle &dir, std::vector<directory_entry> &entries, have_metadata_flags wanted, bool nosync=false, fetch_order order=fetch_order::as_given)
+	{
+		if(!entries.empty())
+			fetch_metadata(dir, entries.data(), entries.data()+entries.size(), wanted, nosync, order);
+	}
+	//! \overload
+	inline void parallel_fetch_metadata(const enumeration_handle &dir, std::vector<directory_entry> &entries, have_metadata_flags wanted, size_t threads=0, bool nosync=false, fetch_order order=fetch_order::as_given)
+	{
+		if(!entries.empty())
+			parallel_fetch_metadata(dir, entries.data(), entries.data()+entries.size(), wanted, threads, nosync, order);
+	}
+
+	//! Starts the enumeration of a directory, returning a null pointer if it could not be opened.
+	extern FASTDIRECTORYENUMERATOR_API std::unique_ptr<enumeration_handle> begin_enumerate_directory(std::filesystem::path path, size_t buffersize=enumeration_handle::default_buffer_size);
+	/*! \brief Reopens a directory to carry on its enumeration from pos, returning a null pointer if it could not be opened or sought.
+
+	pos is from `enumeration_handle::tell()` of an earlier enumeration of the same directory, perhaps by another
+	process. To checkpoint a long enumeration:
+	\code
+	auto h=resume_enumerate_directory(_L("spool"), checkpoint);
+	std::vector<directory_entry> chunk;
+	while(enumerate_directory(*h, chunk, 4096))
+	{
+		process(chunk);
+		checkpoint=h->tell();
+	}
+	\endcode
+	*/
+	extern FASTDIRECTORYENUMERATOR_API std::unique_ptr<enumeration_handle> resume_enumerate_directory(std::filesystem::path path, enumeration_handle::position_type pos, size_t buffersize=enumeration_handle::default_buffer_size);
+	/*! \brief Enumerates the whole of the directory at path into out using threads threads, zero meaning one per hardware thread.
+
+	On ext4, XFS, btrfs and tmpfs the positions of entries are hashes, btree keys or indices which increase
+	through the enumeration, so the space of positions can be split up. A sampling pass seeks to points
+	through that space, taking the position of the entry found at each as the start of a partition, then
+	worker threads each with their own fd for the directory enumerate whole partitions at a time, stopping
+	at the position the next one starts at. The partitions are joined in order, so out ends up exactly as a
+	single `enumerate_directory()` loop would leave it.
+
+	If the positions turn out not to increase, as on filing systems which hand out arbitrary cookies, or on
+	Windows where they are counts, this falls back to a single `enumerate_directory()` loop. Returns the
+	number of partitions enumerated, one if it fell back, or zero if the directory could not be opened.
+	*/
+	extern FASTDIRECTORYENUMERATOR_API size_t parallel_enumerate_directory(const std::filesystem::path &path, std::vector<directory_entry> &out, size_t threads=0);
+	/*! \brief Enumerates a directory as quickly as possible, retrieving all zero-cost metadata.
+
+	Note that maxitems items may not be retreived for various reasons, including that glob filtered them out.
+	A zero item vector return is entirely possible, but this does not mean end of enumeration: only a null
+	unique_ptr means that.
+
+	Windows returns the common stat items, Linux and FreeBSD returns `st_ino` and usually `st_type`, other POSIX just `st_ino`.
+	Setting namesonly to true returns as little information as possible.
+
+	Suggested code for merging chunks of enumeration into a single vector:
+	\code
+	auto h=begin_enumerate_directory(_L("testdir"));
+	std::unique_ptr<std::vector<directory_entry>> enumeration, chunk;
+	while((chunk=enumerate_directory(*h, NUMBER_OF_FILES)))
+		if(!enumeration)
+			enumeration=std::move(chunk);
+		else
+			enumeration->insert(enumeration->end(), std::make_move_iterator(chunk->begin()), std::make_move_iterator(chunk->end()));
+	\endcode
+	*/
+	extern FASTDIRECTORYENUMERATOR_API std::unique_ptr<std::vector<directory_entry>> enumerate_directory(enumeration_handle &h, size_t maxitems, std::filesystem::path glob=std::filesystem::path(), bool namesonly=false);
+
+	/*! \brief A compact store for the entries of a directory.
+
+	Where a `std::vector<directory_entry>` costs a `std::filesystem::path` and a full stat structure per entry,
+	this keeps all the leafnames null terminated in one contiguous arena and a fixed size `record` per entry
+	holding where its name lies, its `st_ino` and `st_type`. The rest of the stat structure lives in a side
+	table which only gains a row when metadata is fetched for that entry.
+
+	Enumerating into one of these appends, so chunks accumulate into the same arena. Metadata returned by
+	Windows enumeration beyond `st_ino` and `st_type` is not kept.
+	*/
+	class FASTDIRECTORYENUMERATOR_API packed_enumeration
+	{
+		friend class directory_snapshot;
+	public:
+		//! The fixed size part of each entry
+		struct record
+		{
+			uint64_t            st_ino;
+			uint64_t            name_offset;  //!< Offset of the leafname in the arena, in characters
+			uint32_t            stat_index;   //!< Row in the stat side table, or no_stat
+			uint16_t            name_length;  //!< Length of the leafname, in characters
+			uint16_t            st_type;
+			have_metadata_flags have_metadata;
+		};
+		//! The stat_index of a record without a row in the stat side table
+		static BOOST_CONSTEXPR_OR_CONST uint32_t no_stat=(uint32_t)-1;
+		//! A lightweight reference to an entry
+		class entry
+		{
+			const packed_enumeration *p;
+			size_t idx;
+		public:
+			entry(const packed_enumeration *_p, size_t _idx) : p(_p), idx(_idx) { }
+			//! The name of the directory entry
+			name_view name() const BOOST_NOEXCEPT_OR_NOTHROW { const record &r=p->records[idx]; return name_view(p->names.data()+r.name_offset, r.name_length); }
+			//! The name of the directory entry, null terminated
+			const std::filesystem::path::value_type *c_str() const BOOST_NOEXCEPT_OR_NOTHROW { return p->names.data()+p->records[idx].name_offset; }
+			//! A bitfield of what metadata is ready right now
+			have_metadata_flags metadata_ready() const BOOST_NOEXCEPT_OR_NOTHROW { return p->records[idx].have_metadata; }
+			//! Returns st_ino
+			uint64_t st_ino() const BOOST_NOEXCEPT_OR_NOTHROW { return p->records[idx].st_ino; }
+			//! Returns st_type
+			uint16_t st_type() const BOOST_NOEXCEPT_OR_NOTHROW { return p->records[idx].st_type; }
+			//! Makes a full directory_entry of this entry
+			directory_entry to_directory_entry() const { return p->to_directory_entry(idx); }
+		};
+		//! A random access iterator over the entries
+		class const_iterator
+		{
+			const packed_enumeration *p;
+			size_t idx;
+		public:
+			typedef std::random_access_iterator_tag iterator_category;
+			typedef entry value_type;
+			typedef ptrdiff_t difference_type;
+			typedef void pointer;
+			typedef entry reference;
+			const_iterator() : p(nullptr), idx(0) { }
+			const_iterator(const packed_enumeration *_p, size_t _idx) : p(_p), idx(_idx) { }
+			entry operator*() const { return entry(p, idx); }
+			entry operator[](ptrdiff_t n) const { return entry(p, idx+n); }
+			const_iterator &operator++() { ++idx; return *this; }
+			const_iterator operator++(int) { const_iterator ret(*this); ++idx; return ret; }
+			const_iterator &operator--() { --idx; return *this; }
+			const_iterator operator--(int) { const_iterator ret(*this); --idx; return ret; }
+			const_iterator &operator+=(ptrdiff_t n) { idx+=n; return *this; }
+			const_iterator &operator-=(ptrdiff_t n) { idx-=n; return *this; }
+			const_iterator operator+(ptrdiff_t n) const { return const_iterator(p, idx+n); }
+			const_iterator operator-(ptrdiff_t n) const { return const_iterator(p, idx-n); }
+			ptrdiff_t operator-(const const_iterator &o) const { return (ptrdiff_t) idx-(ptrdiff_t) o.idx; }
+			bool operator==(const const_iterator &o) const { return idx==o.idx; }
+			bool operator!=(const const_iterator &o) const { return idx!=o.idx; }
+			bool operator< (const const_iterator &o) const { return idx<o.idx; }
+			bool operator<=(const const_iterator &o) const { return idx<=o.idx; }
+			bool operator> (const const_iterator &o) const { return idx>o.idx; }
+			bool operator>=(const const_iterator &o) const { return idx>=o.idx; }
+		};
+	private:
+		std::vector<std::filesystem::path::value_type> names;
+		std::vector<record> records;
+		std::vector<directory_entry::stat_t> stats;
+	public:
+		//! Adds an entry
+		void push_back(name_view name, uint64_t st_ino, uint16_t st_type);
+		//! Adds a directory_entry, keeping any metadata it has
+		void push_back(const directory_entry &e);
+		//! Reserves space for entries entries with leafnames totalling namechars characters
+		void reserve(size_t entries, size_t namechars) { records.reserve(entries); names.reserve(namechars+entries); }
+		//! Empties the store, keeping its capacity
+		void clear() BOOST_NOEXCEPT_OR_NOTHROW { names.clear(); records.clear(); stats.clear(); }
+		//! The number of entries
+		size_t size() const BOOST_NOEXCEPT_OR_NOTHROW { return records.size(); }
+		//! True if there are no entries
+		bool empty() const BOOST_NOEXCEPT_OR_NOTHROW { return records.empty(); }
+		//! The entry at idx
+		entry operator[](size_t idx) const BOOST_NOEXCEPT_OR_NOTHROW { return entry(this, idx); }
+		const_iterator begin() const BOOST_NOEXCEPT_OR_NOTHROW { return const_iterator(this, 0); }
+		const_iterator end() const BOOST_NOEXCEPT_OR_NOTHROW { return const_iterator(this, records.size()); }
+		//! The fixed size record of the entry at idx
+		const record &record_at(size_t idx) const BOOST_NOEXCEPT_OR_NOTHROW { return records[idx]; }
+		//! The row of the stat side table of the entry at idx, or null if it has none
+		const directory_entry::stat_t *stat_at(size_t idx) const BOOST_NOEXCEPT_OR_NOTHROW { uint32_t i=records[idx].stat_index; return no_stat==i ? nullptr : &stats[i]; }
+		//! Makes a full directory_entry of the entry at idx
+		directory_entry to_directory_entry(size_t idx) const;
+		//! Fetches the specified metadata for the entry at idx, returning that now available. This is a blocking call.
+		have_metadata_flags fetch_metadata(size_t idx, std::filesystem::path prefix, have_metadata_flags wanted);
+		//! The number of bytes of memory held, including unused capacity
+		size_t bytes_used() const BOOST_NOEXCEPT_OR_NOTHROW { return names.capacity()*sizeof(std::filesystem::path::value_type)+records.capacity()*sizeof(record)+stats.capacity()*sizeof(directory_entry::stat_t); }
+	};
+	/*! \brief Appends up to maxitems entries of the directory to out.
+
+	Returns false when the enumeration has ended. To pack a whole directory:
+	\code
+	packed_enumeration entries;
+	auto h=begin_enumerate_directory(_L("testdir"));
+	while(enumerate_directory(*h, entries));
+	\endcode
+	*/
+	extern FASTDIRECTORYENUMERATOR_API bool enumerate_directory(enumeration_handle &h, packed_enumeration &out, size_t maxitems, const glob_matcher &glob);
+	//! \overload
+	extern FASTDIRECTORYENUMERATOR_API bool enumerate_directory(enumeration_handle &h, packed_enumeration &out, size_t maxitems, const filter_set &filter);
+	//! \overload
+	inline bool enumerate_directory(enumeration_handle &h, packed_enumeration &out, size_t maxitems=(size_t)-1, const std::filesystem::path &glob=std::filesystem::path())
+	{
+		return enumerate_directory(h, out, maxitems, glob_matcher(glob));
+	}
+
+	/*! \brief The entries of a directory stored as columns, for queries which scan many entries at once.
+
+	Each field lives in its own contiguous array: `st_ino`, `st_type`, the offset of each leafname in one
+	arena of null terminated leafnames, and once `fetch_metadata()` has filled them, `st_size` and `st_mtim`.
+	A query like "all regular files" or "inodes in a range" then only touches the column it tests, and the
+	`count_*()` and `select_*()` predicates test many rows per instruction using SSE2 and, where the CPU has
+	it, AVX2. `select_*()` appends the indices of the matching rows to a selection vector.
+
+	Enumerating into one of these appends, so chunks accumulate into the same columns.
+	*/
+	class FASTDIRECTORYENUMERATOR_API columnar_enumeration
+	{
+		std::vector<std::filesystem::path::value_type> _names;
+		std::vector<uint64_t> _name_offset;
+		std::vector<uint64_t> _st_ino;
+		std::vector<uint16_t> _st_type;
+		std::vector<off_t> _st_size;
+		std::vector<timespec> _st_mtim;
+		std::vector<have_metadata_flags> _fetched;  // empty until fetch_metadata()
+	public:
+		//! Adds an entry
+		void push_back(name_view name, uint64_t st_ino, uint16_t st_type);
+		//! Reserves space for entries entries with leafnames totalling namechars characters
+		void reserve(size_t entries, size_t namechars) { _names.reserve(namechars+entries); _name_offset.reserve(entries); _st_ino.reserve(entries); _st_type.reserve(entries); }
+		//! Empties the columns, keeping their capacity
+		void clear() BOOST_NOEXCEPT_OR_NOTHROW { _names.clear(); _name_offset.clear(); _st_ino.clear(); _st_type.clear(); _st_size.clear(); _st_mtim.clear(); _fetched.clear(); }
+		//! The number of entries
+		size_t size() const BOOST_NOEXCEPT_OR_NOTHROW { return _st_ino.size(); }
+		//! True if there are no entries
+		bool empty() const BOOST_NOEXCEPT_OR_NOTHROW { return _st_ino.empty(); }
+
+		//! The name of the entry at idx
+		name_view name(size_t idx) const BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			size_t end=(idx+1<_name_offset.size()) ? (size_t) _name_offset[idx+1] : _names.size();
+			return name_view(_names.data()+_name_offset[idx], end-(size_t) _name_offset[idx]-1);
+		}
+		//! The name of the entry at idx, null terminated
+		const std::filesystem::path::value_type *c_str(size_t idx) const BOOST_NOEXCEPT_OR_NOTHROW { return _names.data()+_name_offset[idx]; }
+		//! A bitfield of what metadata is ready right now for the entry at idx
+		have_metadata_flags metadata_ready(size_t idx) const BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			have_metadata_flags ret; ret.value=_fetched.empty() ? 0 : _fetched[idx].value;
+#ifndef WIN32
+			ret.have_ino=1;
+#else
+			ret.have_ino|=(0!=_st_ino[idx]);
+#endif
+			ret.have_type|=(0!=_st_type[idx]);
+			return ret;
+		}
+		//! The leafname arena
+		const std::vector<std::filesystem::path::value_type> &names_column() const BOOST_NOEXCEPT_OR_NOTHROW { return _names; }
+		//! Offsets of each leafname within the arena, in characters
+		const std::vector<uint64_t> &name_offset_column() const BOOST_NOEXCEPT_OR_NOTHROW { return _name_offset; }
+		//! The st_ino column
+		const std::vector<uint64_t> &ino_column() const BOOST_NOEXCEPT_OR_NOTHROW { return _st_ino; }
+		//! The st_type column
+		const std::vector<uint16_t> &type_column() const BOOST_NOEXCEPT_OR_NOTHROW { return _st_type; }
+		//! The st_size column, empty unless fetched. Rows whose size couldn't be fetched read as zero.
+		const std::vector<off_t> &size_column() const BOOST_NOEXCEPT_OR_NOTHROW { return _st_size; }
+		//! The st_mtim column, empty unless fetched. Rows whose mtime couldn't be fetched read as zero.
+		const std::vector<timespec> &mtim_column() const BOOST_NOEXCEPT_OR_NOTHROW { return _st_mtim; }
+
+		/*! \brief Fills the size and mtime columns for every entry relative to the open directory dir. This is a blocking call.
+
+		Only `have_size` and `have_mtim` of wanted are looked at. The lookups go through the batch `fetch_metadata()`.
+		*/
+		void fetch_metadata(const enumeration_handle &dir, have_metadata_flags wanted, bool nosync=false);
+
+		//! The number of entries whose st_type is st_type
+		size_t count_type(uint16_t st_type) const BOOST_NOEXCEPT_OR_NOTHROW;
+		//! Appends the indices of the entries whose st_type is st_type to selection
+		void select_type(uint16_t st_type, std::vector<uint32_t> &selection) const;
+		//! The number of entries whose st_ino lies within [lo, hi]
+		size_t count_ino_range(uint64_t lo, uint64_t hi) const BOOST_NOEXCEPT_OR_NOTHROW;
+		//! Appends the indices of the entries whose st_ino lies within [lo, hi] to selection
+		void select_ino_range(uint64_t lo, uint64_t hi, std::vector<uint32_t> &selection) const;
+		//! Appends the indices of the entries whose st_size lies within [lo, hi] to selection. Selects nothing unless sizes were fetched.
+		void select_size_range(off_t lo, off_t hi, std::vector<uint32_t> &selection) const;
+
+		//! The number of bytes of memory held, including unused capacity
+		size_t bytes_used() const BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			return _names.capacity()*sizeof(std::filesystem::path::value_type)+_name_offset.capacity()*sizeof(uint64_t)+_st_ino.capacity()*sizeof(uint64_t)
+				+_st_type.capacity()*sizeof(uint16_t)+_st_size.capacity()*sizeof(off_t)+_st_mtim.capacity()*sizeof(timespec)+_fetched.capacity()*sizeof(have_metadata_flags);
+		}
+	};
+	/*! \brief Appends up to maxitems entries of the directory to the columns of out.
+
+	Returns false when the enumeration has ended. To enumerate a whole directory and find its regular files:
+	\code
+	columnar_enumeration columns;
+	auto h=begin_enumerate_directory(_L("testdir"));
+	while(enumerate_directory(*h, columns));
+	std::vector<uint32_t> files;
+	columns.select_type(S_IFREG, files);
+	\endcode
+	*/
+	extern FASTDIRECTORYENUMERATOR_API bool enumerate_directory(enumeration_handle &h, columnar_enumeration &out, size_t maxitems, const glob_matcher &glob);
+	//! \overload
+	extern FASTDIRECTORYENUMERATOR_API bool enumerate_directory(enumeration_handle &h, columnar_enumeration &out, size_t maxitems, const filter_set &filter);
+	//! \overload
+	inline bool enumerate_directory(enumeration_handle &h, columnar_enumeration &out, size_t maxitems=(size_t)-1, const std::filesystem::path &glob=std::filesystem::path())
+	{
+		return enumerate_directory(h, out, maxitems, glob_matcher(glob));
+	}
+} // namespace
+
+namespace std
+{
+	template<> struct hash<FastDirectoryEnumerator::directory_entry>
+	{
+	public:
+		size_t operator()(const FastDirectoryEnumerator::directory_entry& p) const
+		{
+			return std::filesystem::hash_value(p.name());
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,122 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#include "InodeSet.hpp"
+#include <algorithm>
+#include <thread>
+
+namespace FastDirectoryEnumerator
+{
+
+inode_set::inode_set(size_t expected, size_t threads)
+{
+	if(!threads)
+		threads=std::max((size_t) std::thread::hardware_concurrency(), (size_t) 1);
+	// Enough shards that threads picking them at random seldom pick the same one
+	for(_shardcount=16; _shardcount<threads*8; _shardcount<<=1);
+	size_t perslots=16;
+	while(perslots*7/10<expected/_shardcount+1)
+		perslots<<=1;
+	_shards.reset(new shard[_shardcount]);
+	for(size_t n=0; n<_shardcount; n++)
+		_shards[n].slots.resize(perslots, key{0, 0});
+}
+
+void inode_set::_grow(shard &s)
+{
+	std::vector<key> slots(s.slots.size()*2, key{0, 0});
+	size_t mask=slots.size()-1;
+	for(auto &k : s.slots)
+		if(k.ino)
+		{
+			size_t idx=(size_t) _hash(k.dev, k.ino)&mask;
+			while(slots[idx].ino)
+				idx=(idx+1)&mask;
+			slots[idx]=k;
+		}
+	s.slots=std::move(slots);
+}
+
+bool inode_set::insert(uint64_t dev, uint64_t ino)
+{
+	if(!ino)
+		return true;
+	uint64_t h=_hash(dev, ino);
+	// The top bits pick the shard and the bottom bits the slot, so the two don't correlate
+	shard &s=_shards[(size_t)(h>>48)&(_shardcount-1)];
+	std::lock_guard<std::mutex> g(s.lock);
+	size_t mask=s.slots.size()-1;
+	for(size_t idx=(size_t) h&mask;; idx=(idx+1)&mask)
+	{
+		key &k=s.slots[idx];
+		if(!k.ino)
+		{
+			k.dev=dev;
+			k.ino=ino;
+			if(++s.used*10>s.slots.size()*7)
+				_grow(s);
+			return true;
+		}
+		if(k.ino==ino && k.dev==dev)
+		{
+			++s.repeats;
+			return false;
+		}
+	}
+}
+
+bool inode_set::contains(uint64_t dev, uint64_t ino) const
+{
+	if(!ino)
+		return false;
+	uint64_t h=_hash(dev, ino);
+	shard &s=_shards[(size_t)(h>>48)&(_shardcount-1)];
+	std::lock_guard<std::mutex> g(s.lock);
+	size_t mask=s.slots.size()-1;
+	for(size_t idx=(size_t) h&mask;; idx=(idx+1)&mask)
+	{
+		const key &k=s.slots[idx];
+		if(!k.ino)
+			return false;
+		if(k.ino==ino && k.dev==dev)
+			return true;
+	}
+}
+
+size_t inode_set::size() const
+{
+	size_t ret=0;
+	for(size_t n=0; n<_shardcount; n++)
+	{
+		std::lock_guard<std::mutex> g(_shards[n].lock);
+		ret+=_shards[n].used;
+	}
+	return ret;
+}
+
+size_t inode_set::repeats() const
+{
+	size_t ret=0;
+	for(size_t n=0; n<_shardcount; n++)
+	{
+		std::lock_guard<std::mutex> g(_shards[n].lock);
+		ret+=_shards[n].repeats;
+	}
+	return ret;
+}
+
+void inode_set::clear()
+{
+	for(size_t n=0; n<_shardcount; n++)
+	{
+		shard &s=_shards[n];
+		std::lock_guard<std::mutex> g(s.lock);
+		std::fill(s.slots.begin(), s.slots.end(), key{0, 0});
+		s.used=s.repeats=0;
+	}
+}
+
+} // namespace
@@ -0,0 +1,63 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_INODESET_H
+#define FASTDIRECTORYENUMERATOR_INODESET_H
+
+#include "FastDirectoryEnumerator.hpp"
+#include <mutex>
+
+namespace FastDirectoryEnumerator
+{
+	/*! \brief A set of (st_dev, st_ino) which many threads may insert into at once.
+
+	The set is split into shards by the hash of the inode, each an open addressing table with linear probing
+	behind its own lock, so threads inserting at once rarely wait on one another and an insert costs a probe
+	or two of one cache line. Each shard doubles itself when it gets more than 70% full. As st_ino is never
+	zero for an entry which exists, it marks the empty slots, and inode zero is never held.
+
+	Set `walk_options::visited` to one to have `walk_tree()` skip inodes it has already been to.
+	*/
+	class FASTDIRECTORYENUMERATOR_API inode_set
+	{
+		struct key
+		{
+			uint64_t dev, ino;
+		};
+		struct shard
+		{
+			std::mutex lock;
+			std::vector<key> slots;  // a power of two long
+			size_t used, repeats;
+			shard() : used(0), repeats(0) { }
+		};
+		std::unique_ptr<shard[]> _shards;
+		size_t _shardcount;          // a power of two
+		inode_set(const inode_set &) = delete;
+		inode_set &operator=(const inode_set &) = delete;
+		static uint64_t _hash(uint64_t dev, uint64_t ino) BOOST_NOEXCEPT_OR_NOTHROW
+		{
+			uint64_t h=(ino^(dev<<40)^(dev>>24))*0x9E3779B97F4A7C15ULL;
+			return h^(h>>29);
+		}
+		static void _grow(shard &s);
+	public:
+		//! Constructs a set sized to hold expected inodes without growing, split into enough shards for threads inserting at once, zero meaning one per hardware thread
+		explicit inode_set(size_t expected=0, size_t threads=0);
+		//! Inserts (dev, ino), returning false if it was already there. Inode zero is never inserted, and always returns true.
+		bool insert(uint64_t dev, uint64_t ino);
+		//! True if (dev, ino) is in the set
+		bool contains(uint64_t dev, uint64_t ino) const;
+		//! The number of inodes in the set
+		size_t size() const;
+		//! The number of times `insert()` has returned false
+		size_t repeats() const;
+		//! Empties the set, keeping the memory it has
+		void clear();
+	};
+} // namespace
+
+#endif
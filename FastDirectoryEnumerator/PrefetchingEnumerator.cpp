@@ -0,0 +1,113 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#include "PrefetchingEnumerator.hpp"
+
+namespace FastDirectoryEnumerator
+{
+
+prefetching_enumerator::prefetching_enumerator(std::unique_ptr<enumeration_handle> h, have_metadata_flags wanted, size_t maxitems, size_t depth)
+	: _h(std::move(h)), _wanted(wanted), _maxitems(maxitems), _slots(std::max(depth, (size_t) 2)), _head(0), _held((size_t)-1), _ended(false), _stop(false), _waits(0)
+{
+	for(auto &s : _slots)
+		s.state=slot_state::free;
+}
+
+prefetching_enumerator::~prefetching_enumerator()
+{
+	{
+		std::lock_guard<std::mutex> g(_lock);
+		_stop=true;
+	}
+	_cv.notify_all();
+	if(_thread.joinable())
+		_thread.join();
+}
+
+std::unique_ptr<prefetching_enumerator> prefetching_enumerator::open(const std::filesystem::path &path, have_metadata_flags wanted, size_t maxitems, size_t depth)
+{
+	auto h=begin_enumerate_directory(path);
+	if(!h)
+		return nullptr;
+	std::unique_ptr<prefetching_enumerator> ret(new prefetching_enumerator(std::move(h), wanted, maxitems, depth));
+	ret->_thread=std::thread(&prefetching_enumerator::_run, ret.get());
+	return ret;
+}
+
+void prefetching_enumerator::_run()
+{
+	try
+	{
+		for(size_t tail=0;; tail=(tail+1)%_slots.size())
+		{
+			slot &s=_slots[tail];
+			{
+				std::unique_lock<std::mutex> g(_lock);
+				_cv.wait(g, [&] { return _stop || slot_state::free==s.state; });
+				if(_stop)
+					return;
+			}
+			// The slot is ours until it is marked ready. Chunks the glob emptied are skipped.
+			bool more;
+			while((more=enumerate_directory(*_h, s.entries, _maxitems)) && s.entries.empty());
+			if(more && _wanted.value)
+				fetch_metadata(*_h, s.entries, _wanted);
+			{
+				std::lock_guard<std::mutex> g(_lock);
+				if(more)
+					s.state=slot_state::ready;
+				else
+					_ended=true;
+			}
+			_cv.notify_all();
+			if(!more)
+				return;
+		}
+	}
+	catch(...)
+	{
+		{
+			std::lock_guard<std::mutex> g(_lock);
+			_error=std::current_exception();
+			_ended=true;
+		}
+		_cv.notify_all();
+	}
+}
+
+std::vector<directory_entry> *prefetching_enumerator::next()
+{
+	std::unique_lock<std::mutex> g(_lock);
+	if((size_t)-1!=_held)
+	{
+		_slots[_held].state=slot_state::free;
+		_held=(size_t)-1;
+		_cv.notify_all();
+	}
+	slot &s=_slots[_head];
+	// The background thread fills slots in order, so once it has ended any slot not ready never will be
+	if(slot_state::ready!=s.state && !_ended)
+	{
+		++_waits;
+		_cv.wait(g, [&] { return slot_state::ready==s.state || _ended; });
+	}
+	if(slot_state::ready!=s.state)
+	{
+		if(_error)
+		{
+			std::exception_ptr error(std::move(_error));
+			_error=nullptr;
+			std::rethrow_exception(error);
+		}
+		return nullptr;
+	}
+	s.state=slot_state::held;
+	_held=_head;
+	_head=(_head+1)%_slots.size();
+	return &s.entries;
+}
+
+} // namespace
@@ -0,0 +1,80 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_PREFETCHINGENUMERATOR_H
+#define FASTDIRECTORYENUMERATOR_PREFETCHINGENUMERATOR_H
+
+#include "FastDirectoryEnumerator.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace FastDirectoryEnumerator
+{
+	/*! \brief Enumerates a directory on a background thread, a few chunks ahead of the caller.
+
+	A plain `enumerate_directory()` loop leaves the CPU idle while the kernel reads the directory, and the
+	storage idle while the caller works through each chunk. Here a background thread owns the enumeration and
+	fills a small ring of chunks, fetching the metadata wanted for each, while the caller processes the chunk
+	`next()` last returned. Each slot of the ring keeps its vector, so once the ring has gone round once no
+	more vectors are allocated.
+
+	The background thread stops once the ring is full, so it never gets more than depth chunks ahead.
+	*/
+	class FASTDIRECTORYENUMERATOR_API prefetching_enumerator
+	{
+		enum class slot_state { free, ready, held };
+		struct slot
+		{
+			std::vector<directory_entry> entries;
+			slot_state state;
+		};
+		std::unique_ptr<enumeration_handle> _h;
+		have_metadata_flags _wanted;
+		size_t _maxitems;
+		std::vector<slot> _slots;  // the ring, filled in order by the background thread
+		size_t _head;              // the slot next() returns next
+		size_t _held;              // the slot last returned, or (size_t)-1
+		std::mutex _lock;
+		std::condition_variable _cv;
+		bool _ended, _stop;
+		std::exception_ptr _error;
+		size_t _waits;
+		std::thread _thread;
+		prefetching_enumerator(std::unique_ptr<enumeration_handle> h, have_metadata_flags wanted, size_t maxitems, size_t depth);
+		prefetching_enumerator(const prefetching_enumerator &) = delete;
+		prefetching_enumerator &operator=(const prefetching_enumerator &) = delete;
+		void _run();
+	public:
+		//! Stops the background thread
+		~prefetching_enumerator();
+		/*! \brief Starts enumerating the directory at path in the background, returning a null pointer if it could not be opened.
+
+		Chunks are up to maxitems entries, `enumeration_handle::adaptive_chunk` meaning one kernel call's worth, and
+		the background thread gets up to depth chunks ahead, which must be at least two.
+		*/
+		static std::unique_ptr<prefetching_enumerator> open(const std::filesystem::path &path, have_metadata_flags wanted, size_t maxitems=4096, size_t depth=3);
+		//! \overload
+		static std::unique_ptr<prefetching_enumerator> open(const std::filesystem::path &path)
+		{
+			have_metadata_flags wanted; wanted.value=0;
+			return open(path, wanted);
+		}
+		/*! \brief Returns the next chunk, waiting for it if need be, or null once the enumeration has ended.
+
+		The chunk remains valid, and may be modified, until the next call, which hands its slot back to be
+		refilled. Rethrows anything the background thread threw.
+		*/
+		std::vector<directory_entry> *next();
+		//! The enumeration the background thread is doing, for metadata lookups relative to the directory
+		const enumeration_handle &handle() const BOOST_NOEXCEPT_OR_NOTHROW { return *_h; }
+		//! The number of times `next()` had to wait for the background thread, which is how often it fell behind
+		size_t waits() const BOOST_NOEXCEPT_OR_NOTHROW { return _waits; }
+	};
+} // namespace
+
+#endif
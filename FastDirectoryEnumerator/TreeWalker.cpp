@@ -0,0 +1,298 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#include "TreeWalker.hpp"
+#include "InodeSet.hpp"
+#include <sys/stat.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace FastDirectoryEnumerator
+{
+
+std::filesystem::path walked_directory::path() const
+{
+	std::vector<const walked_directory *> chain;
+	for(const walked_directory *d=this; d; d=d->parent())
+		chain.push_back(d);
+	std::filesystem::path ret;
+	for(auto it=chain.rbegin(); it!=chain.rend(); ++it)
+		ret/=(*it)->leafname();
+	return ret;
+}
+
+namespace
+{
+	// Keeps a directory fd open for as long as subdirectories still need to be opened relative to it
+	struct dirfd_holder
+	{
+		void *h;
+		explicit dirfd_holder(void *_h) : h(_h) { }
+		~dirfd_holder()
+		{
+#ifdef WIN32
+			CloseHandle(h);
+#else
+			close((int)(size_t)h);
+#endif
+		}
+	};
+
+	// Finds the (st_dev, st_ino) of an open directory
+	bool identify(void *h, uint64_t &dev, uint64_t &ino)
+	{
+#ifdef WIN32
+		BY_HANDLE_FILE_INFORMATION info;
+		if(!GetFileInformationByHandle(h, &info))
+			return false;
+		dev=info.dwVolumeSerialNumber;
+		ino=((uint64_t) info.nFileIndexHigh<<32)|info.nFileIndexLow;
+#else
+		struct stat s;
+		if(-1==fstat((int)(size_t)h, &s))
+			return false;
+		dev=s.st_dev;
+		ino=s.st_ino;
+#endif
+		return true;
+	}
+
+	struct work_item
+	{
+		std::shared_ptr<const walked_directory> dir;
+		std::shared_ptr<dirfd_holder> parentfd;  // null for the root
+	};
+
+	class tree_walker
+	{
+		struct worker_queue
+		{
+			std::mutex lock;
+			std::deque<work_item> items;
+		};
+		const walk_options &options;
+		detail::walk_sink_t sink;
+		void *ctx;
+		uint64_t root_dev;
+		std::vector<std::unique_ptr<worker_queue>> queues;
+		std::atomic<size_t> outstanding;  // items queued or being processed
+		std::atomic<size_t> queued;       // items queued, only ever raised holding sleeplock so no wakeup is lost
+		std::atomic<size_t> delivered;
+		std::atomic<bool> stop;
+		std::mutex sleeplock;
+		std::condition_variable wake;     // signalled when queued is raised or outstanding reaches zero
+		std::mutex errorlock;
+		std::exception_ptr error;
+
+		void push(size_t self, work_item &&item)
+		{
+			++outstanding;
+			{
+				std::lock_guard<std::mutex> g(sleeplock), g2(queues[self]->lock);
+				queues[self]->items.push_back(std::move(item));
+				++queued;
+			}
+			wake.notify_one();
+		}
+		// Takes the most recently pushed item of our own queue for locality, else steals the oldest of someone else's
+		bool pop(size_t self, work_item &item)
+		{
+			{
+				worker_queue &q=*queues[self];
+				std::lock_guard<std::mutex> g(q.lock);
+				if(!q.items.empty())
+				{
+					item=std::move(q.items.back());
+					q.items.pop_back();
+					--queued;
+					return true;
+				}
+			}
+			for(size_t n=1; n<queues.size(); n++)
+			{
+				worker_queue &q=*queues[(self+n)%queues.size()];
+				std::lock_guard<std::mutex> g(q.lock);
+				if(!q.items.empty())
+				{
+					item=std::move(q.items.front());
+					q.items.pop_front();
+					--queued;
+					return true;
+				}
+			}
+			return false;
+		}
+		void process(size_t self, const work_item &item, std::vector<directory_entry> &chunk)
+		{
+			const walked_directory &dir=*item.dir;
+			std::unique_ptr<enumeration_handle> h;
+			if(item.parentfd)
+				h.reset(new enumeration_handle(item.parentfd->h, dir.leafname(), dir.path()));
+			else
+				h.reset(new enumeration_handle(dir.leafname()));
+			if(!h->is_open())
+			{
+				if(options.on_error)
+				{
+#ifdef WIN32
+					options.on_error(options.error_ctx, dir, (int) GetLastError());
+#else
+					options.on_error(options.error_ctx, dir, errno);
+#endif
+				}
+				return;
+			}
+			uint64_t mydev=0, myino=0;
+			if(options.visited && identify(h->native_handle(), mydev, myino) && !options.visited->insert(mydev, myino))
+				return;
+			bool candescend=dir.depth()<options.max_depth;
+			have_metadata_flags typeflag; typeflag.value=0; typeflag.have_type=1;
+			have_metadata_flags devflag; devflag.value=0; devflag.have_dev=1;
+			std::vector<work_item> children;
+			while(!stop && enumerate_directory(*h, chunk, options.chunk_size))
+			{
+				if(options.visited)
+					detail::drop_visited(*h, mydev, chunk, *options.visited, options.metadata);
+				if(options.metadata.value)
+				{
+					if(options.batch_metadata)
+						fetch_metadata(*h, chunk, options.metadata);
+					else
+						for(auto &entry : chunk)
+							entry.fetch_metadata(*h, options.metadata);
+				}
+				for(auto &entry : chunk)
+				{
+					// Filing systems which return DT_UNKNOWN need asking
+					if(!entry.metadata_ready().have_type)
+						entry.fetch_metadata(*h, typeflag);
+					bool isdir=entry.metadata_ready().have_type && S_IFDIR==entry.st_type();
+					++delivered;
+					if(!sink(ctx, dir, entry) || !isdir || !candescend)
+						continue;
+					if(options.one_filesystem && entry.metadata_supported().have_dev)
+					{
+						if(!entry.fetch_metadata(*h, devflag).have_dev || entry.st_dev()!=root_dev)
+							continue;
+					}
+					work_item child;
+					child.dir=std::make_shared<walked_directory>(item.dir, entry.name().native(), dir.depth()+1);
+					children.push_back(std::move(child));
+				}
+			}
+			if(!children.empty())
+			{
+				// Hand our fd on to the children to open themselves relative to
+				std::shared_ptr<dirfd_holder> myfd=std::make_shared<dirfd_holder>(h->release());
+				for(auto &child : children)
+				{
+					child.parentfd=myfd;
+					push(self, std::move(child));
+				}
+			}
+		}
+		void run(size_t self)
+		{
+			std::vector<directory_entry> chunk;
+			for(;;)
+			{
+				work_item item;
+				if(pop(self, item))
+				{
+					if(!stop)
+					{
+						try
+						{
+							process(self, item, chunk);
+						}
+						catch(...)
+						{
+							std::lock_guard<std::mutex> g(errorlock);
+							if(!error)
+								error=std::current_exception();
+							stop=true;
+						}
+					}
+					item=work_item();
+					if(0==--outstanding)
+					{
+						std::lock_guard<std::mutex> g(sleeplock);
+						wake.notify_all();
+					}
+					continue;
+				}
+				if(!outstanding)
+					break;
+				// Sleep until there is something to steal or the walk is done
+				std::unique_lock<std::mutex> g(sleeplock);
+				wake.wait(g, [this] { return queued || !outstanding; });
+			}
+		}
+	public:
+		tree_walker(const walk_options &_options, detail::walk_sink_t _sink, void *_ctx) : options(_options), sink(_sink), ctx(_ctx), root_dev(0), outstanding(0), queued(0), delivered(0), stop(false) { }
+		size_t walk(const std::filesystem::path &root)
+		{
+			size_t threads=options.threads ? options.threads : std::thread::hardware_concurrency();
+			if(!threads) threads=1;
+			for(size_t n=0; n<threads; n++)
+				queues.push_back(std::unique_ptr<worker_queue>(new worker_queue));
+#ifndef WIN32
+			if(options.one_filesystem)
+			{
+				struct stat s;
+				if(-1!=::stat(root.c_str(), &s))
+					root_dev=s.st_dev;
+			}
+#endif
+			work_item item;
+			item.dir=std::make_shared<walked_directory>(nullptr, root.native(), 0);
+			push(0, std::move(item));
+			std::vector<std::thread> workers;
+			for(size_t n=1; n<threads; n++)
+				workers.push_back(std::thread([this, n] { run(n); }));
+			run(0);
+			for(auto &worker : workers)
+				worker.join();
+			if(error)
+				std::rethrow_exception(error);
+			return delivered;
+		}
+	};
+}
+
+void detail::drop_visited(const enumeration_handle &h, uint64_t dev, std::vector<directory_entry> &chunk, inode_set &visited, have_metadata_flags wanted)
+{
+	// Filing systems which return DT_UNKNOWN need asking before an entry can be told not to be a directory, and
+	// the metadata wanted comes back with the same lookup
+	have_metadata_flags resolve; resolve.value=wanted.value; resolve.have_type=resolve.have_ino=1;
+	for(auto &entry : chunk)
+		if(!entry.metadata_ready().have_type)
+			entry.fetch_metadata(h, resolve);
+	// Directories are checked once opened, as a mount point's st_ino here is that of what it covers
+	chunk.erase(std::remove_if(chunk.begin(), chunk.end(), [dev, &visited](directory_entry &entry) {
+		have_metadata_flags ready=entry.metadata_ready();
+		return ready.have_ino && ready.have_type && S_IFDIR!=entry.st_type() && !visited.insert(dev, entry.st_ino());
+	}), chunk.end());
+}
+
+size_t walk_tree(const std::filesystem::path &root, const walk_options &options, detail::walk_sink_t sink, void *ctx)
+{
+	tree_walker walker(options, sink, ctx);
+	return walker.walk(root);
+}
+
+} // namespace
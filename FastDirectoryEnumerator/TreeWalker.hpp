@@ -0,0 +1,145 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_TREEWALKER_H
+#define FASTDIRECTORYENUMERATOR_TREEWALKER_H
+
+#include "FastDirectoryEnumerator.hpp"
+
+namespace FastDirectoryEnumerator
+{
+	class inode_set;
+	class walked_directory;
+	namespace detail { typedef void (*walk_error_t)(void *, const walked_directory &, int); }
+
+	//! Options for `walk_tree()`
+	struct walk_options
+	{
+		size_t max_depth;              //!< Deepest subdirectory to descend into, zero being the root's entries only
+		bool one_filesystem;           //!< Don't descend into directories on a different device to the root (POSIX only)
+		have_metadata_flags metadata;  //!< Metadata to fetch for every entry beyond what enumeration returns
+		size_t threads;                //!< Worker threads, zero meaning one per hardware thread
+		size_t chunk_size;             //!< Entries enumerated per call to `enumerate_directory()`
+		bool batch_metadata;           //!< Fetch each chunk's metadata with the batch `fetch_metadata()`, rather than an entry at a time. Lookups served from cache are quicker an entry at a time, especially when many threads already overlap the waits for storage.
+		inode_set *visited;            //!< If set, inodes already in it are skipped, see `walk_tree()`
+		detail::walk_error_t on_error; //!< If set, called as `on_error(error_ctx, dir, errcode)` for each directory which could not be opened, see `walk_tree()`
+		void *error_ctx;               //!< Passed to `on_error`
+		walk_options() : max_depth((size_t)-1), one_filesystem(false), threads(0), chunk_size(4096), batch_metadata(true), visited(nullptr), on_error(nullptr), error_ctx(nullptr) { metadata.value=0; }
+	};
+
+	/*! \brief A directory being walked by `walk_tree()`.
+
+	Each directory keeps its parent alive, so the full path of any directory can be reconstructed by following
+	the parent chain without every entry needing to carry one. The sink may hang its own per-directory state
+	off `context()`.
+	*/
+	class FASTDIRECTORYENUMERATOR_API walked_directory
+	{
+		std::shared_ptr<const walked_directory> _parent;
+		std::filesystem::path::string_type _leafname;
+		size_t _depth;
+		mutable void *_context;
+	public:
+		walked_directory(std::shared_ptr<const walked_directory> parent, std::filesystem::path::string_type leafname, size_t depth)
+			: _parent(std::move(parent)), _leafname(std::move(leafname)), _depth(depth), _context(nullptr) { }
+		//! The directory containing this one, null for the root of the walk
+		const walked_directory *parent() const BOOST_NOEXCEPT_OR_NOTHROW { return _parent.get(); }
+		//! The leafname of this directory. For the root of the walk, the path it was given as.
+		const std::filesystem::path::string_type &leafname() const BOOST_NOEXCEPT_OR_NOTHROW { return _leafname; }
+		//! How many levels below the root of the walk this directory is
+		size_t depth() const BOOST_NOEXCEPT_OR_NOTHROW { return _depth; }
+		//! Reconstructs the full path of this directory from the parent chain
+		std::filesystem::path path() const;
+		//! Whatever the sink last set with `set_context()`, null until then
+		void *context() const BOOST_NOEXCEPT_OR_NOTHROW { return _context; }
+		/*! \brief Lets the sink associate its own state with this directory.
+
+		Only the thread delivering this directory's entries may set it. As a directory's entries are all delivered
+		before any of its subdirectories are queued, anything set while delivering them may be read from the
+		sinks of its subdirectories on any thread.
+		*/
+		void set_context(void *context) const BOOST_NOEXCEPT_OR_NOTHROW { _context=context; }
+	};
+
+	namespace detail { typedef bool (*walk_sink_t)(void *, const walked_directory &, directory_entry &); }
+	extern FASTDIRECTORYENUMERATOR_API size_t walk_tree(const std::filesystem::path &root, const walk_options &options, detail::walk_sink_t sink, void *ctx);
+	/*! \brief Walks the tree of directories under root in parallel, calling sink for every entry found.
+
+	Subdirectories are opened relative to their parent's fd and spread across a work stealing pool of
+	`options.threads` worker threads. `sink(const walked_directory &dir, directory_entry &entry)` is called
+	concurrently from the worker threads, though all the entries of any one directory are delivered by one
+	thread in enumeration order. If entry is a directory, the sink returns false to not descend into it.
+	Symbolic links are never followed. Any exception thrown by the sink stops the walk and is rethrown.
+	Returns the number of entries delivered.
+
+	A directory which can't be opened, say for lack of permission or running out of fds or it being removed
+	since it was enumerated, is skipped along with everything under it. If `options.on_error` is set it is
+	called for each such directory from the worker thread which tried, with errno on POSIX or
+	`GetLastError()` on Windows, so a caller knows its results are short.
+
+	Ask for the metadata the sink needs in `options.metadata`, as it is then fetched relative to the open
+	directory. The `st_*()` accessors of entry otherwise look it up in the directory it was enumerated from,
+	which entry keeps a reference to, so they still work after the walk has moved on or the current directory
+	has changed. That costs a walk of the directory's absolute path each time, except on Linux where its fd is
+	kept in a per-thread cache, see `close_cached_directories()`.
+
+	If `options.visited` is set, every directory's (st_dev, st_ino) is added to it when opened, and a directory
+	already there is not walked again, which stops cycles made by bind mounts. Every other entry's st_ino,
+	which enumeration returns for free, is added with the st_dev of its directory, and an entry already there
+	is dropped before its metadata is fetched or the sink sees it, so each hard linked inode is delivered once.
+	Entries whose type enumeration couldn't tell, as on XFS without ftype and some NFS and FUSE filing
+	systems, are looked up first to find which are not directories.
+
+	\code
+	std::atomic<size_t> files(0);
+	walk_tree(_L("testdir"), walk_options(), [&files](const walked_directory &, directory_entry &entry) {
+		if(S_IFREG==entry.st_type()) ++files;
+		return true;
+	});
+	\endcode
+	*/
+	template<class F> inline size_t walk_tree(const std::filesystem::path &root, const walk_options &options, F &&sink)
+	{
+		typedef typename std::remove_reference<F>::type sink_type;
+		return walk_tree(root, options, [](void *ctx, const walked_directory &dir, directory_entry &entry) -> bool { return (*(sink_type *) ctx)(dir, entry); },
+			const_cast<void *>(static_cast<const void *>(std::addressof(sink))));
+	}
+
+	namespace detail
+	{
+		/*! \brief Drops the entries of chunk which `walk_tree()` would as repeats with `walk_options::visited` set.
+
+		chunk was enumerated from the open directory h on device dev. Every entry but a directory has its
+		(dev, st_ino) added to visited, and is removed from chunk if it was already there. Entries of unknown
+		type are first looked up relative to h, fetching the metadata wanted along with it.
+		*/
+		extern FASTDIRECTORYENUMERATOR_API void drop_visited(const enumeration_handle &h, uint64_t dev, std::vector<directory_entry> &chunk, inode_set &visited, have_metadata_flags wanted);
+
+		// Counts the directories a walk couldn't open, passing each on to whatever `on_error` options had before
+		class walk_error_counter
+		{
+			walk_error_t _next;
+			void *_next_ctx;
+			std::atomic<size_t> _count;
+			static void _report(void *ctx, const walked_directory &dir, int errcode)
+			{
+				walk_error_counter *self=(walk_error_counter *) ctx;
+				++self->_count;
+				if(self->_next)
+					self->_next(self->_next_ctx, dir, errcode);
+			}
+		public:
+			explicit walk_error_counter(walk_options &options) : _next(options.on_error), _next_ctx(options.error_ctx), _count(0)
+			{
+				options.on_error=&_report;
+				options.error_ctx=this;
+			}
+			size_t count() const BOOST_NOEXCEPT_OR_NOTHROW { return _count; }
+		};
+	}
+} // namespace
+
+#endif
@@ -0,0 +1,252 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#include "WatchedDirectory.hpp"
+#include <algorithm>
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+namespace FastDirectoryEnumerator
+{
+
+namespace
+{
+	inline bool operator!=(const timespec &a, const timespec &b) { return a.tv_sec!=b.tv_sec || a.tv_nsec!=b.tv_nsec; }
+}
+
+// Whether the metadata both have of the same entry differs the way diff_directories() calls modified
+static bool differs(directory_entry &b, directory_entry &a)
+{
+	// Only what both have is compared, so none of these accessors go to the kernel
+	have_metadata_flags both; both.value=b.metadata_ready().value&a.metadata_ready().value;
+	return (both.have_type && b.st_type()!=a.st_type())
+		|| (both.have_size && b.st_size()!=a.st_size())
+		|| (both.have_mtim && b.st_mtim()!=a.st_mtim())
+		|| (both.have_ctim && b.st_ctim()!=a.st_ctim());
+}
+
+watched_directory::~watched_directory()
+{
+#ifdef __linux__
+	if(-1!=_inotify)
+		::close(_inotify);
+#endif
+}
+
+std::unique_ptr<watched_directory> watched_directory::open(const std::filesystem::path &dir, have_metadata_flags wanted)
+{
+	std::unique_ptr<watched_directory> ret(new watched_directory);
+	wanted.have_ino=wanted.have_type=1;
+	ret->_wanted=wanted;
+	ret->_dir.reset(new enumeration_handle(dir, 0));
+	if(!ret->_dir->is_open())
+		return nullptr;
+#ifdef __linux__
+	// Watch before enumerating, so nothing changed during the enumeration is missed
+	if(-1!=(ret->_inotify=inotify_init1(IN_NONBLOCK|IN_CLOEXEC)))
+	{
+		if(-1==inotify_add_watch(ret->_inotify, dir.c_str(), IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_ATTRIB|IN_MODIFY|IN_CLOSE_WRITE
+			|IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR|IN_EXCL_UNLINK))
+		{
+			::close(ret->_inotify);
+			ret->_inotify=-1;
+		}
+	}
+#endif
+	auto h=begin_enumerate_directory(dir);
+	if(!h)
+		return nullptr;
+	std::vector<directory_entry> chunk;
+	while(enumerate_directory(*h, chunk, 4096))
+	{
+		fetch_metadata(*h, chunk, wanted);
+		for(auto &entry : chunk)
+			ret->_entries.insert(std::make_pair(entry.leafname.native(), std::move(entry)));
+	}
+	return ret;
+}
+
+size_t watched_directory::refresh(detail::watch_sink_t sink, void *ctx, int timeout_ms)
+{
+	if(!_valid)
+		return 0;
+#ifdef __linux__
+	if(-1!=_inotify)
+	{
+		if(timeout_ms)
+		{
+			pollfd pfd={ _inotify, POLLIN, 0 };
+			poll(&pfd, 1, timeout_ms);
+		}
+		// Drain the queue, noting each leafname mentioned once however many events it had
+		alignas(struct inotify_event) char buffer[65536];
+		std::vector<std::filesystem::path::string_type> names;
+		bool overflowed=false;
+		for(;;)
+		{
+			ssize_t bytes=::read(_inotify, buffer, sizeof(buffer));
+			if(bytes<=0)
+			{
+				if(-1==bytes && EINTR==errno)
+					continue;
+				break;
+			}
+			for(const char *p=buffer; p<buffer+bytes;)
+			{
+				const struct inotify_event *e=(const struct inotify_event *) p;
+				++_events;
+				if(e->mask&IN_Q_OVERFLOW)
+					overflowed=true;
+				else if(e->mask&(IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT))
+					_valid=false;
+				else if(e->len && !overflowed)
+					names.push_back(e->name);
+				p+=sizeof(struct inotify_event)+e->len;
+			}
+		}
+		if(overflowed && _valid)
+			return rescan(sink, ctx);
+		std::sort(names.begin(), names.end());
+		names.erase(std::unique(names.begin(), names.end()), names.end());
+		return _int_apply(names, sink, ctx);
+	}
+#else
+	(void) timeout_ms;
+#endif
+	return rescan(sink, ctx);
+}
+
+size_t watched_directory::_int_apply(const std::vector<std::filesystem::path::string_type> &names, detail::watch_sink_t sink, void *ctx)
+{
+	// Stat each leafname afresh and compare with what is held. Everything held is left in place until all
+	// the sinks have been called, as inserting into the map may rehash it.
+	std::vector<map_type::iterator> removed;
+	std::vector<directory_entry> added;
+	size_t count=0;
+	for(auto &name : names)
+	{
+		directory_entry e;
+		e.leafname=name;
+		e.fetch_metadata(*_dir, _wanted);
+		++_stats;
+		bool exists=!!e.have_metadata.have_ino;
+		auto it=_entries.find(name);
+		if(_entries.end()==it)
+		{
+			// Else created and deleted again between refreshes
+			if(exists)
+				added.push_back(std::move(e));
+		}
+		else if(!exists)
+			removed.push_back(it);
+		else if(it->second._ino!=e._ino)
+		{
+			// Something else was renamed over it
+			removed.push_back(it);
+			added.push_back(std::move(e));
+		}
+		else if(differs(it->second, e))
+		{
+			if(sink) sink(ctx, change_kind::modified, &it->second, &e);
+			it->second=std::move(e);
+			++count;
+		}
+	}
+	// An entry removed and another added with the same st_ino is a rename
+	std::vector<bool> paired(added.size(), false);
+	std::unordered_map<uint64_t, size_t> byino;
+	if(!removed.empty())
+		for(size_t n=added.size(); n-->0;)
+			byino[added[n]._ino]=n;
+	for(auto it : removed)
+	{
+		auto i=byino.find(it->second._ino);
+		if(byino.end()!=i && !paired[i->second])
+		{
+			paired[i->second]=true;
+			if(sink) sink(ctx, change_kind::renamed, &it->second, &added[i->second]);
+			if(sink && differs(it->second, added[i->second])) sink(ctx, change_kind::modified, &it->second, &added[i->second]);
+		}
+		else if(sink)
+			sink(ctx, change_kind::removed, &it->second, nullptr);
+		++count;
+	}
+	for(size_t n=0; n<added.size(); n++)
+		if(!paired[n])
+		{
+			if(sink) sink(ctx, change_kind::added, nullptr, &added[n]);
+			++count;
+		}
+	for(auto it : removed)
+		_entries.erase(it);
+	for(auto &e : added)
+	{
+		std::filesystem::path::string_type name(e.leafname.native());
+		_entries[std::move(name)]=std::move(e);
+	}
+	return count;
+}
+
+size_t watched_directory::rescan(detail::watch_sink_t sink, void *ctx)
+{
+	++_rescans;
+	auto h=begin_enumerate_directory(path());
+	if(!h)
+	{
+		_valid=false;
+		return 0;
+	}
+	packed_enumeration before;
+	std::vector<map_type::iterator> index;
+	before.reserve(_entries.size(), _entries.size()*16);
+	index.reserve(_entries.size());
+	for(auto it=_entries.begin(); it!=_entries.end(); ++it)
+	{
+		before.push_back(it->second);
+		index.push_back(it);
+	}
+	// As for _int_apply(), nothing held moves until the diff is done
+	std::vector<map_type::iterator> removed;
+	std::vector<directory_entry> added;
+	size_t count=0;
+	diff_directories(before, *h, _wanted, [&](change_kind kind, size_t b, directory_entry *after) {
+		directory_entry *held=(directory_change::no_index==b) ? nullptr : &index[b]->second;
+		if(sink) sink(ctx, kind, held, after);
+		++count;
+		switch(kind)
+		{
+		case change_kind::added:
+			added.push_back(*after);
+			break;
+		case change_kind::removed:
+			removed.push_back(index[b]);
+			break;
+		case change_kind::renamed:
+			removed.push_back(index[b]);
+			added.push_back(*after);
+			break;
+		case change_kind::modified:
+			// A rename already queued the fresh entry
+			if(index[b]->first==after->leafname.native())
+				*held=*after;
+			break;
+		}
+	});
+	for(auto it : removed)
+		_entries.erase(it);
+	for(auto &e : added)
+	{
+		std::filesystem::path::string_type name(e.leafname.native());
+		_entries[std::move(name)]=std::move(e);
+	}
+	return count;
+}
+
+} // namespace
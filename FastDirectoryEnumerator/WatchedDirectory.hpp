@@ -0,0 +1,116 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_WATCHEDDIRECTORY_H
+#define FASTDIRECTORYENUMERATOR_WATCHEDDIRECTORY_H
+
+#include "DirectoryDiff.hpp"
+#include <unordered_map>
+
+namespace FastDirectoryEnumerator
+{
+	namespace detail { typedef void (*watch_sink_t)(void *, change_kind, const directory_entry *, const directory_entry *); }
+
+	/*! \brief The entries of a directory kept up to date in memory as the directory changes.
+
+	The directory is enumerated once when opened. After that, on Linux, an inotify watch on the directory says
+	which leafnames were created, deleted, moved, written or had their attributes changed, and `refresh()`
+	stats just those, so keeping the entries current costs work in proportion to the changes rather than to
+	the size of the directory. Events are coalesced per leafname and the entries always taken from a fresh
+	stat, so the order events arrive in doesn't matter and a burst of writes to one file costs one stat. An
+	entry removed and another added with its `st_ino` in the same refresh is reported as a rename.
+
+	If the kernel's event queue overflows (`IN_Q_OVERFLOW`), the directory is enumerated afresh and diffed
+	against the entries held with `diff_directories()`, which brings them back in step. Elsewhere than Linux
+	every `refresh()` does this.
+
+	Not thread safe: one thread at a time may call `refresh()` and read the entries.
+	*/
+	class FASTDIRECTORYENUMERATOR_API watched_directory
+	{
+	public:
+		typedef std::unordered_map<std::filesystem::path::string_type, directory_entry> map_type;
+	private:
+		std::unique_ptr<enumeration_handle> _dir;  // for stats relative to the directory only
+		have_metadata_flags _wanted;
+		map_type _entries;
+		int _inotify;                              // -1 if not watching with inotify
+		bool _valid;
+		size_t _events, _stats, _rescans;
+		watched_directory() : _inotify(-1), _valid(true), _events(0), _stats(0), _rescans(0) { _wanted.value=0; }
+		watched_directory(const watched_directory &) = delete;
+		watched_directory &operator=(const watched_directory &) = delete;
+		size_t _int_apply(const std::vector<std::filesystem::path::string_type> &names, detail::watch_sink_t sink, void *ctx);
+	public:
+		~watched_directory();
+		/*! \brief Starts watching the directory dir, returning a null pointer if it could not be opened.
+
+		`st_ino` and `st_type` are always kept, plus any other metadata wanted, which is what a change to is
+		reported as a modification.
+		*/
+		static std::unique_ptr<watched_directory> open(const std::filesystem::path &dir, have_metadata_flags wanted);
+		//! \overload
+		static std::unique_ptr<watched_directory> open(const std::filesystem::path &dir)
+		{
+			have_metadata_flags wanted; wanted.value=0;
+			return open(dir, wanted);
+		}
+		/*! \brief Applies the changes made to the directory since the last refresh, returning how many were found.
+
+		If timeout_ms is not zero, first waits up to that long for a change, or forever if -1. Only when
+		watching with inotify, as otherwise there is nothing to wait on. Calls
+		`sink(change_kind kind, const directory_entry *before, const directory_entry *after)` for each change
+		before applying it, with before null if added and after null if removed.
+		*/
+		size_t refresh(detail::watch_sink_t sink, void *ctx, int timeout_ms=0);
+		//! \overload
+		size_t refresh(int timeout_ms=0) { return refresh(nullptr, nullptr, timeout_ms); }
+		//! \overload
+		template<class F> size_t refresh(F &&sink, int timeout_ms=0)
+		{
+			typedef typename std::remove_reference<F>::type sink_type;
+			return refresh([](void *ctx, change_kind kind, const directory_entry *b, const directory_entry *a) { (*(sink_type *) ctx)(kind, b, a); },
+				const_cast<void *>(static_cast<const void *>(std::addressof(sink))), timeout_ms);
+		}
+		//! Enumerates the directory afresh and diffs it against the entries held, calling sink for each change as `refresh()` does. Returns how many were found.
+		size_t rescan(detail::watch_sink_t sink, void *ctx);
+		//! \overload
+		size_t rescan() { return rescan(nullptr, nullptr); }
+		//! \overload
+		template<class F> size_t rescan(F &&sink)
+		{
+			typedef typename std::remove_reference<F>::type sink_type;
+			return rescan([](void *ctx, change_kind kind, const directory_entry *b, const directory_entry *a) { (*(sink_type *) ctx)(kind, b, a); },
+				const_cast<void *>(static_cast<const void *>(std::addressof(sink))));
+		}
+		//! False once the directory itself has been deleted or moved away, after which nothing more is applied
+		bool valid() const BOOST_NOEXCEPT_OR_NOTHROW { return _valid; }
+		//! True if changes come from inotify rather than rescanning
+		bool is_watching() const BOOST_NOEXCEPT_OR_NOTHROW { return _inotify!=-1; }
+		//! The fd to `poll()` for changes, or -1 if not watching with inotify
+		int native_handle() const BOOST_NOEXCEPT_OR_NOTHROW { return _inotify; }
+		//! The path of the directory
+		const std::filesystem::path &path() const BOOST_NOEXCEPT_OR_NOTHROW { return _dir->path(); }
+		//! The entries, keyed by leafname
+		const map_type &entries() const BOOST_NOEXCEPT_OR_NOTHROW { return _entries; }
+		//! The number of entries
+		size_t size() const BOOST_NOEXCEPT_OR_NOTHROW { return _entries.size(); }
+		//! The entry called leafname, or null if there is none
+		const directory_entry *find(const std::filesystem::path &leafname) const
+		{
+			auto it=_entries.find(leafname.native());
+			return _entries.end()==it ? nullptr : &it->second;
+		}
+		//! The number of inotify events read so far
+		size_t events() const BOOST_NOEXCEPT_OR_NOTHROW { return _events; }
+		//! The number of entries stat()ed because of events so far
+		size_t stats() const BOOST_NOEXCEPT_OR_NOTHROW { return _stats; }
+		//! The number of rescans done so far, because the event queue overflowed or by `rescan()`
+		size_t rescans() const BOOST_NOEXCEPT_OR_NOTHROW { return _rescans; }
+	};
+} // namespace
+
+#endif
@@ -0,0 +1,141 @@
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Oct 2026
+*/
+
+#ifndef FASTDIRECTORYENUMERATOR_IO_URING_H
+#define FASTDIRECTORYENUMERATOR_IO_URING_H
+
+/*! \file io_uring.hpp
+\brief A minimal io_uring submission/completion ring driven by raw syscalls, so there is no liburing dependency.
+Linux only, and only defines FASTDIRECTORYENUMERATOR_HAVE_IO_URING if the kernel headers know `IORING_OP_STATX`.
+*/
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#ifdef IORING_FEAT_RW_CUR_POS // Linux 5.6, which also added IORING_OP_STATX
+#define FASTDIRECTORYENUMERATOR_HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+
+namespace FastDirectoryEnumerator
+{
+	namespace detail
+	{
+		class io_uring_ring
+		{
+			int fd;
+			unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+			unsigned *cq_head, *cq_tail, *cq_mask;
+			io_uring_sqe *sqes;
+			io_uring_cqe *cqes;
+			void *sq_ring, *cq_ring;
+			size_t sq_ring_size, cq_ring_size, sqes_size;
+			unsigned _entries;
+			unsigned sqe_tail;   // sqes handed out but not yet made visible to the kernel end here
+			io_uring_ring(const io_uring_ring &) = delete;
+			io_uring_ring &operator=(const io_uring_ring &) = delete;
+		public:
+			//! Sets up a ring of at least entries submissions. Check `is_open()` for success.
+			explicit io_uring_ring(unsigned entries) : fd(-1), sqes(nullptr), sq_ring(MAP_FAILED), cq_ring(MAP_FAILED), _entries(0), sqe_tail(0)
+			{
+				io_uring_params p;
+				memset(&p, 0, sizeof(p));
+				if((fd=(int) syscall(__NR_io_uring_setup, entries, &p))<0)
+				{
+					fd=-1;
+					return;
+				}
+				sq_ring_size=p.sq_off.array+p.sq_entries*sizeof(unsigned);
+				cq_ring_size=p.cq_off.cqes+p.cq_entries*sizeof(io_uring_cqe);
+				sqes_size=p.sq_entries*sizeof(io_uring_sqe);
+				sq_ring=mmap(nullptr, sq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+				cq_ring=mmap(nullptr, cq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+				void *_sqes=mmap(nullptr, sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+				if(MAP_FAILED==sq_ring || MAP_FAILED==cq_ring || MAP_FAILED==_sqes)
+				{
+					if(MAP_FAILED!=_sqes) munmap(_sqes, sqes_size);
+					close();
+					return;
+				}
+				sqes=(io_uring_sqe *) _sqes;
+				char *sq=(char *) sq_ring, *cq=(char *) cq_ring;
+				sq_head=(unsigned *)(sq+p.sq_off.head);
+				sq_tail=(unsigned *)(sq+p.sq_off.tail);
+				sq_mask=(unsigned *)(sq+p.sq_off.ring_mask);
+				sq_array=(unsigned *)(sq+p.sq_off.array);
+				cq_head=(unsigned *)(cq+p.cq_off.head);
+				cq_tail=(unsigned *)(cq+p.cq_off.tail);
+				cq_mask=(unsigned *)(cq+p.cq_off.ring_mask);
+				cqes=(io_uring_cqe *)(cq+p.cq_off.cqes);
+				_entries=p.sq_entries;
+				sqe_tail=*sq_tail;
+			}
+			~io_uring_ring() { close(); }
+			void close()
+			{
+				if(sqes) munmap(sqes, sqes_size);
+				if(MAP_FAILED!=cq_ring) munmap(cq_ring, cq_ring_size);
+				if(MAP_FAILED!=sq_ring) munmap(sq_ring, sq_ring_size);
+				if(fd>=0) ::close(fd);
+				sqes=nullptr;
+				sq_ring=cq_ring=MAP_FAILED;
+				fd=-1;
+			}
+			//! True if the ring was set up
+			bool is_open() const { return fd>=0; }
+			//! The number of submissions the ring holds
+			unsigned entries() const { return _entries; }
+			//! True if the kernel supports the IORING_OP_* op
+			bool supports(unsigned op) const
+			{
+				size_t len=sizeof(io_uring_probe)+256*sizeof(io_uring_probe_op);
+				io_uring_probe *probe=(io_uring_probe *) calloc(1, len);
+				if(!probe) return false;
+				bool ret=syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256)>=0
+					&& op<=probe->last_op && (probe->ops[op].flags&IO_URING_OP_SUPPORTED);
+				free(probe);
+				return ret;
+			}
+			//! Returns a zeroed submission to fill in, or null if the ring is full
+			io_uring_sqe *get_sqe()
+			{
+				unsigned head=__atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+				if(sqe_tail-head>=_entries)
+					return nullptr;
+				unsigned idx=sqe_tail&*sq_mask;
+				sq_array[idx]=idx;
+				io_uring_sqe *sqe=&sqes[idx];
+				memset(sqe, 0, sizeof(*sqe));
+				++sqe_tail;
+				return sqe;
+			}
+			//! The number of filled submissions the kernel has yet to take off the ring
+			unsigned unsubmitted() const { return sqe_tail-__atomic_load_n(sq_head, __ATOMIC_ACQUIRE); }
+			//! Submits all filled submissions and waits for at least wait_nr completions. Returns -1 on failure.
+			int submit(unsigned wait_nr=0)
+			{
+				unsigned tosubmit=sqe_tail-*sq_tail;
+				__atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+				return (int) syscall(__NR_io_uring_enter, fd, tosubmit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			}
+			//! Calls f(const io_uring_cqe &) for each completion ready, returning how many there were
+			template<class F> unsigned reap(F &&f)
+			{
+				unsigned head=*cq_head, tail=__atomic_load_n(cq_tail, __ATOMIC_ACQUIRE), count=0;
+				for(; head!=tail; ++head, ++count)
+					f(cqes[head&*cq_mask]);
+				__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+				return count;
+			}
+		};
+	}
+}
+#endif
+#endif
+
+#endif
@@ -1,227 +1,1634 @@
-/* FastDirectoryEnumerator
-Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
-(C) 2013 Niall Douglas http://www.nedprod.com/
-File created: Aug 2013
-*/
-
-#define NUMBER_OF_FILES 100000
-
-#define _CRT_SECURE_NO_WARNINGS
-
-#include "../FastDirectoryEnumerator/FastDirectoryEnumerator.hpp"
-#include <unordered_map>
-#include <chrono>
-#include <iostream>
-
-#include <fcntl.h>
-#include <sys/stat.h>
-#ifdef WIN32
-#include <io.h>
-#include <direct.h>
-#define POSIX_MKDIR(path, mode) _wmkdir(path)
-#define POSIX_RMDIR _wrmdir
-#define POSIX_STAT _wstat64
-#define POSIX_STAT_STRUCT struct __stat64
-#define POSIX_S_ISREG(m) ((m) & _S_IFREG)
-#define POSIX_S_ISDIR(m) ((m) & _S_IFDIR)
-#define POSIX_OPEN _wopen
-#define POSIX_CLOSE _close
-#define POSIX_UNLINK _wunlink
-#define POSIX_FSYNC _commit
-#define _L(f) L##f
-#define POSIX_SPRINTF swprintf
-extern "C" int __stdcall CreateSymbolicLinkW(wchar_t *lpSymlinkFileName, wchar_t *lpTargetFileName, int dwFlags);
-#else
-#include <sys/uio.h>
-#include <limits.h>
-#define POSIX_MKDIR mkdir
-#define POSIX_RMDIR ::rmdir
-#define POSIX_STAT_STRUCT struct stat 
-#define POSIX_STAT stat
-#define POSIX_OPEN open
-#define POSIX_CLOSE ::close
-#define POSIX_UNLINK unlink
-#define POSIX_FSYNC fsync
-#define POSIX_S_ISREG S_ISREG
-#define POSIX_S_ISDIR S_ISDIR
-#define _L(f) f
-#define POSIX_SPRINTF sprintf
-#endif
-
-std::ostream &operator<<(std::ostream &s, const FastDirectoryEnumerator::timespec &ts)
-{
-	char buf[32];
-    struct tm *t;
-    size_t len=sizeof(buf);
-    int ret;
-
-    tzset();
-    if ((t=localtime(&(ts.tv_sec))) == NULL)
-    {
-    	s << "<bad timespec>";
-        return s;
-    }
-
-    ret = strftime(buf, len, "%Y-%m-%d %H:%M:%S", t);
-    if (ret == 0)
-    {
-    	s << "<bad timespec>";
-        return s;
-    }
-    len -= ret - 1;
-
-    sprintf(&buf[strlen(buf)], ".%09ld", ts.tv_nsec);
-    s << buf;
-
-    return s;
-}
-
-int main(void)
-{
-	using namespace FastDirectoryEnumerator;
-	namespace chrono = std::chrono;
-    typedef chrono::duration<double, std::ratio<1>> secs_type;
-
-	std::unordered_map<std::filesystem::path::string_type, bool> tocheck;
-	POSIX_MKDIR(_L("testdir"), 0x1f8/*770*/);
-
-	// Create many files
-	std::cout << "Creating " << NUMBER_OF_FILES << " files. This may take a while ..." << std::endl;
-	std::filesystem::path::string_type name(_L("testdir/"));
-	for(size_t n=0; n<NUMBER_OF_FILES; n++)
-	{
-		std::filesystem::path::value_type buffer[16];
-		POSIX_SPRINTF(buffer, _L("%012u"), (unsigned) n);
-		std::filesystem::path::string_type _buffer(buffer, 12);
-		tocheck.insert(std::make_pair(_buffer, false));
-		name.replace(8, std::string::npos, _buffer);
-		int fh=POSIX_OPEN(name.c_str(), O_CREAT|O_RDWR, 0x1b0/*660*/);
-		if(-1==fh) abort();
-		POSIX_CLOSE(fh);
-	}
-#ifdef WIN32
-	CreateSymbolicLinkW(_L("testdir\\link"), _L("000000000000"), 0);
-#else
-	symlink("000000000000", "testdir/link");
-#endif
-
-	// Enumerate
-	std::cout << "Enumerating " << NUMBER_OF_FILES << " files as filenames. This hopefully will be exceptionally swift ..." << std::endl;
-    auto begin=chrono::high_resolution_clock::now();
-	void *h=begin_enumerate_directory(_L("testdir"));
-	std::unique_ptr<std::vector<directory_entry>> enumeration, chunk;
-	while((chunk=enumerate_directory(h, NUMBER_OF_FILES, std::filesystem::path(), true)))
-		if(!enumeration)
-			enumeration=std::move(chunk);
-		else
-			enumeration->insert(enumeration->end(), std::make_move_iterator(chunk->begin()), std::make_move_iterator(chunk->end()));
-	end_enumerate_directory(h);
-    auto end=chrono::high_resolution_clock::now();
-	if(!enumeration)
-		std::cerr << "ERROR: enumeration failed!" << std::endl;
-    auto diff=chrono::duration_cast<secs_type>(end-begin);
-    std::cout << "It took " << diff.count() << " secs to enumerate " << NUMBER_OF_FILES << " entries which is " << NUMBER_OF_FILES/diff.count() << " entries per second." << std::endl;
-    std::cout << "Filename enumeration returns information 0x" << std::hex << (*enumeration)[0].metadata_ready().value << std::dec << std::endl;
-	enumeration.release();
-
-	// Enumerate
-	std::cout << "Enumerating " << NUMBER_OF_FILES << " files. This hopefully will be exceptionally swift ..." << std::endl;
-    begin=chrono::high_resolution_clock::now();
-	h=begin_enumerate_directory(_L("testdir"));
-	while((chunk=enumerate_directory(h, NUMBER_OF_FILES)))
-		if(!enumeration)
-			enumeration=std::move(chunk);
-		else
-			enumeration->insert(enumeration->end(), std::make_move_iterator(chunk->begin()), std::make_move_iterator(chunk->end()));
-	end_enumerate_directory(h);
-    end=chrono::high_resolution_clock::now();
-	if(!enumeration)
-		std::cerr << "ERROR: enumeration failed!" << std::endl;
-    diff=chrono::duration_cast<secs_type>(end-begin);
-    std::cout << "It took " << diff.count() << " secs to enumerate " << NUMBER_OF_FILES << " entries which is " << NUMBER_OF_FILES/diff.count() << " entries per second." << std::endl;
-    std::cout << "Enumeration returns information 0x" << std::hex << (*enumeration)[0].metadata_ready().value << std::dec << std::endl;
-
-	// Enumerate
-	std::cout << "Pulling all metadata for " << NUMBER_OF_FILES << " files. This may take a while ..." << std::endl;
-    begin=chrono::high_resolution_clock::now();
-	if(enumeration)
-	{
-		have_metadata_flags maximum; maximum.value=(unsigned)-1;
-		for(auto &entry : *enumeration)
-		{
-			entry.fetch_metadata(_L("testdir"), maximum);
-		}
-	}
-    end=chrono::high_resolution_clock::now();
-    diff=chrono::duration_cast<secs_type>(end-begin);
-    std::cout << "It took " << diff.count() << " secs to get maximum metadata for " << NUMBER_OF_FILES << " entries which is " << NUMBER_OF_FILES/diff.count() << " entries per second." << std::endl;
-    std::cout << "Enumeration returns information 0x" << std::hex << (*enumeration)[0].metadata_ready().value << std::dec << std::endl;
-    std::cout << "System max information ought to be 0x" << std::hex << directory_entry::metadata_supported().value << std::dec << std::endl;
-
-    if(enumeration)
-    {
-    	for(auto &entry : *enumeration)
-		{
-			if(entry.name()==_L("000000000000") || entry.name()==_L("link"))
-			{
-		    	std::cout << "Entry is a ";
-				if(entry.st_type() & S_IFLNK)
-					std::cout << "link";
-				else
-					std::cout << "file";
-				std::cout << " called " << entry.name() << " and it has the following information:" << std::endl;
-#define PRINT_FIELD(field) \
-    			std::cout << "  st_" #field ": "; if(entry.metadata_ready().have_##field) std::cout << entry.st_##field(); else std::cout << "unknown"; std::cout << std::endl
-    			PRINT_FIELD(dev);
-    			PRINT_FIELD(ino);
-    			PRINT_FIELD(type);
-    			PRINT_FIELD(mode);
-    			PRINT_FIELD(nlink);
-    			PRINT_FIELD(uid);
-    			PRINT_FIELD(gid);
-    			PRINT_FIELD(rdev);
-    			PRINT_FIELD(atim);
-    			PRINT_FIELD(mtim);
-    			PRINT_FIELD(ctim);
-    			PRINT_FIELD(size);
-    			PRINT_FIELD(allocated);
-    			PRINT_FIELD(blocks);
-    			PRINT_FIELD(blksize);
-    			PRINT_FIELD(flags);
-    			PRINT_FIELD(gen);
-    			PRINT_FIELD(birthtim);
-			}
-		}
-    }
-
-	// Check results
-	std::cout << "Checking enumeration and deleting " << NUMBER_OF_FILES << " files. This may also take a while ..." << std::endl;
-	if(enumeration)
-	{
-		if(enumeration->size()!=NUMBER_OF_FILES)
-			std::cerr << "ERROR: enumeration returned " << enumeration->size() << " items when it should have returned " << NUMBER_OF_FILES << " items." << std::endl;
-		for(auto &entry : *enumeration)
-		{
-			auto it=tocheck.find(entry.name().native());
-			if(it==tocheck.end())
-				std::cerr << "ERROR: '" << entry.name() << "' shouldn't be there!" << std::endl;
-			else if(it->second)
-				std::cerr << "ERROR: '" << entry.name() << "' found more than once!" << std::endl;
-			else
-				it->second=true;
-			name.replace(8, std::string::npos, entry.name().native());
-			POSIX_UNLINK(name.c_str());
-		}
-		for(auto &item : tocheck)
-			if(!item.second)
-				std::cerr << "ERROR: '" << std::filesystem::path(item.first) << "' was not enumerated!" << std::endl;
-	}
-
-	// Delete directory
-	POSIX_RMDIR(_L("testdir"));
-#ifdef _MSC_VER
-	std::cout << "Press Return to exit ..." << std::endl;
-	getchar();
-#endif
-	return 0;
-}
+/* FastDirectoryEnumerator
+Enumerates very, very large directories quickly by directly using kernel syscalls. For POSIX and Windows.
+(C) 2013 Niall Douglas http://www.nedprod.com/
+File created: Aug 2013
+*/
+
+#define NUMBER_OF_FILES 100000
+#define CHUNK_SIZE 1000
+#define DIFF_ENTRIES 10000000
+#define WATCH_FILES 20000
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../FastDirectoryEnumerator/FastDirectoryEnumerator.hpp"
+#include "../FastDirectoryEnumerator/TreeWalker.hpp"
+#include "../FastDirectoryEnumerator/DirectorySnapshot.hpp"
+#include "../FastDirectoryEnumerator/DirectoryDiff.hpp"
+#include "../FastDirectoryEnumerator/WatchedDirectory.hpp"
+#include "../FastDirectoryEnumerator/AsyncEnumeration.hpp"
+#include "../FastDirectoryEnumerator/PrefetchingEnumerator.hpp"
+#include "../FastDirectoryEnumerator/DiskUsage.hpp"
+#include "../FastDirectoryEnumerator/InodeSet.hpp"
+#include "../FastDirectoryEnumerator/DuplicateFinder.hpp"
+#include <unordered_map>
+#include <chrono>
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <random>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <io.h>
+#include <direct.h>
+#define POSIX_MKDIR(path, mode) _wmkdir(path)
+#define POSIX_RMDIR _wrmdir
+#define POSIX_STAT _wstat64
+#define POSIX_STAT_STRUCT struct __stat64
+#define POSIX_S_ISREG(m) ((m) & _S_IFREG)
+#define POSIX_S_ISDIR(m) ((m) & _S_IFDIR)
+#define POSIX_OPEN _wopen
+#define POSIX_CLOSE _close
+#define POSIX_UNLINK _wunlink
+#define POSIX_FSYNC _commit
+#define _L(f) L##f
+#define POSIX_SPRINTF swprintf
+extern "C" int __stdcall CreateSymbolicLinkW(wchar_t *lpSymlinkFileName, wchar_t *lpTargetFileName, int dwFlags);
+#else
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <limits.h>
+#include <fnmatch.h>
+#ifdef __linux__
+#include <sys/mount.h>
+#endif
+#define POSIX_MKDIR mkdir
+#define POSIX_RMDIR ::rmdir
+#define POSIX_STAT_STRUCT struct stat 
+#define POSIX_STAT stat
+#define POSIX_OPEN open
+#define POSIX_CLOSE ::close
+#define POSIX_UNLINK unlink
+#define POSIX_FSYNC fsync
+#define POSIX_S_ISREG S_ISREG
+#define POSIX_S_ISDIR S_ISDIR
+#define _L(f) f
+#define POSIX_SPRINTF sprintf
+#endif
+
+std::ostream &operator<<(std::ostream &s, const FastDirectoryEnumerator::timespec &ts)
+{
+	char buf[32];
+    struct tm *t;
+    size_t len=sizeof(buf);
+    int ret;
+
+    tzset();
+    if ((t=localtime(&(ts.tv_sec))) == NULL)
+    {
+    	s << "<bad timespec>";
+        return s;
+    }
+
+    ret = strftime(buf, len, "%Y-%m-%d %H:%M:%S", t);
+    if (ret == 0)
+    {
+    	s << "<bad timespec>";
+        return s;
+    }
+    len -= ret - 1;
+
+    sprintf(&buf[strlen(buf)], ".%09ld", ts.tv_nsec);
+    s << buf;
+
+    return s;
+}
+
+// Creates a tree levels deep of dirs directories per directory, with files files in each of the deepest, returning the number of entries
+static size_t create_tree(const std::filesystem::path &root, size_t dirs, size_t levels, size_t files)
+{
+	size_t entries=0;
+	std::filesystem::create_directories(root);
+	for(size_t d=0; d<dirs && levels; d++)
+	{
+		std::filesystem::path::value_type buffer[16];
+		POSIX_SPRINTF(buffer, _L("d%04u"), (unsigned) d);
+		entries+=1+create_tree(root/buffer, dirs, levels-1, files);
+	}
+	for(size_t n=0; n<files && !levels; n++)
+	{
+		std::filesystem::path::value_type buffer[16];
+		POSIX_SPRINTF(buffer, _L("%012u"), (unsigned) n);
+		int fh=POSIX_OPEN((root/buffer).c_str(), O_CREAT|O_RDWR, 0x1b0/*660*/);
+		if(-1==fh) abort();
+		POSIX_CLOSE(fh);
+		entries++;
+	}
+	return entries;
+}
+
+// Creates the file path holding bytes bytes, or appends them if it exists
+static void append_file(const std::filesystem::path &path, size_t bytes)
+{
+	int fh=POSIX_OPEN(path.c_str(), O_CREAT|O_WRONLY|O_APPEND, 0x1b0/*660*/);
+	if(-1==fh) abort();
+	for(size_t n=0; n<bytes; n++)
+		if(1!=write(fh, "x", 1)) abort();
+	POSIX_CLOSE(fh);
+}
+
+// Creates the file path holding buffer
+static void write_file(const std::filesystem::path &path, const std::vector<char> &buffer)
+{
+	int fh=POSIX_OPEN(path.c_str(), O_CREAT|O_WRONLY|O_TRUNC, 0x1b0/*660*/);
+	if(-1==fh) abort();
+	if((int) buffer.size()!=write(fh, buffer.data(), (unsigned) buffer.size())) abort();
+	POSIX_CLOSE(fh);
+}
+
+// Returns the contents of the file path
+static std::vector<char> read_file(const std::filesystem::path &path)
+{
+	std::vector<char> buffer((size_t) std::filesystem::file_size(path));
+	int fh=POSIX_OPEN(path.c_str(), O_RDONLY, 0);
+	if(-1==fh) abort();
+	if((int) buffer.size()!=read(fh, buffer.data(), (unsigned) buffer.size())) abort();
+	POSIX_CLOSE(fh);
+	return buffer;
+}
+
+// Drops the kernel's page, dentry and inode caches so lookups go to storage, returning false if not permitted
+static bool drop_caches()
+{
+#ifdef __linux__
+	sync();
+	int fh=open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if(-1==fh) return false;
+	bool ok=(1==write(fh, "3", 1));
+	close(fh);
+	return ok;
+#else
+	return false;
+#endif
+}
+
+// Runs du -s on root, returning how many bytes it says are allocated or zero if it couldn't be run
+static uint64_t run_du(const char *root)
+{
+#ifdef WIN32
+	return 0;
+#else
+	std::string cmd("du -s -B1 ");
+	cmd.append(root);
+	FILE *p=popen(cmd.c_str(), "r");
+	if(!p) return 0;
+	unsigned long long bytes=0;
+	if(1!=fscanf(p, "%llu", &bytes)) bytes=0;
+	pclose(p);
+	return bytes;
+#endif
+}
+
+// Stands in for real work per entry, like hashing it into a database, returning a checksum
+static uint64_t busy_work(FastDirectoryEnumerator::directory_entry &entry, size_t rounds)
+{
+	uint64_t ret=14695981039346656037ULL;
+	std::filesystem::path::string_type name(entry.name().native());
+	for(size_t n=0; n<rounds; n++)
+		for(auto c : name)
+			ret=(ret^(uint64_t) c)*1099511628211ULL;
+	return ret+(entry.metadata_ready().have_size ? (uint64_t) entry.st_size() : 0);
+}
+
+#ifdef FASTDIRECTORYENUMERATOR_HAVE_COROUTINES
+// A single threaded executor, as an event loop would be, which the pool threads post resumptions to
+struct local_executor
+{
+	std::mutex lock;
+	std::condition_variable cv;
+	std::deque<std::coroutine_handle<>> ready;
+	std::thread::id thread;
+	size_t resumed=0;
+	void post(std::coroutine_handle<> h)
+	{
+		{
+			std::lock_guard<std::mutex> g(lock);
+			ready.push_back(h);
+		}
+		cv.notify_one();
+	}
+	// Resumes what is posted on this thread until done() is true
+	template<class F> void run_until(F &&done)
+	{
+		thread=std::this_thread::get_id();
+		while(!done())
+		{
+			std::coroutine_handle<> h;
+			{
+				std::unique_lock<std::mutex> g(lock);
+				if(!cv.wait_for(g, std::chrono::seconds(10), [this] { return !ready.empty(); }))
+					return;
+				h=ready.front();
+				ready.pop_front();
+			}
+			++resumed;
+			h.resume();
+		}
+	}
+};
+// A coroutine nobody awaits
+struct detached_task
+{
+	struct promise_type
+	{
+		detached_task get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() { }
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+struct scan_totals
+{
+	size_t active=0, maxactive=0, finished=0, entries=0, unsized=0, wrongthread=0;
+};
+static detached_task async_scan(local_executor &loop, std::filesystem::path path, FastDirectoryEnumerator::have_metadata_flags wanted, scan_totals &totals)
+{
+	using namespace FastDirectoryEnumerator;
+	totals.maxactive=std::max(totals.maxactive, ++totals.active);
+	auto chunks=async_enumerate_directory(std::move(path), wanted, async_executor::of(loop));
+	while(std::vector<directory_entry> *chunk=co_await chunks.next())
+	{
+		if(std::this_thread::get_id()!=loop.thread)
+			++totals.wrongthread;
+		for(auto &entry : *chunk)
+			if(!entry.metadata_ready().have_size)
+				++totals.unsized;
+		totals.entries+=chunk->size();
+	}
+	--totals.active;
+	++totals.finished;
+}
+static detached_task async_cancelled_scan(local_executor &loop, std::stop_source &stop, size_t &entries, bool &finished)
+{
+	using namespace FastDirectoryEnumerator;
+	have_metadata_flags wanted; wanted.value=0;
+	auto items=async_enumerate_directory_entries(_L("testdir"), wanted, async_executor::of(loop), stop.get_token());
+	while(co_await items.next())
+		if(1000==++entries)
+			stop.request_stop();
+	finished=true;
+}
+#endif
+
+int main(void)
+{
+	using namespace FastDirectoryEnumerator;
+	namespace chrono = std::chrono;
+    typedef chrono::duration<double, std::ratio<1>> secs_type;
+
+	std::unordered_map<std::filesystem::path::string_type, bool> tocheck;
+	POSIX_MKDIR(_L("testdir"), 0x1f8/*770*/);
+
+	// Create many files
+	std::cout << "Creating " << NUMBER_OF_FILES << " files. This may take a while ..." << std::endl;
+	std::filesystem::path::string_type name(_L("testdir/"));
+	for(size_t n=0; n<NUMBER_OF_FILES; n++)
+	{
+		std::filesystem::path::value_type buffer[16];
+		POSIX_SPRINTF(buffer, _L("%012u"), (unsigned) n);
+		std::filesystem::path::string_type _buffer(buffer, 12);
+		tocheck.insert(std::make_pair(_buffer, false));
+		name.replace(8, std::string::npos, _buffer);
+		int fh=POSIX_OPEN(name.c_str(), O_CREAT|O_RDWR, 0x1b0/*660*/);
+		if(-1==fh) abort();
+		POSIX_CLOSE(fh);
+	}
+#ifdef WIN32
+	CreateSymbolicLinkW(_L("testdir\\link"), _L("000000000000"), 0);
+#else
+	symlink("000000000000", "testdir/link");
+#endif
+
+	// Enumerate
+	std::cout << "Enumerating " << NUMBER_OF_FILES << " files as filenames. This hopefully will be exceptionally swift ..." << std::endl;
+    auto begin=chrono::high_resolution_clock::now();
+	auto h=begin_enumerate_directory(_L("testdir"));
+	std::unique_ptr<std::vector<directory_entry>> enumeration, chunk;
+	while((chunk=enumerate_directory(*h, NUMBER_OF_FILES, std::filesystem::path(), true)))
+		if(!enumeration)
+			enumeration=std::move(chunk);
+		else
+			enumeration->insert(enumeration->end(), std::make_move_iterator(chunk->begin()), std::make_move_iterator(chunk->end()));
+	h.reset();
+    auto end=chrono::high_resolution_clock::now();
+	if(!enumeration)
+		std::cerr << "ERROR: enumeration failed!" << std::endl;
+    auto diff=chrono::duration_cast<secs_type>(end-begin);
+    std::cout << "It took " << diff.count() << " secs to enumerate " << NUMBER_OF_FILES << " entries which is " << NUMBER_OF_FILES/diff.count() << " entries per second." << std::endl;
+    std::cout << "Filename enumeration returns information 0x" << std::hex << (*enumeration)[0].metadata_ready().value << std::dec << std::endl;
+	enumeration.release();
+
+	// Enumerate
+	std::cout << "Enumerating " << NUMBER_OF_FILES << " files. This hopefully will be exceptionally swift ..." << std::endl;
+    begin=chrono::high_resolution_clock::now();
+	h=begin_enumerate_directory(_L("testdir"));
+	while((chunk=enumerate_directory(*h, NUMBER_OF_FILES)))
+		if(!enumeration)
+			enumeration=std::move(chunk);
+		else
+			enumeration->insert(enumeration->end(), std::make_move_iterator(chunk->begin()), std::make_move_iterator(chunk->end()));
+	h.reset();
+    end=chrono::high_resolution_clock::now();
+	if(!enumeration)
+		std::cerr << "ERROR: enumeration failed!" << std::endl;
+    diff=chrono::duration_cast<secs_type>(end-begin);
+    std::cout << "It took " << diff.count() << " secs to enumerate " << NUMBER_OF_FILES << " entries which is " << NUMBER_OF_FILES/diff.count() << " entries per second." << std::endl;
+    std::cout << "Enumeration returns information 0x" << std::hex << (*enumeration)[0].metadata_ready().value << std::dec << std::endl;
+    // Only the name, inode and type are stored inline, the rest of the metadata being allocated when first fetched
+    std::cout << "Each directory_entry takes " << sizeof(directory_entry) << " bytes plus its leafname if too long to store inline." << std::endl;
+
+	// Count syscalls
+	std::cout << "Enumerating " << NUMBER_OF_FILES << " files in chunks of " << CHUNK_SIZE << " to count syscalls ..." << std::endl;
+	{
+		// Before enumeration_handle, each call allocated a kernel buffer of maxitems 24 byte legacy dirents
+		size_t buffersizes[2]={ 24*CHUNK_SIZE, enumeration_handle::default_buffer_size };
+		for(size_t buffersize : buffersizes)
+		{
+			std::vector<directory_entry> out;
+			size_t items=0;
+			begin=chrono::high_resolution_clock::now();
+			h=begin_enumerate_directory(_L("testdir"), buffersize);
+			while(enumerate_directory(*h, out, CHUNK_SIZE))
+				items+=out.size();
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "With a " << h->kernel_buffer_size() << " byte buffer it took " << h->kernel_calls() << " syscalls (" << h->kernel_calls()*1000000.0/items
+				<< " per 1M entries) and " << diff.count() << " secs to enumerate " << items << " entries." << std::endl;
+			h.reset();
+		}
+	}
+
+	// Statistics
+	std::cout << "Enumerating and looking up the size of " << NUMBER_OF_FILES << " files " << (stats_enabled() ? "keeping" : "without keeping") << " statistics ..." << std::endl;
+	{
+		static const int passes=5;
+		secs_type enumerating(1e9), lookingup(1e9);
+		enumeration_stats before=process_stats(), handlestats;
+		size_t calls=0;
+		std::vector<directory_entry> out, all;
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=1;
+		for(int pass=0; pass<passes; pass++)
+		{
+			all.clear();
+			begin=chrono::high_resolution_clock::now();
+			h=begin_enumerate_directory(_L("testdir"));
+			while(enumerate_directory(*h, out, 4096))
+				all.insert(all.end(), std::make_move_iterator(out.begin()), std::make_move_iterator(out.end()));
+			end=chrono::high_resolution_clock::now();
+			enumerating=std::min(enumerating, chrono::duration_cast<secs_type>(end-begin));
+			handlestats=h->stats();
+			calls=h->kernel_calls();
+			begin=chrono::high_resolution_clock::now();
+			for(auto &entry : all)
+				entry.fetch_metadata(*h, wanted);
+			end=chrono::high_resolution_clock::now();
+			lookingup=std::min(lookingup, chrono::duration_cast<secs_type>(end-begin));
+			h.reset();
+		}
+		enumeration_stats after=process_stats();
+		std::cout << "At best it took " << enumerating.count() << " secs to enumerate " << all.size() << " entries which is " << all.size()/enumerating.count() << " entries per second, and "
+			<< lookingup.count() << " secs to look them up which is " << all.size()/lookingup.count() << " lookups per second." << std::endl;
+		if(stats_enabled())
+		{
+			uint64_t lookups=(after.statx_calls-before.statx_calls)+(after.fstatat_calls-before.fstatat_calls)+(after.nt_query_calls-before.nt_query_calls)+(after.nt_open_calls-before.nt_open_calls);
+			std::cout << "The last enumeration made " << handlestats.kernel_calls << " syscalls returning " << handlestats.kernel_bytes << " bytes in " << handlestats.syscall_ns/1000000.0 << " ms, parsed "
+				<< handlestats.entries_parsed << " records (" << handlestats.entries_skipped << " skipped, " << handlestats.entries_filtered << " filtered) in " << handlestats.parse_ns/1000000.0
+				<< " ms and made " << handlestats.allocations << " allocations in " << handlestats.alloc_ns/1000000.0 << " ms." << std::endl;
+			std::cout << "The process made " << lookups << " lookups taking an estimated " << (after.syscall_ns-before.syscall_ns)/1000000.0 << " ms in syscalls." << std::endl;
+			if(handlestats.kernel_calls!=calls)
+				std::cerr << "ERROR: the handle counted " << handlestats.kernel_calls << " syscalls when it made " << calls << "." << std::endl;
+			if(handlestats.entries_parsed!=all.size()+handlestats.entries_skipped+handlestats.entries_filtered || handlestats.entries_skipped<2)
+				std::cerr << "ERROR: the handle counted " << handlestats.entries_parsed << " records parsed, " << handlestats.entries_skipped << " skipped and "
+					<< handlestats.entries_filtered << " filtered when " << all.size() << " entries were returned." << std::endl;
+			if(lookups!=passes*all.size())
+				std::cerr << "ERROR: the process counted " << lookups << " lookups when " << passes*all.size() << " were made." << std::endl;
+		}
+	}
+
+	// Adaptive chunks
+	{
+		// Mostly tiny directories as a crawler meets them, a few medium ones, and testdir
+		std::vector<std::filesystem::path> dirs;
+		size_t entries=create_tree(_L("mixtree"), 30, 2, 12)+NUMBER_OF_FILES+1;
+		dirs.push_back(_L("mixtree"));
+		for(size_t a=0; a<30; a++)
+			for(size_t b=0; b<=30; b++)
+			{
+				std::filesystem::path::value_type buffer[32];
+				if(b) POSIX_SPRINTF(buffer, _L("mixtree/d%04u/d%04u"), (unsigned) a, (unsigned) b-1); else POSIX_SPRINTF(buffer, _L("mixtree/d%04u"), (unsigned) a);
+				dirs.push_back(buffer);
+			}
+		for(size_t files=500; files<=8000; files*=2)
+		{
+			std::filesystem::path::value_type buffer[32];
+			POSIX_SPRINTF(buffer, _L("mixtree/medium%u"), (unsigned) files);
+			entries+=1+create_tree(buffer, 0, 0, files);
+			dirs.push_back(buffer);
+		}
+		dirs.push_back(_L("testdir"));
+		const char *descriptions[4]={ "a default buffer and chunks of NUMBER_OF_FILES reserved up front", "a default buffer and chunks of 4096",
+			"an adaptive buffer and adaptive chunks", "an adaptive buffer sized from st_size and adaptive chunks" };
+		for(int how=0; how<4; how++)
+		{
+			std::cout << "Enumerating " << dirs.size() << " directories of " << entries << " entries with " << descriptions[how] << " ..." << std::endl;
+			size_t items=0, calls=0, buffers=0;
+			std::vector<directory_entry> chunk;
+			secs_type smaller(0);
+			begin=chrono::high_resolution_clock::now();
+			for(int pass=0; pass<5; pass++)
+				for(auto &dir : dirs)
+				{
+					auto dirbegin=chrono::high_resolution_clock::now();
+					size_t buffersize=(how<2) ? enumeration_handle::default_buffer_size : (2==how) ? enumeration_handle::adaptive_buffer_size : enumeration_handle::adaptive_buffer_size_from_stat;
+					auto h=begin_enumerate_directory(dir, buffersize);
+					if(0==how)
+					{
+						std::vector<directory_entry> out;
+						out.reserve(NUMBER_OF_FILES);
+						while(enumerate_directory(*h, out, NUMBER_OF_FILES))
+							items+=out.size();
+					}
+					else
+						while(enumerate_directory(*h, chunk, (1==how) ? 4096 : enumeration_handle::adaptive_chunk))
+							items+=chunk.size();
+					calls+=h->kernel_calls();
+					buffers+=h->kernel_buffer_size();
+					h.reset();
+					if(&dir!=&dirs.back())
+						smaller+=chrono::duration_cast<secs_type>(chrono::high_resolution_clock::now()-dirbegin);
+				}
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "It took " << diff.count() << " secs (" << smaller.count() << " secs for all but testdir), " << calls << " syscalls and " << buffers/dirs.size()/5
+				<< " bytes of kernel buffer per directory on average to enumerate " << items << " entries which is " << items/diff.count() << " entries per second." << std::endl;
+			if(items!=5*entries)
+				std::cerr << "ERROR: enumerating with " << descriptions[how] << " returned " << items << " entries when it should have returned " << 5*entries << "." << std::endl;
+		}
+		std::filesystem::remove_all(_L("mixtree"));
+	}
+
+#ifdef FASTDIRECTORYENUMERATOR_HAVE_COROUTINES
+	// Coroutines
+	{
+		size_t entries=create_tree(_L("asynctree"), 50, 2, 8);
+		std::vector<std::filesystem::path> dirs;
+		dirs.push_back(_L("asynctree"));
+		for(size_t a=0; a<50; a++)
+			for(size_t b=0; b<=50; b++)
+			{
+				std::filesystem::path::value_type buffer[32];
+				if(b) POSIX_SPRINTF(buffer, _L("asynctree/d%04u/d%04u"), (unsigned) a, (unsigned) b-1); else POSIX_SPRINTF(buffer, _L("asynctree/d%04u"), (unsigned) a);
+				dirs.push_back(buffer);
+			}
+		std::cout << "Scanning " << dirs.size() << " directories of " << entries << " entries at once from coroutines on a single threaded executor" << (fetch_metadata_uses_io_uring() ? " with" : " without") << " io_uring ..." << std::endl;
+		local_executor loop;
+		scan_totals totals;
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=1;
+		begin=chrono::high_resolution_clock::now();
+		loop.thread=std::this_thread::get_id();
+		for(auto &dir : dirs)
+			async_scan(loop, dir, wanted, totals);
+		loop.run_until([&] { return totals.finished==dirs.size(); });
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs and " << loop.resumed << " resumptions to scan " << totals.entries << " entries which is " << totals.entries/diff.count()
+			<< " entries per second, with up to " << totals.maxactive << " scans in progress at once." << std::endl;
+		if(totals.finished!=dirs.size() || totals.entries!=entries || totals.unsized || totals.wrongthread || totals.maxactive!=dirs.size())
+			std::cerr << "ERROR: coroutine scans finished " << totals.finished << " of " << dirs.size() << " directories, returning " << totals.entries << " of " << entries << " entries, "
+				<< totals.unsized << " without st_size, " << totals.wrongthread << " resumed on the wrong thread and " << totals.maxactive << " at once!" << std::endl;
+		begin=chrono::high_resolution_clock::now();
+		size_t blocking=0;
+		for(auto &dir : dirs)
+		{
+			auto h=begin_enumerate_directory(dir, enumeration_handle::adaptive_buffer_size);
+			std::vector<directory_entry> chunk;
+			while(enumerate_directory(*h, chunk, enumeration_handle::adaptive_chunk))
+			{
+				fetch_metadata(*h, chunk, wanted);
+				blocking+=chunk.size();
+			}
+		}
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "A blocking loop over the same directories took " << diff.count() << " secs which is " << blocking/diff.count() << " entries per second." << std::endl;
+		std::filesystem::remove_all(_L("asynctree"));
+
+		std::cout << "Cancelling a coroutine enumeration of " << NUMBER_OF_FILES << " files after 1000 entries ..." << std::endl;
+		std::stop_source stop;
+		size_t seen=0;
+		bool finished=false;
+		async_cancelled_scan(loop, stop, seen, finished);
+		loop.run_until([&] { return finished; });
+		std::cout << "The enumeration stopped after " << seen << " entries." << std::endl;
+		if(!finished || seen!=1000)
+			std::cerr << "ERROR: the cancelled coroutine enumeration " << (finished ? "returned every entry!" : "never finished!") << std::endl;
+	}
+#endif
+
+	// Visit
+	std::cout << "Visiting " << NUMBER_OF_FILES << " files without constructing any directory_entry. This should be swifter still ..." << std::endl;
+	{
+		size_t visited=0, regular=0;
+		begin=chrono::high_resolution_clock::now();
+		h=begin_enumerate_directory(_L("testdir"));
+		while(visit_directory(*h, [&](const dirent_view &v) { ++visited; if(S_IFREG==v.st_type) ++regular; return true; }));
+		h.reset();
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to visit " << visited << " entries which is " << visited/diff.count() << " entries per second, of which " << regular << " are regular files." << std::endl;
+	}
+
+	// Filter
+	{
+		// Names are twelve digit numbers, so these select 1%, 41%, 50% and 10%
+		static const std::filesystem::path::value_type *patterns[]={ _L("*99"), _L("*5*"), _L("*[02468]"), _L("00000000*") };
+		for(auto pattern : patterns)
+		{
+			glob_matcher glob(pattern);
+			size_t matched=0;
+			std::cout << "Visiting " << NUMBER_OF_FILES << " files matching " << std::filesystem::path(pattern) << " (matcher shape " << (int) glob.shape() << ") ..." << std::endl;
+			begin=chrono::high_resolution_clock::now();
+			h=begin_enumerate_directory(_L("testdir"));
+			while(visit_directory(*h, [&](const dirent_view &) { ++matched; return true; }, (size_t)-1, glob));
+			h.reset();
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "It took " << diff.count() << " secs to visit " << matched << " matching entries which is " << NUMBER_OF_FILES/diff.count() << " entries filtered per second." << std::endl;
+#ifndef WIN32
+			size_t fnmatched=0;
+			begin=chrono::high_resolution_clock::now();
+			h=begin_enumerate_directory(_L("testdir"));
+			while(visit_directory(*h, [&](const dirent_view &v) { if(!fnmatch(pattern, v.name.data(), 0)) ++fnmatched; return true; }));
+			h.reset();
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "Calling fnmatch() per entry instead took " << diff.count() << " secs which is " << NUMBER_OF_FILES/diff.count() << " entries filtered per second." << std::endl;
+			if(fnmatched!=matched)
+				std::cerr << "ERROR: glob_matcher matched " << matched << " entries but fnmatch() matched " << fnmatched << "!" << std::endl;
+#endif
+		}
+	}
+
+	// Filter sets
+	for(size_t count : { 1, 10, 100 })
+	{
+		// A mix of suffix, substring, prefix and general patterns, each selecting well under 1%
+		std::vector<std::filesystem::path> includes, excludes(1, _L("*7"));
+		for(size_t n=0; n<count; n++)
+		{
+			std::filesystem::path::value_type buffer[64];
+			static const std::filesystem::path::value_type *shapes[]={ _L("*%04u"), _L("*%05u*"), _L("0000000%05u*"), _L("*%04u[13]") };
+			POSIX_SPRINTF(buffer, shapes[n%4], (unsigned) (n*7919)%10000);
+			includes.push_back(buffer);
+		}
+		filter_set filter(includes, excludes);
+		std::vector<glob_matcher> globs;
+		for(auto &pattern : includes)
+			globs.push_back(glob_matcher(pattern));
+		glob_matcher exclude(excludes.front());
+		std::cout << "Visiting " << NUMBER_OF_FILES << " files through a filter set of " << count << " include patterns and one exclude pattern (" << filter.states() << " states) ..." << std::endl;
+		size_t matched=0, naivematched=0;
+		begin=chrono::high_resolution_clock::now();
+		h=begin_enumerate_directory(_L("testdir"));
+		while(visit_directory(*h, [&](const dirent_view &) { ++matched; return true; }, (size_t)-1, filter));
+		h.reset();
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to visit " << matched << " matching entries which is " << NUMBER_OF_FILES/diff.count() << " entries filtered per second." << std::endl;
+		begin=chrono::high_resolution_clock::now();
+		h=begin_enumerate_directory(_L("testdir"));
+		while(visit_directory(*h, [&](const dirent_view &v) {
+			if(exclude(v.name))
+				return true;
+			for(auto &glob : globs)
+				if(glob(v.name))
+				{
+					++naivematched;
+					break;
+				}
+			return true;
+		}));
+		h.reset();
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "Trying each pattern in turn instead took " << diff.count() << " secs which is " << NUMBER_OF_FILES/diff.count() << " entries filtered per second." << std::endl;
+		if(naivematched!=matched)
+			std::cerr << "ERROR: filter_set matched " << matched << " entries but trying each pattern matched " << naivematched << "!" << std::endl;
+	}
+
+	// Pack
+	{
+		std::vector<std::filesystem::path> serial;
+		std::vector<directory_entry> chunk;
+		h=begin_enumerate_directory(_L("testdir"));
+		begin=chrono::high_resolution_clock::now();
+		while(enumerate_directory(*h, chunk, 4096))
+			for(auto &entry : chunk)
+				serial.push_back(entry.name());
+		end=chrono::high_resolution_clock::now();
+		h.reset();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "An enumerate_directory() loop took " << diff.count() << " secs to enumerate " << serial.size() << " entries which is " << serial.size()/diff.count() << " entries per second." << std::endl;
+		for(size_t threads=1; threads<=16; threads*=2)
+		{
+			std::cout << "Enumerating " << NUMBER_OF_FILES << " files in partitions with " << threads << " threads ..." << std::endl;
+			std::vector<directory_entry> entries;
+			begin=chrono::high_resolution_clock::now();
+			size_t parts=parallel_enumerate_directory(_L("testdir"), entries, threads);
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "It took " << diff.count() << " secs to enumerate " << entries.size() << " entries in " << parts << " partitions which is " << entries.size()/diff.count() << " entries per second." << std::endl;
+			bool same=(entries.size()==serial.size());
+			for(size_t n=0; same && n<entries.size(); n++)
+				same=(entries[n].name()==serial[n]);
+			if(!same)
+				std::cerr << "ERROR: parallel_enumerate_directory() did not return the same entries in the same order as an enumerate_directory() loop!" << std::endl;
+		}
+	}
+	std::cout << "Enumerating " << NUMBER_OF_FILES << " files into a packed_enumeration ..." << std::endl;
+	{
+		packed_enumeration packed;
+		begin=chrono::high_resolution_clock::now();
+		h=begin_enumerate_directory(_L("testdir"));
+		while(enumerate_directory(*h, packed));
+		h.reset();
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to enumerate " << packed.size() << " entries which is " << packed.size()/diff.count() << " entries per second." << std::endl;
+		// Leafnames here are short enough to fit inside a std::string without a separate allocation
+		std::cout << "The packed_enumeration uses " << packed.bytes_used() << " bytes (" << (double) packed.bytes_used()/packed.size() << " per entry) whereas the std::vector<directory_entry> uses "
+			<< enumeration->capacity()*sizeof(directory_entry) << " bytes (" << (double) enumeration->capacity()*sizeof(directory_entry)/enumeration->size() << " per entry)." << std::endl;
+		if(packed.size()!=enumeration->size())
+			std::cerr << "ERROR: packed_enumeration returned " << packed.size() << " items when it should have returned " << enumeration->size() << " items." << std::endl;
+		for(auto entry : packed)
+			if(entry.to_directory_entry().name().native()!=entry.c_str())
+				std::cerr << "ERROR: packed_enumeration entry '" << entry.c_str() << "' does not round trip!" << std::endl;
+	}
+
+	// Columns
+	std::cout << "Enumerating " << NUMBER_OF_FILES << " files into a columnar_enumeration ..." << std::endl;
+	{
+		columnar_enumeration columns;
+		begin=chrono::high_resolution_clock::now();
+		h=begin_enumerate_directory(_L("testdir"));
+		while(enumerate_directory(*h, columns));
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to enumerate " << columns.size() << " entries which is " << columns.size()/diff.count() << " entries per second, using "
+			<< (double) columns.bytes_used()/columns.size() << " bytes per entry." << std::endl;
+		if(columns.size()!=enumeration->size())
+			std::cerr << "ERROR: columnar_enumeration returned " << columns.size() << " items when it should have returned " << enumeration->size() << " items." << std::endl;
+		// Repeat the scans enough times to be measurable
+		static const size_t repeats=100;
+		std::vector<uint32_t> selection;
+		size_t regular=0, scalarregular=0;
+		begin=chrono::high_resolution_clock::now();
+		for(size_t n=0; n<repeats; n++)
+			regular=columns.count_type(S_IFREG);
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "Counting regular files took " << diff.count()/repeats << " secs which is " << columns.size()*repeats/diff.count() << " entries per second." << std::endl;
+		for(auto type : columns.type_column())
+			if(S_IFREG==type) ++scalarregular;
+		if(regular!=scalarregular)
+			std::cerr << "ERROR: count_type() found " << regular << " regular files when there are " << scalarregular << "!" << std::endl;
+		columns.select_type(S_IFREG, selection);
+		if(selection.size()!=regular)
+			std::cerr << "ERROR: select_type() selected " << selection.size() << " regular files when count_type() counted " << regular << "!" << std::endl;
+		std::vector<uint64_t> inos(columns.ino_column());
+		std::nth_element(inos.begin(), inos.begin()+inos.size()/4, inos.end());
+		uint64_t lo=inos[inos.size()/4];
+		std::nth_element(inos.begin(), inos.begin()+inos.size()/2, inos.end());
+		uint64_t hi=inos[inos.size()/2];
+		size_t inrange=0, scalarinrange=0;
+		begin=chrono::high_resolution_clock::now();
+		for(size_t n=0; n<repeats; n++)
+			inrange=columns.count_ino_range(lo, hi);
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "Counting the " << inrange << " inodes in a range took " << diff.count()/repeats << " secs which is " << columns.size()*repeats/diff.count() << " entries per second." << std::endl;
+		for(auto ino : columns.ino_column())
+			if(ino>=lo && ino<=hi) ++scalarinrange;
+		selection.clear();
+		columns.select_ino_range(lo, hi, selection);
+		if(inrange!=scalarinrange || selection.size()!=scalarinrange)
+			std::cerr << "ERROR: count_ino_range() found " << inrange << " and select_ino_range() " << selection.size() << " inodes in range when there are " << scalarinrange << "!" << std::endl;
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=wanted.have_mtim=1;
+		columns.fetch_metadata(*h, wanted, true);
+		h.reset();
+		selection.clear();
+		columns.select_size_range(1, (FastDirectoryEnumerator::off_t)-1, selection);
+		// Only the symbolic link has a size
+		if(1!=selection.size() || columns.name(selection[0])!=_L("link"))
+			std::cerr << "ERROR: select_size_range() selected " << selection.size() << " entries when only the link is not empty!" << std::endl;
+	}
+
+	// Snapshot
+	std::cout << "Snapshotting " << NUMBER_OF_FILES << " files ..." << std::endl;
+	{
+		std::filesystem::remove(_L("testdir.snapshot"));
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=1;
+		uint64_t firstino=0;
+		for(int pass=0; pass<5; pass++)
+		{
+			if(2==pass)
+			{
+				// A record pointing outside the leafnames must have the snapshot rejected when mapped
+				std::vector<char> file(read_file(_L("testdir.snapshot")));
+				size_t n=0;
+				for(; n+sizeof(packed_enumeration::record)<=file.size(); n+=sizeof(uint64_t))
+					if(!memcmp(file.data()+n, &firstino, sizeof(firstino)))
+						break;
+				if(n+sizeof(packed_enumeration::record)>file.size()) abort();
+				packed_enumeration::record r;
+				memcpy(&r, file.data()+n, sizeof(r));
+				r.name_offset=(uint64_t)-1/2;
+				memcpy(file.data()+n, &r, sizeof(r));
+				write_file(_L("testdir.snapshot"), file);
+			}
+			if(3==pass)
+			{
+				// Changing the directory must invalidate the snapshot
+				int fh=POSIX_OPEN(_L("testdir/newfile"), O_CREAT|O_RDWR, 0x1b0/*660*/);
+				if(-1==fh) abort();
+				POSIX_CLOSE(fh);
+				POSIX_UNLINK(_L("testdir/newfile"));
+			}
+			begin=chrono::high_resolution_clock::now();
+			auto snapshot=directory_snapshot::open(_L("testdir"), _L("testdir.snapshot"), wanted);
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "It took " << diff.count() << " secs to open a snapshot " << (snapshot->from_cache() ? "from the cache" : "by enumerating") << " with " << snapshot->size() << " entries." << std::endl;
+			// Pass 4 follows the change of pass 3 too closely for the snapshot of pass 3 to have been kept
+			if((1==pass)!=snapshot->from_cache())
+				std::cerr << "ERROR: snapshot pass " << pass << " should " << (1==pass ? "" : "not ") << "have come from the cache!" << std::endl;
+			if(1==pass && snapshot->size())
+				firstino=(*snapshot)[0].st_ino();
+			if(snapshot->size()!=enumeration->size())
+				std::cerr << "ERROR: directory_snapshot returned " << snapshot->size() << " items when it should have returned " << enumeration->size() << " items." << std::endl;
+			for(auto entry : *snapshot)
+				if(!entry.metadata_ready().have_size || entry.to_directory_entry().name().native()!=entry.c_str())
+				{
+					std::cerr << "ERROR: directory_snapshot entry '" << entry.c_str() << "' did not keep its metadata or does not round trip!" << std::endl;
+					break;
+				}
+		}
+		std::filesystem::remove(_L("testdir.snapshot"));
+	}
+
+	// Resume
+	std::cout << "Enumerating " << NUMBER_OF_FILES << " files interrupted at random points and resumed from a saved position ..." << std::endl;
+	{
+		std::mt19937 rng(78);
+		size_t resumes=0, scans=0;
+		begin=chrono::high_resolution_clock::now();
+		for(; scans<20; scans++)
+		{
+			// Each interruption throws away the handle and everything it buffered, as a crash would
+			std::unordered_map<std::filesystem::path::string_type, size_t> seen;
+			enumeration_handle::position_type checkpoint=0;
+			std::vector<directory_entry> chunk;
+			for(bool more=true; more;)
+			{
+				h=resume_enumerate_directory(_L("testdir"), checkpoint);
+				if(!h) abort();
+				size_t interrupt=rng()%(NUMBER_OF_FILES/4);
+				for(size_t done=0; done<interrupt && (more=enumerate_directory(*h, chunk, 1+rng()%3000));)
+				{
+					for(auto &entry : chunk)
+						++seen[entry.name().native()];
+					done+=chunk.size();
+					checkpoint=h->tell();
+				}
+				++resumes;
+			}
+			bool ok=(NUMBER_OF_FILES+1==seen.size());
+			for(auto &i : seen)
+				ok=ok && 1==i.second;
+			if(!ok)
+			{
+				std::cerr << "ERROR: resumed enumerations returned " << seen.size() << " distinct entries, some perhaps more than once, when they should have returned " << NUMBER_OF_FILES+1 << " exactly once!" << std::endl;
+				break;
+			}
+		}
+		h.reset();
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to enumerate " << scans << " times with " << resumes << " resumes." << std::endl;
+	}
+
+	// Diff
+	std::cout << "Diffing two enumerations of " << DIFF_ENTRIES << " entries ..." << std::endl;
+	{
+		// Of every thousand entries after drops one, renames one and adds one
+		packed_enumeration before, after;
+		before.reserve(DIFF_ENTRIES, DIFF_ENTRIES*12);
+		after.reserve(DIFF_ENTRIES, DIFF_ENTRIES*12);
+		for(size_t n=0; n<DIFF_ENTRIES; n++)
+		{
+			std::filesystem::path::value_type buffer[16];
+			POSIX_SPRINTF(buffer, _L("%012u"), (unsigned) n);
+			before.push_back(name_view(buffer, 12), n+1, S_IFREG);
+			if(0==n%1000)
+				continue;
+			if(1==n%1000)
+				buffer[0]='r';
+			after.push_back(name_view(buffer, 12), n+1, S_IFREG);
+			if(2==n%1000)
+			{
+				buffer[0]='a';
+				after.push_back(name_view(buffer, 12), DIFF_ENTRIES+n+1, S_IFREG);
+			}
+		}
+		begin=chrono::high_resolution_clock::now();
+		auto changes=diff_directories(before, after);
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		size_t counts[4]={ 0 };
+		for(auto &change : changes)
+			++counts[(int) change.kind];
+		std::cout << "It took " << diff.count() << " secs to find " << counts[0] << " added, " << counts[1] << " removed, " << counts[2] << " renamed and " << counts[3] << " modified entries which is "
+			<< DIFF_ENTRIES/diff.count() << " entries per second." << std::endl;
+		if(counts[0]!=DIFF_ENTRIES/1000 || counts[1]!=DIFF_ENTRIES/1000 || counts[2]!=DIFF_ENTRIES/1000 || counts[3])
+			std::cerr << "ERROR: diff_directories() found the wrong changes!" << std::endl;
+	}
+	std::cout << "Diffing a snapshot of " << NUMBER_OF_FILES << " files against a live enumeration ..." << std::endl;
+	{
+		std::filesystem::remove(_L("testdir.snapshot"));
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=1;
+		auto snapshot=directory_snapshot::open(_L("testdir"), _L("testdir.snapshot"), wanted);
+		std::filesystem::rename(_L("testdir/000000000001"), _L("testdir/renamed"));
+		POSIX_UNLINK(_L("testdir/000000000002"));
+		int fh=POSIX_OPEN(_L("testdir/000000000003"), O_RDWR, 0x1b0/*660*/);
+		if(-1==fh || 1!=write(fh, "x", 1)) abort();
+		POSIX_CLOSE(fh);
+		size_t counts[4]={ 0 };
+		bool ok=true;
+		begin=chrono::high_resolution_clock::now();
+		h=begin_enumerate_directory(_L("testdir"));
+		diff_directories(*snapshot, *h, wanted, [&](change_kind kind, size_t before, directory_entry *after) {
+			++counts[(int) kind];
+			switch(kind)
+			{
+			case change_kind::renamed: ok=ok && _L("000000000001")==std::filesystem::path::string_type((*snapshot)[before].c_str()) && _L("renamed")==after->name(); break;
+			case change_kind::removed: ok=ok && _L("000000000002")==std::filesystem::path::string_type((*snapshot)[before].c_str()) && !after; break;
+			case change_kind::modified: ok=ok && _L("000000000003")==after->name(); break;
+			default: ok=false;
+			}
+		});
+		h.reset();
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to find " << counts[0] << " added, " << counts[1] << " removed, " << counts[2] << " renamed and " << counts[3] << " modified entries." << std::endl;
+		if(!ok || counts[1]!=1 || counts[2]!=1 || counts[3]!=1)
+			std::cerr << "ERROR: diff_directories() against a live enumeration found the wrong changes!" << std::endl;
+		// Put the directory back as it was
+		std::filesystem::rename(_L("testdir/renamed"), _L("testdir/000000000001"));
+		fh=POSIX_OPEN(_L("testdir/000000000002"), O_CREAT|O_RDWR, 0x1b0/*660*/);
+		if(-1==fh) abort();
+		POSIX_CLOSE(fh);
+		fh=POSIX_OPEN(_L("testdir/000000000003"), O_RDWR|O_TRUNC, 0x1b0/*660*/);
+		if(-1==fh) abort();
+		POSIX_CLOSE(fh);
+		snapshot.reset();
+		std::filesystem::remove(_L("testdir.snapshot"));
+	}
+
+	// Watch
+	std::cout << "Watching a directory of " << WATCH_FILES << " files while another thread changes it ..." << std::endl;
+	{
+		std::filesystem::remove_all(_L("watchdir"));
+		POSIX_MKDIR(_L("watchdir"), 0x1f8/*770*/);
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=1;
+		auto watched=watched_directory::open(_L("watchdir"), wanted);
+		// True if the entries watched match a fresh enumeration, leafnames and sizes alike
+		auto coherent=[&]() -> bool {
+			auto h=begin_enumerate_directory(_L("watchdir"));
+			std::vector<directory_entry> entries;
+			size_t count=0;
+			bool ok=true;
+			while(enumerate_directory(*h, entries, 4096))
+			{
+				fetch_metadata(*h, entries, wanted);
+				for(auto &entry : entries)
+				{
+					directory_entry *held=const_cast<directory_entry *>(watched->find(entry.name()));
+					ok=ok && held && held->st_size()==entry.st_size();
+				}
+				count+=entries.size();
+			}
+			return ok && count==watched->size();
+		};
+		std::atomic<bool> done(false);
+		std::thread writer([&done] {
+			std::filesystem::path::value_type buffer[32], buffer2[32];
+			for(size_t n=0; n<WATCH_FILES; n++)
+			{
+				POSIX_SPRINTF(buffer, _L("watchdir/%08u"), (unsigned) n);
+				append_file(buffer, 1);
+			}
+			for(size_t n=0; n<WATCH_FILES; n+=20)
+			{
+				POSIX_SPRINTF(buffer, _L("watchdir/%08u"), (unsigned) n);
+				POSIX_SPRINTF(buffer2, _L("watchdir/r%07u"), (unsigned) n);
+				std::filesystem::rename(buffer, buffer2);
+				POSIX_SPRINTF(buffer, _L("watchdir/%08u"), (unsigned) n+1);
+				POSIX_UNLINK(buffer);
+				POSIX_SPRINTF(buffer, _L("watchdir/%08u"), (unsigned) n+2);
+				append_file(buffer, 1);
+			}
+			done=true;
+		});
+		size_t changes=0;
+		begin=chrono::high_resolution_clock::now();
+		while(!done)
+			changes+=watched->refresh(10);
+		writer.join();
+		changes+=watched->refresh();
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to apply " << changes << " changes from " << watched->events() << " events with " << watched->stats() << " stats and "
+			<< watched->rescans() << " rescans, leaving " << watched->size() << " entries." << std::endl;
+		if(!coherent())
+			std::cerr << "ERROR: watched_directory doesn't match the directory after changes from another thread!" << std::endl;
+
+		// More events than the kernel queues by default
+		size_t rescans=watched->rescans();
+		for(size_t n=0; n<WATCH_FILES; n++)
+		{
+			std::filesystem::path::value_type buffer[32];
+			POSIX_SPRINTF(buffer, _L("watchdir/o%07u"), (unsigned) n);
+			append_file(buffer, 0);
+		}
+		changes=watched->refresh();
+		std::cout << "Overflowing the event queue found " << changes << " changes with " << watched->rescans()-rescans << " rescans." << std::endl;
+		if(watched->is_watching() && watched->rescans()==rescans)
+			std::cerr << "ERROR: watched_directory didn't rescan after the event queue overflowed!" << std::endl;
+		if(!coherent())
+			std::cerr << "ERROR: watched_directory doesn't match the directory after the event queue overflowed!" << std::endl;
+
+		// Applying a few changes from events versus rescanning for them
+		for(size_t n=0; n<100; n++)
+		{
+			std::filesystem::path::value_type buffer[32];
+			POSIX_SPRINTF(buffer, _L("watchdir/o%07u"), (unsigned) n);
+			append_file(buffer, 1);
+		}
+		begin=chrono::high_resolution_clock::now();
+		changes=watched->refresh();
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to refresh " << changes << " changes among " << watched->size() << " entries." << std::endl;
+		if(100!=changes || !coherent())
+			std::cerr << "ERROR: watched_directory didn't apply the changes made!" << std::endl;
+		begin=chrono::high_resolution_clock::now();
+		changes=watched->rescan();
+		end=chrono::high_resolution_clock::now();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to rescan " << watched->size() << " entries, finding " << changes << " changes." << std::endl;
+		watched.reset();
+		std::filesystem::remove_all(_L("watchdir"));
+	}
+
+	// Enumerate
+	std::cout << "Pulling all metadata for " << NUMBER_OF_FILES << " files. This may take a while ..." << std::endl;
+    begin=chrono::high_resolution_clock::now();
+	if(enumeration)
+	{
+		have_metadata_flags maximum; maximum.value=(unsigned)-1;
+		for(auto &entry : *enumeration)
+		{
+			entry.fetch_metadata(_L("testdir"), maximum);
+		}
+	}
+    end=chrono::high_resolution_clock::now();
+    diff=chrono::duration_cast<secs_type>(end-begin);
+    std::cout << "It took " << diff.count() << " secs to get maximum metadata for " << NUMBER_OF_FILES << " entries which is " << NUMBER_OF_FILES/diff.count() << " entries per second." << std::endl;
+    std::cout << "Enumeration returns information 0x" << std::hex << (*enumeration)[0].metadata_ready().value << std::dec << std::endl;
+    std::cout << "System max information ought to be 0x" << std::hex << directory_entry::metadata_supported().value << std::dec << std::endl;
+
+	// Enumerate
+	std::cout << "Pulling size and mtime relative to the directory for " << NUMBER_OF_FILES << " files ..." << std::endl;
+	{
+		std::vector<directory_entry> entries;
+		h=begin_enumerate_directory(_L("testdir"));
+		enumerate_directory(*h, entries, (size_t)-1);
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=wanted.have_mtim=1;
+		begin=chrono::high_resolution_clock::now();
+		for(auto &entry : entries)
+			entry.fetch_metadata(*h, wanted, true);
+		end=chrono::high_resolution_clock::now();
+		h.reset();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to get size and mtime for " << entries.size() << " entries which is " << entries.size()/diff.count() << " entries per second." << std::endl;
+		std::cout << "Fetching size and mtime returns information 0x" << std::hex << entries[0].metadata_ready().value << std::dec << std::endl;
+		std::cout << "This filing system can provide information 0x" << std::hex << directory_entry::metadata_supported(_L("testdir")).value << std::dec << std::endl;
+	}
+	std::cout << "Pulling size and mtime as a batch " << (fetch_metadata_uses_io_uring() ? "using io_uring" : "without io_uring") << " for " << NUMBER_OF_FILES << " files ..." << std::endl;
+	{
+		std::vector<directory_entry> entries;
+		h=begin_enumerate_directory(_L("testdir"));
+		enumerate_directory(*h, entries, (size_t)-1);
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=wanted.have_mtim=1;
+		begin=chrono::high_resolution_clock::now();
+		fetch_metadata(*h, entries, wanted, true);
+		end=chrono::high_resolution_clock::now();
+		h.reset();
+		diff=chrono::duration_cast<secs_type>(end-begin);
+		std::cout << "It took " << diff.count() << " secs to get size and mtime for " << entries.size() << " entries which is " << entries.size()/diff.count() << " entries per second." << std::endl;
+		for(auto &entry : entries)
+			if(!entry.metadata_ready().have_size || !entry.metadata_ready().have_mtim)
+			{
+				std::cerr << "ERROR: batch fetch_metadata() did not fetch '" << entry.name() << "'!" << std::endl;
+				break;
+			}
+	}
+	{
+		// Looking up entries of a deep directory by path walks every component, unless the directory's fd is cached
+		std::filesystem::path deep(_L("deeptree"));
+		for(int n=0; n<16; n++)
+			deep/=_L("d0000");
+		std::filesystem::path absdeep=std::filesystem::absolute(deep);
+		size_t files=NUMBER_OF_FILES/10;
+		create_tree(_L("deeptree"), 1, 16, files);
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=wanted.have_mtim=1;
+		for(int cached=0; cached<2; cached++)
+		{
+			std::vector<directory_entry> entries;
+			h=begin_enumerate_directory(deep);
+			enumerate_directory(*h, entries, (size_t)-1);
+			h.reset();
+			std::cout << "Pulling size and mtime for " << entries.size() << " files 17 directories deep " << (cached ? "through a cached fd of their directory" : "by relative path") << " ..." << std::endl;
+			begin=chrono::high_resolution_clock::now();
+			for(auto &entry : entries)
+				entry.fetch_metadata(cached ? std::filesystem::path() : deep, wanted);
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "It took " << diff.count() << " secs to get size and mtime for " << entries.size() << " entries which is " << entries.size()/diff.count() << " entries per second." << std::endl;
+			for(auto &entry : entries)
+				if(!entry.metadata_ready().have_size || !entry.metadata_ready().have_mtim)
+				{
+					std::cerr << "ERROR: fetch_metadata() did not fetch '" << entry.name() << "' in a deep directory!" << std::endl;
+					break;
+				}
+		}
+		// Entries remember the directory they came from after its handle is gone
+		std::vector<directory_entry> entries;
+		h=begin_enumerate_directory(deep);
+		enumerate_directory(*h, entries, (size_t)-1);
+		h.reset();
+		std::vector<directory_entry> cachedcopy(entries), uncachedcopy(entries);
+		if(entries.empty() || entries[0].directory()!=absdeep || 1!=entries[0].st_nlink())
+			std::cerr << "ERROR: directory_entry does not look itself up in the directory it was enumerated from!" << std::endl;
+		// A relative path is resolved when opened, whatever the current directory is by the time entries are made
+		{
+			h=begin_enumerate_directory(deep);
+			std::filesystem::path cwd=std::filesystem::current_path();
+			std::filesystem::current_path(deep);
+			std::vector<directory_entry> some;
+			enumerate_directory(*h, some, 1);
+			h.reset();
+			bool found=!some.empty() && some[0].fetch_metadata(std::filesystem::path(), wanted).have_size;
+			std::filesystem::current_path(cwd);
+			if(!found || !std::filesystem::equivalent(some[0].directory(), absdeep))
+				std::cerr << "ERROR: directory_entry does not know its directory once the current directory changes!" << std::endl;
+		}
+		// Once another directory takes its path, a prefix finds the new entry, and an entry of the old directory never does
+		std::filesystem::rename(deep, deep.parent_path()/_L("moved"));
+		std::filesystem::create_directories(deep);
+		append_file(deep/_L("000000000000"), 5);
+		auto find=[](std::vector<directory_entry> &v) { return std::find_if(v.begin(), v.end(), [](const directory_entry &e) { return e.name()==_L("000000000000"); }); };
+		auto it=find(entries);
+		if(it==entries.end() || !it->fetch_metadata(absdeep, wanted).have_size || 5!=it->st_size())
+			std::cerr << "ERROR: fetch_metadata() looked up an entry in a directory moved away from its prefix!" << std::endl;
+		it=find(cachedcopy);
+		if(it==cachedcopy.end() || 5==it->st_size())
+			std::cerr << "ERROR: directory_entry looked itself up through a cached fd in a directory which took the path of its own!" << std::endl;
+		close_cached_directories();
+		it=find(uncachedcopy);
+		if(it==uncachedcopy.end() || 5==it->st_size())
+			std::cerr << "ERROR: directory_entry looked itself up in a directory which took the path of its own!" << std::endl;
+		close_cached_directories();
+		std::filesystem::remove_all(_L("deeptree"));
+	}
+	{
+		size_t maxthreads=std::max(4u, std::thread::hardware_concurrency());
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=wanted.have_mtim=1;
+		for(size_t threads=1; threads<=maxthreads; threads*=2)
+		{
+			std::vector<directory_entry> entries;
+			h=begin_enumerate_directory(_L("testdir"));
+			enumerate_directory(*h, entries, (size_t)-1);
+			std::cout << "Pulling size and mtime in parallel with " << threads << " threads for " << NUMBER_OF_FILES << " files ..." << std::endl;
+			begin=chrono::high_resolution_clock::now();
+			parallel_fetch_metadata(*h, entries, wanted, threads, true);
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "It took " << diff.count() << " secs to get size and mtime for " << entries.size() << " entries which is " << entries.size()/diff.count() << " entries per second." << std::endl;
+			for(auto &entry : entries)
+				if(!entry.metadata_ready().have_size || !entry.metadata_ready().have_mtim)
+				{
+					std::cerr << "ERROR: parallel_fetch_metadata() did not fetch '" << entry.name() << "'!" << std::endl;
+					break;
+				}
+			h.reset();
+		}
+	}
+	{
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=wanted.have_mtim=1;
+		std::vector<std::filesystem::path> names[2];
+		std::vector<FastDirectoryEnumerator::off_t> sizes[2];
+		for(int o=0; o<2; o++)
+		{
+			fetch_order order=o ? fetch_order::by_inode : fetch_order::as_given;
+			// Enumerating reads the directory back in, as it would be when cold, but not the inode tables
+			bool cold=drop_caches();
+			std::vector<directory_entry> entries;
+			h=begin_enumerate_directory(_L("testdir"));
+			enumerate_directory(*h, entries, (size_t)-1);
+			std::cout << "Pulling size and mtime as a batch " << (cold ? "with cold caches" : "with warm caches (dropping caches needs root)") << " in " << (o ? "inode" : "enumeration")
+				<< " order for " << NUMBER_OF_FILES << " files ..." << std::endl;
+			begin=chrono::high_resolution_clock::now();
+			fetch_metadata(*h, entries, wanted, false, order);
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "It took " << diff.count() << " secs to get size and mtime for " << entries.size() << " entries which is " << entries.size()/diff.count() << " entries per second." << std::endl;
+			for(auto &entry : entries)
+			{
+				names[o].push_back(entry.name());
+				sizes[o].push_back(entry.metadata_ready().have_size ? entry.st_size() : (FastDirectoryEnumerator::off_t)-1);
+			}
+			h.reset();
+		}
+		if(names[0]!=names[1] || sizes[0]!=sizes[1])
+			std::cerr << "ERROR: fetch_metadata() in inode order did not leave each entry where it was!" << std::endl;
+	}
+
+	// Prefetch
+	{
+		have_metadata_flags wanted; wanted.value=0; wanted.have_size=1;
+		uint64_t checksums[2]={ 0, 0 };
+		size_t counts[2]={ 0, 0 };
+		for(int cold=0; cold<2; cold++)
+			for(int how=0; how<2; how++)
+			{
+				bool dropped=cold && drop_caches();
+				if(cold && !dropped)
+					break;
+				std::cout << "Enumerating " << NUMBER_OF_FILES << " files and their sizes with " << (cold ? "cold" : "warm") << " caches, working on each, "
+					<< (how ? "a few chunks ahead on a background thread" : "in a plain enumerate_directory() loop") << " ..." << std::endl;
+				uint64_t checksum=0;
+				size_t count=0, waits=0;
+				begin=chrono::high_resolution_clock::now();
+				if(how)
+				{
+					auto p=prefetching_enumerator::open(_L("testdir"), wanted);
+					while(std::vector<directory_entry> *chunk=p->next())
+						for(auto &entry : *chunk)
+						{
+							checksum+=busy_work(entry, 8);
+							++count;
+						}
+					waits=p->waits();
+				}
+				else
+				{
+					h=begin_enumerate_directory(_L("testdir"));
+					std::vector<directory_entry> chunk;
+					while(enumerate_directory(*h, chunk, 4096))
+					{
+						fetch_metadata(*h, chunk, wanted);
+						for(auto &entry : chunk)
+						{
+							checksum+=busy_work(entry, 8);
+							++count;
+						}
+					}
+					h.reset();
+				}
+				end=chrono::high_resolution_clock::now();
+				diff=chrono::duration_cast<secs_type>(end-begin);
+				std::cout << "It took " << diff.count() << " secs to work on " << count << " entries which is " << count/diff.count() << " entries per second";
+				if(how)
+					std::cout << ", waiting for the background thread " << waits << " times";
+				std::cout << "." << std::endl;
+				if(how && (checksum!=checksums[0] || count!=counts[0]))
+					std::cerr << "ERROR: prefetching_enumerator returned different entries to an enumerate_directory() loop!" << std::endl;
+				checksums[how]=checksum;
+				counts[how]=count;
+			}
+	}
+
+    if(enumeration)
+    {
+    	for(auto &entry : *enumeration)
+		{
+			if(entry.name()==_L("000000000000") || entry.name()==_L("link"))
+			{
+		    	std::cout << "Entry is a ";
+				if(entry.st_type() & S_IFLNK)
+					std::cout << "link";
+				else
+					std::cout << "file";
+				std::cout << " called " << entry.name() << " and it has the following information:" << std::endl;
+#define PRINT_FIELD(field) \
+    			std::cout << "  st_" #field ": "; if(entry.metadata_ready().have_##field) std::cout << entry.st_##field(); else std::cout << "unknown"; std::cout << std::endl
+    			PRINT_FIELD(dev);
+    			PRINT_FIELD(ino);
+    			PRINT_FIELD(type);
+    			PRINT_FIELD(mode);
+    			PRINT_FIELD(nlink);
+    			PRINT_FIELD(uid);
+    			PRINT_FIELD(gid);
+    			PRINT_FIELD(rdev);
+    			PRINT_FIELD(atim);
+    			PRINT_FIELD(mtim);
+    			PRINT_FIELD(ctim);
+    			PRINT_FIELD(size);
+    			PRINT_FIELD(allocated);
+    			PRINT_FIELD(blocks);
+    			PRINT_FIELD(blksize);
+    			PRINT_FIELD(flags);
+    			PRINT_FIELD(gen);
+    			PRINT_FIELD(birthtim);
+			}
+		}
+    }
+
+	// Walk
+	{
+		size_t entries=create_tree(_L("testtree"), 10, 2, NUMBER_OF_FILES/100);
+		size_t maxthreads=std::max(4u, std::thread::hardware_concurrency());
+		for(size_t threads=1; threads<=maxthreads; threads*=2)
+		{
+			std::cout << "Walking a tree of " << entries << " entries with " << threads << " threads ..." << std::endl;
+			walk_options options;
+			options.threads=threads;
+			std::atomic<size_t> files(0);
+			begin=chrono::high_resolution_clock::now();
+			size_t walked=walk_tree(_L("testtree"), options, [&files](const walked_directory &, directory_entry &entry) {
+				if(S_IFREG==entry.st_type()) ++files;
+				return true;
+			});
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "It took " << diff.count() << " secs to walk " << walked << " entries which is " << walked/diff.count() << " entries per second." << std::endl;
+			if(walked!=entries || files!=NUMBER_OF_FILES)
+				std::cerr << "ERROR: walk returned " << walked << " entries and " << files << " files when it should have returned " << entries << " entries and " << NUMBER_OF_FILES << " files." << std::endl;
+		}
+
+		// Disk usage. Some files get content and some are hard linked from a directory of their own, which
+		// du and disk_usage must count once.
+		size_t links=0;
+		for(size_t n=0; n<100; n++)
+		{
+			std::filesystem::path::value_type buffer[64];
+			POSIX_SPRINTF(buffer, _L("testtree/d0005/d0005/%012u"), (unsigned) n);
+			int fh=POSIX_OPEN(buffer, O_WRONLY, 0x1b0/*660*/);
+			if(-1==fh) abort();
+			std::vector<char> data(65536, 'x');
+			if((int) data.size()!=write(fh, data.data(), (unsigned) data.size())) abort();
+			POSIX_CLOSE(fh);
+		}
+#ifndef WIN32
+		POSIX_MKDIR("testtree/links", 0x1f8/*770*/);
+		for(size_t n=0; n<1000; n++, links++)
+		{
+			char from[64], to[64];
+			sprintf(from, "testtree/d0005/d%04u/%012u", (unsigned) (n/100), (unsigned) (n%100));
+			sprintf(to, "testtree/links/%04u", (unsigned) n);
+			if(-1==link(from, to)) abort();
+		}
+#endif
+		for(int cold=0; cold<2; cold++)
+		{
+			if(cold && !drop_caches())
+				break;
+			std::cout << "Measuring the disk usage of a tree of " << entries+links << " entries with " << (cold ? "cold" : "warm") << " caches ..." << std::endl;
+			begin=chrono::high_resolution_clock::now();
+			auto du=disk_usage::measure(_L("testtree"));
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "It took " << diff.count() << " secs to find " << du->root().total().allocated << " bytes allocated to " << du->root().total().files << " files in "
+				<< du->root().total().directories << " directories, skipping " << du->hardlinks() << " hard links, which is " << du->entries()/diff.count() << " entries per second." << std::endl;
+			if(du->root().total().files!=NUMBER_OF_FILES || du->hardlinks()!=links || du->root().total().directories!=entries-NUMBER_OF_FILES+1+(links ? 1 : 0))
+				std::cerr << "ERROR: disk_usage found " << du->root().total().files << " files, " << du->hardlinks() << " hard links and " << du->root().total().directories << " directories." << std::endl;
+			const disk_usage_node *node=du->find(_L("d0001/d0002"));
+			if(!node || node->total().files!=NUMBER_OF_FILES/100 || node->path()!=std::filesystem::path(_L("testtree/d0001/d0002")))
+				std::cerr << "ERROR: disk_usage could not find d0001/d0002." << std::endl;
+			auto largest=du->largest(5);
+			for(size_t n=1; n<largest.size(); n++)
+				if(largest[n]->total().allocated>largest[n-1]->total().allocated)
+					std::cerr << "ERROR: disk_usage returned the largest subtrees out of order." << std::endl;
+			if(largest.size()!=5 || largest[0]->total().allocated<100*65536)
+				std::cerr << "ERROR: disk_usage did not return the largest subtrees." << std::endl;
+#ifndef WIN32
+			if(cold)
+				drop_caches();
+			begin=chrono::high_resolution_clock::now();
+			uint64_t bytes=run_du("testtree");
+			end=chrono::high_resolution_clock::now();
+			if(bytes)
+			{
+				diff=chrono::duration_cast<secs_type>(end-begin);
+				std::cout << "du -s took " << diff.count() << " secs to find " << bytes << " bytes allocated." << std::endl;
+				if(bytes!=du->root().total().allocated)
+					std::cerr << "ERROR: disk_usage found " << du->root().total().allocated << " bytes allocated when du found " << bytes << "." << std::endl;
+			}
+#endif
+		}
+#ifndef WIN32
+		{
+			// With fds for just the root and one subdirectory, none of the directories below those can be opened
+			std::cout << "Measuring the disk usage of a tree with too few fds to open all its directories ..." << std::endl;
+			struct rlimit old, few;
+			if(-1==getrlimit(RLIMIT_NOFILE, &old)) abort();
+			int lowest=dup(0);
+			POSIX_CLOSE(lowest);
+			few=old;
+			few.rlim_cur=lowest+2;
+			walk_options options;
+			options.threads=1;
+			std::atomic<size_t> emfiles(0);
+			options.on_error=[](void *ctx, const walked_directory &, int errcode) { if(EMFILE==errcode) ++*(std::atomic<size_t> *) ctx; };
+			options.error_ctx=&emfiles;
+			if(-1==setrlimit(RLIMIT_NOFILE, &few)) abort();
+			auto du=disk_usage::measure(_L("testtree"), options);
+			setrlimit(RLIMIT_NOFILE, &old);
+			if(!du || !du->unreadable() || du->unreadable()!=emfiles || du->root().total().files>=NUMBER_OF_FILES)
+				std::cerr << "ERROR: disk_usage reported " << (du ? du->unreadable() : 0) << " unreadable directories, " << emfiles << " of them out of fds, when it counted "
+					<< (du ? du->root().total().files : 0) << " files." << std::endl;
+		}
+#endif
+		std::filesystem::remove_all(_L("testtree"));
+	}
+
+	// Hard links
+	{
+		// Each leaf directory gets 700 files and 300 hard links to files in the next
+		size_t entries=create_tree(_L("linktree"), 10, 2, 700), links=0;
+#ifndef WIN32
+		for(size_t d=0; d<100; d++)
+			for(size_t n=0; n<300; n++, links++)
+			{
+				char from[64], to[64];
+				sprintf(from, "linktree/d%04u/d%04u/%012u", (unsigned) ((d+1)%100/10), (unsigned) ((d+1)%10), (unsigned) n);
+				sprintf(to, "linktree/d%04u/d%04u/link%04u", (unsigned) (d/10), (unsigned) (d%10), (unsigned) n);
+				if(-1==link(from, to)) abort();
+			}
+#endif
+		entries+=links;
+		size_t maxthreads=std::max(4u, std::thread::hardware_concurrency());
+		for(int dedup=0; dedup<2; dedup++)
+		{
+			std::cout << "Walking a tree of " << entries << " entries, " << links << " of them hard links, fetching their sizes " << (dedup ? "skipping inodes already visited" : "visiting every entry") << " ..." << std::endl;
+			inode_set visited;
+			walk_options options;
+			options.threads=maxthreads;
+			options.metadata.have_size=1;
+			if(dedup)
+				options.visited=&visited;
+			std::atomic<size_t> files(0);
+			begin=chrono::high_resolution_clock::now();
+			size_t walked=walk_tree(_L("linktree"), options, [&files](const walked_directory &, directory_entry &entry) {
+				if(S_IFREG==entry.st_type()) ++files;
+				return true;
+			});
+			end=chrono::high_resolution_clock::now();
+			diff=chrono::duration_cast<secs_type>(end-begin);
+			std::cout << "It took " << diff.count() << " secs to walk " << walked << " entries which is " << entries/diff.count() << " entries per second";
+			if(dedup)
+				std::cout << ", skipping " << visited.repeats() << " with " << visited.size() << " inodes in the visited set";
+			std::cout << "." << std::endl;
+			size_t expected=dedup ? entries-links : entries;
+			if(walked!=expected || (dedup && visited.repeats()!=links))
+				std::cerr << "ERROR: walk returned " << walked << " entries when it should have returned " << expected << "." << std::endl;
+		}
+#ifndef WIN32
+		{
+			// Entries whose type enumeration couldn't tell, as filing systems returning DT_UNKNOWN give, must still be
+			// dropped as repeats. The first directory links to 300 of the files in the second.
+			std::cout << "Dropping inodes already visited from entries of unknown type ..." << std::endl;
+			inode_set visited;
+			have_metadata_flags wanted; wanted.value=0; wanted.have_size=1;
+			size_t kept=0, resolved=0;
+			for(auto leaf : { "linktree/d0000/d0000", "linktree/d0000/d0001" })
+			{
+				auto dh=begin_enumerate_directory(leaf);
+				if(!dh) abort();
+				std::vector<directory_entry> chunk, entries;
+				while(enumerate_directory(*dh, chunk, 4096))
+					entries.insert(entries.end(), chunk.begin(), chunk.end());
+				packed_enumeration unknown;
+				for(auto &entry : entries)
+				{
+					std::filesystem::path name(entry.name());
+					unknown.push_back(name_view(name.c_str(), name.native().size()), entry.st_ino(), 0);
+				}
+				chunk.clear();
+				for(auto entry : unknown)
+					chunk.push_back(entry.to_directory_entry());
+				detail::drop_visited(*dh, 0, chunk, visited, wanted);
+				kept+=chunk.size();
+				for(auto &entry : chunk)
+					if(entry.metadata_ready().have_type && entry.metadata_ready().have_size && S_IFREG==entry.st_type())
+						++resolved;
+			}
+			if(kept!=1700 || resolved!=kept || visited.repeats()!=300)
+				std::cerr << "ERROR: drop_visited() kept " << kept << " entries of unknown type, " << resolved << " of them resolved, and dropped " << visited.repeats()
+					<< " when it should have kept 1700 and dropped 300." << std::endl;
+		}
+#endif
+#ifdef __linux__
+		// Mount the tree inside itself, which without a visited set would be walked forever
+		POSIX_MKDIR("linktree/d0003/loop", 0x1f8/*770*/);
+		if(-1!=mount("linktree", "linktree/d0003/loop", nullptr, MS_BIND, nullptr))
+		{
+			std::cout << "Walking a tree bind mounted inside itself, skipping inodes already visited ..." << std::endl;
+			inode_set visited;
+			walk_options options;
+			options.max_depth=8;  // should the cycle not be found
+			options.visited=&visited;
+			size_t walked=walk_tree(_L("linktree"), options, [](const walked_directory &, directory_entry &) { return true; });
+			if(walked!=entries-links+1)
+				std::cerr << "ERROR: walk returned " << walked << " entries when it should have returned " << entries-links+1 << "." << std::endl;
+			umount2("linktree/d0003/loop", MNT_DETACH);
+		}
+#endif
+		std::filesystem::remove_all(_L("linktree"));
+	}
+
+	// Duplicates
+	{
+		// A reproducible corpus of originals with random sizes and contents, some copied once or more, some
+		// with a copy differing only in the middle, some with a file of the same size but different, and
+		// some hard linked, which aren't duplicates
+		const size_t originals=5000;
+		std::mt19937 rand(78);
+		auto content=[](size_t idx, size_t size, std::vector<char> &buffer) {
+			std::mt19937_64 gen(idx);
+			buffer.resize(size);
+			for(size_t n=0; n<size; n+=8)
+			{
+				uint64_t v=gen();
+				memcpy(buffer.data()+n, &v, std::min((size_t) 8, size-n));
+			}
+		};
+		auto place=[](const char *prefix, size_t idx) {
+			std::filesystem::path::value_type buffer[64];
+			POSIX_SPRINTF(buffer, _L("dupetree/d%02u/%s%06u"), (unsigned) (idx%10), prefix, (unsigned) idx);
+			return std::filesystem::path(buffer);
+		};
+		for(size_t d=0; d<10; d++)
+		{
+			std::filesystem::path::value_type buffer[64];
+			POSIX_SPRINTF(buffer, _L("dupetree/d%02u"), (unsigned) d);
+			std::filesystem::create_directories(buffer);
+		}
+		std::vector<size_t> sizes(originals), copies(originals, 0);
+		std::vector<char> buffer;
+		uint64_t corpus=0;
+		for(size_t n=0; n<originals; n++)
+		{
+			sizes[n]=16+rand()%((size_t) 1<<(rand()%18));
+			content(n, sizes[n], buffer);
+			write_file(place(_L("o"), n), buffer);
+			corpus+=sizes[n];
+		}
+		size_t expected_groups=0, expected_files=0, files=originals;
+		for(size_t n=0; n<500; n++, files++)
+		{
+			size_t k=rand()%originals;
+			content(k, sizes[k], buffer);
+			write_file(place(_L("c"), n), buffer);
+			expected_groups+=!copies[k]++;
+			expected_files+=1+(1==copies[k]);
+			corpus+=sizes[k];
+		}
+		for(size_t n=0; n<200; n++, files++)
+		{
+			size_t k;
+			while(sizes[k=rand()%originals]<=2*duplicate_options().edge_size+1);
+			content(k, sizes[k], buffer);
+			buffer[sizes[k]/2]^=(char) (1+n);
+			write_file(place(_L("e"), n), buffer);
+			corpus+=sizes[k];
+		}
+		for(size_t n=0; n<200; n++, files++)
+		{
+			size_t k=rand()%originals;
+			content(originals+n, sizes[k], buffer);
+			write_file(place(_L("s"), n), buffer);
+			corpus+=sizes[k];
+		}
+#ifndef WIN32
+		for(size_t n=0; n<100; n++)
+			if(-1==link(place(_L("o"), n).c_str(), place(_L("l"), n).c_str())) abort();
+#endif
+		for(int cold=0; cold<2; cold++)
+			for(int naive=0; naive<2; naive++)
+			{
+				if(cold && !drop_caches())
+					break;
+				std::cout << "Finding duplicates among " << files << " files holding " << corpus << " bytes with " << (cold ? "cold" : "warm") << " caches "
+					<< (naive ? "by hashing every file in full" : "in stages") << " ..." << std::endl;
+				size_t groups=0, grouped=0;
+				bool wrong=false;
+				uint64_t bytes_read=0;
+				begin=chrono::high_resolution_clock::now();
+				if(naive)
+				{
+					std::vector<std::pair<std::pair<uint64_t, uint64_t>, std::filesystem::path>> hashes;
+					std::vector<std::filesystem::path> paths;
+					std::vector<char> chunk(1024*1024);
+					walk_options options;
+					options.threads=1;
+					walk_tree(_L("dupetree"), options, [&paths](const walked_directory &dir, directory_entry &entry) {
+						if(S_IFREG==entry.st_type()) paths.push_back(dir.path()/entry.name());
+						return true;
+					});
+					for(auto &path : paths)
+					{
+						int fh=POSIX_OPEN(path.c_str(), O_RDONLY, 0);
+						uint64_t hash=0, size=0;
+						for(int bytes; (bytes=read(fh, chunk.data(), (unsigned) chunk.size()))>0; size+=bytes)
+							hash=detail::xxhash64(chunk.data(), bytes, hash);
+						POSIX_CLOSE(fh);
+						bytes_read+=size;
+						hashes.push_back(std::make_pair(std::make_pair(size, hash), path));
+					}
+					std::sort(hashes.begin(), hashes.end());
+					for(size_t n=0, m; n<hashes.size(); n=m)
+					{
+						for(m=n+1; m<hashes.size() && hashes[m].first==hashes[n].first; m++);
+						if(m-n>1)
+						{
+							++groups;
+							grouped+=m-n;
+						}
+					}
+				}
+				else
+				{
+					duplicate_report report=find_duplicates(_L("dupetree"));
+					bytes_read=report.bytes_read;
+					groups=report.groups.size();
+					for(auto &group : report.groups)
+						for(auto &path : group.paths)
+						{
+							++grouped;
+							// Only originals, or a hard link to one, and their copies are duplicates
+							auto prefix=path.filename().native()[0];
+							if(prefix!='o' && prefix!='l' && prefix!='c')
+								wrong=true;
+						}
+					std::cout << "Of " << report.files << " files, " << report.same_size << " shared their size and " << report.same_edges << " their size and ends." << std::endl;
+				}
+				end=chrono::high_resolution_clock::now();
+				diff=chrono::duration_cast<secs_type>(end-begin);
+				std::cout << "It took " << diff.count() << " secs to find " << groups << " groups of " << grouped << " duplicates, reading " << bytes_read << " bytes." << std::endl;
+				// Hashing every file treats hard links as duplicates
+				if(!naive && (wrong || groups!=expected_groups || grouped!=expected_files))
+					std::cerr << "ERROR: find_duplicates found " << groups << " groups of " << grouped << " duplicates when it should have found " << expected_groups << " groups of " << expected_files << "." << std::endl;
+			}
+		std::filesystem::remove_all(_L("dupetree"));
+	}
+
+	// Check results
+	std::cout << "Checking enumeration and deleting " << NUMBER_OF_FILES << " files. This may also take a while ..." << std::endl;
+	if(enumeration)
+	{
+		if(enumeration->size()!=NUMBER_OF_FILES)
+			std::cerr << "ERROR: enumeration returned " << enumeration->size() << " items when it should have returned " << NUMBER_OF_FILES << " items." << std::endl;
+		for(auto &entry : *enumeration)
+		{
+			auto it=tocheck.find(entry.name().native());
+			if(it==tocheck.end())
+				std::cerr << "ERROR: '" << entry.name() << "' shouldn't be there!" << std::endl;
+			else if(it->second)
+				std::cerr << "ERROR: '" << entry.name() << "' found more than once!" << std::endl;
+			else
+				it->second=true;
+			name.replace(8, std::string::npos, entry.name().native());
+			POSIX_UNLINK(name.c_str());
+		}
+		for(auto &item : tocheck)
+			if(!item.second)
+				std::cerr << "ERROR: '" << std::filesystem::path(item.first) << "' was not enumerated!" << std::endl;
+	}
+
+	// Delete directory
+	POSIX_RMDIR(_L("testdir"));
+#ifdef _MSC_VER
+	std::cout << "Press Return to exit ..." << std::endl;
+	getchar();
+#endif
+	return 0;
+}